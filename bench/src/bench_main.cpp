@@ -0,0 +1,449 @@
+/*
+Visilib, an open source library for exact visibility computation.
+Copyright(C) 2021 by Denis Haumont
+
+This file is part of Visilib.
+
+Visilib is free software : you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Visilib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Visilib. If not, see <http://www.gnu.org/licenses/>
+*/
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef WIN32
+#include "windows.h"
+#include "psapi.h"
+#else
+#include <sys/resource.h>
+#endif
+
+#include "../demo/demo_helper.h"
+#include "helper_synthetic_mesh_builder.h"
+#include "helper_statistic_collector.h"
+#include "helper_statistic_recorder.h"
+
+using namespace visilib;
+using namespace visilibDemo;
+
+#ifndef VISILIB_BENCH_DATA_DIR
+#define VISILIB_BENCH_DATA_DIR "..//..//demo//data"
+#endif
+
+/** @brief A scene of the benchmark: a synthetic scene generated from a fixed seed, or an OBJ file*/
+struct BenchScene
+{
+    std::string name;
+    int sceneIndex = -1;     /**< @brief The index of the synthetic scene (as used by DemoHelper::createScene), -1 for the other scenes*/
+    bool checkBoard = false; /**< @brief Two interleaved checkboards: each one is mostly empty, but their union is opaque*/
+    std::string fileName;    /**< @brief The OBJ file of the scene, if any*/
+};
+
+/** @brief The measures of a workload, i.e. a set of queries performed on one scene with one arithmetic precision*/
+struct BenchResult
+{
+    std::string scene;
+    std::string precision;
+    size_t queryCount = 0;
+    size_t visibleCount = 0;
+    size_t hiddenCount = 0;
+    size_t failureCount = 0;
+    bool truncated = false;
+    double totalTime = 0;
+    double p50 = 0;
+    double p95 = 0;
+    double p99 = 0;
+    double maxLatency = 0;
+    long long splitCount = 0;
+    long long rayCount = 0;
+    size_t peakMemory = 0;
+};
+
+/** @brief The command line options of the benchmark*/
+struct BenchOptions
+{
+    size_t queryCount = 50;
+    double budget = 30;
+    unsigned int seed = 12345;
+    std::string dataDirectory = VISILIB_BENCH_DATA_DIR;
+    std::string output;
+    std::string records;
+    std::string trace;
+    std::string filter;
+};
+
+/** @brief Return the peak resident set size of the process, in bytes*/
+size_t getPeakMemory()
+{
+#ifdef WIN32
+    PROCESS_MEMORY_COUNTERS myCounters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &myCounters, sizeof(myCounters)))
+    {
+        return (size_t)myCounters.PeakWorkingSetSize;
+    }
+    return 0;
+#else
+    struct rusage myUsage;
+    getrusage(RUSAGE_SELF, &myUsage);
+#ifdef __APPLE__
+    return (size_t)myUsage.ru_maxrss;
+#else
+    return (size_t)myUsage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+std::string getPrecisionName(VisibilityExactQueryConfiguration::PrecisionType aPrecision)
+{
+    switch (aPrecision)
+    {
+    case VisibilityExactQueryConfiguration::FLOAT: return "FLOAT";
+    case VisibilityExactQueryConfiguration::DOUBLE: return "DOUBLE";
+#ifdef ENABLE_LEDA
+    case VisibilityExactQueryConfiguration::LEDA_REAL: return "LEDA_REAL";
+#endif
+#ifdef ENABLE_GMP
+    case VisibilityExactQueryConfiguration::GMP_FLOAT: return "GMP_FLOAT";
+    case VisibilityExactQueryConfiguration::GMP_RATIONAL: return "GMP_RATIONAL";
+#endif
+#ifdef ENABLE_MPFR
+    case VisibilityExactQueryConfiguration::MPFR: return "MPFR";
+#endif
+    default: return "UNKNOWN";
+    }
+}
+
+std::vector<BenchScene> getScenes(const BenchOptions& anOptions)
+{
+    std::vector<BenchScene> myScenes;
+
+    const char* mySyntheticNames[] = { "", "slots", "slot_pair", "grid", "sphere_with_holes", "noisy_sphere_with_holes",
+                                       "cube_with_holes", "noisy_cube_with_holes", "grid_with_holes", "cubes_and_grid" };
+    for (int i = 1; i <= 9; i++)
+    {
+        BenchScene myScene;
+        myScene.name = mySyntheticNames[i];
+        myScene.sceneIndex = i;
+        myScenes.push_back(myScene);
+    }
+
+    BenchScene myCheckBoard;
+    myCheckBoard.name = "checkboards";
+    myCheckBoard.checkBoard = true;
+    myScenes.push_back(myCheckBoard);
+
+    std::vector<std::string> myFiles;
+    std::error_code myError;
+    for (auto& myEntry : std::filesystem::directory_iterator(anOptions.dataDirectory, myError))
+    {
+        if (myEntry.path().extension() == ".obj")
+        {
+            myFiles.push_back(myEntry.path().string());
+        }
+    }
+    if (myError)
+    {
+        std::cerr << "Warning: cannot read the OBJ scenes of " << anOptions.dataDirectory << std::endl;
+    }
+    // The directory order is not specified: the files are sorted to keep the workloads reproducible
+    std::sort(myFiles.begin(), myFiles.end());
+
+    for (auto& myFile : myFiles)
+    {
+        BenchScene myScene;
+        myScene.name = std::filesystem::path(myFile).stem().string();
+        myScene.fileName = myFile;
+        myScenes.push_back(myScene);
+    }
+    return myScenes;
+}
+
+HelperTriangleMeshContainer* createScene(const BenchScene& aScene, unsigned int aSeed)
+{
+    // Some synthetic scenes are randomized with rand()
+    srand(aSeed);
+
+    if (aScene.sceneIndex >= 0)
+    {
+        return DemoHelper::createScene(aScene.sceneIndex, 1.0f);
+    }
+
+    HelperTriangleMeshContainer* myContainer = new HelperTriangleMeshContainer();
+    if (aScene.checkBoard)
+    {
+        for (int i = 0; i < 2; i++)
+        {
+            HelperTriangleMesh* mesh = HelperSyntheticMeshBuilder::generateCheckBoard(4, i == 0);
+            HelperSyntheticMeshBuilder::rotate(mesh, 0.0, (float)M_PI_2, (float)M_PI);
+            HelperSyntheticMeshBuilder::translate(mesh, MathVector3f(-0.2f + 0.4f * i, 0.0f, 0.0f));
+            myContainer->add(mesh);
+        }
+    }
+    else
+    {
+        if (!DemoHelper::load(myContainer, aScene.fileName))
+        {
+            delete myContainer;
+            return nullptr;
+        }
+        HelperSyntheticMeshBuilder::rescaleToUnitBox(myContainer);
+    }
+    return myContainer;
+}
+
+/** @brief Return the latency at a given percentile, using the nearest rank method on the sorted latencies*/
+double getPercentile(const std::vector<double>& aSortedLatencies, double aPercentile)
+{
+    if (aSortedLatencies.empty())
+    {
+        return 0;
+    }
+    size_t myRank = (size_t)ceil(aPercentile / 100.0 * aSortedLatencies.size());
+    return aSortedLatencies[std::min(aSortedLatencies.size(), std::max<size_t>(myRank, 1)) - 1];
+}
+
+/** @brief Perform the queries of a workload
+
+The source polygons of each query are generated from a random generator seeded with a fixed seed, such that every run performs the same queries.
+The exact arithmetic workloads can be several orders of magnitude slower than the floating point ones: the workload is truncated when its time budget is exhausted.
+*/
+BenchResult runWorkload(GeometryOccluderSet* aScene, const std::string& aSceneName, VisibilityExactQueryConfiguration::PrecisionType aPrecision, const BenchOptions& anOptions,
+    HelperStatisticRecorder* aRecorder)
+{
+    BenchResult myResult;
+    myResult.scene = aSceneName;
+    myResult.precision = getPrecisionName(aPrecision);
+
+    VisibilityExactQueryConfiguration myConfiguration;
+    myConfiguration.precision = aPrecision;
+    myConfiguration.recorder = aRecorder;
+
+    std::mt19937 myGenerator(anOptions.seed);
+    std::uniform_int_distribution<size_t> myVertexCount(1, 5);
+    std::uniform_real_distribution<float> mySize(0.01f, 0.3f);
+    std::uniform_real_distribution<float> myAngle(0.0f, 2.0f * (float)M_PI);
+
+    std::vector<double> myLatencies;
+    std::vector<float> myVertices0, myVertices1;
+
+    for (size_t i = 0; i < anOptions.queryCount; i++)
+    {
+        size_t myVertexCount0 = myVertexCount(myGenerator);
+        size_t myVertexCount1 = myVertexCount(myGenerator);
+        float mySize0 = mySize(myGenerator);
+        float mySize1 = mySize(myGenerator);
+        float myPhi = myAngle(myGenerator);
+
+        DemoHelper::generatePolygon(myVertices0, myVertexCount0, mySize0, myPhi - (float)M_PI, 1.0f);
+        DemoHelper::generatePolygon(myVertices1, myVertexCount1, mySize1, myPhi, 1.0f);
+
+        auto myStart = std::chrono::steady_clock::now();
+
+        VisibilityExactQuery* myQuery = createVisibilityExactQuery(aScene, myConfiguration);
+        VisibilityResult myVisibility = myQuery->arePolygonsVisible(&myVertices0[0], myVertexCount0, &myVertices1[0], myVertexCount1);
+
+        auto myEnd = std::chrono::steady_clock::now();
+
+        myResult.splitCount += myQuery->getStatistic()->get(POLYTOPE_SPLIT_COUNT);
+        myResult.rayCount += myQuery->getStatistic()->get(RAY_COUNT);
+        delete myQuery;
+
+        switch (myVisibility)
+        {
+        case VISIBLE: myResult.visibleCount++; break;
+        case HIDDEN: myResult.hiddenCount++; break;
+        default: myResult.failureCount++; break;
+        }
+        myLatencies.push_back(std::chrono::duration<double>(myEnd - myStart).count());
+
+        myResult.totalTime += myLatencies.back();
+        if (anOptions.budget > 0 && myResult.totalTime > anOptions.budget && i + 1 < anOptions.queryCount)
+        {
+            myResult.truncated = true;
+            break;
+        }
+    }
+
+    std::sort(myLatencies.begin(), myLatencies.end());
+    myResult.queryCount = myLatencies.size();
+    myResult.p50 = getPercentile(myLatencies, 50);
+    myResult.p95 = getPercentile(myLatencies, 95);
+    myResult.p99 = getPercentile(myLatencies, 99);
+    myResult.maxLatency = myLatencies.empty() ? 0 : myLatencies.back();
+    myResult.peakMemory = getPeakMemory();
+
+    return myResult;
+}
+
+void writeJson(std::ostream& anOutput, const std::vector<BenchResult>& aResults, const BenchOptions& anOptions)
+{
+    anOutput << std::setprecision(6);
+    anOutput << "{" << std::endl;
+    anOutput << "  \"seed\": " << anOptions.seed << "," << std::endl;
+    anOutput << "  \"queriesPerWorkload\": " << anOptions.queryCount << "," << std::endl;
+    anOutput << "  \"budgetSeconds\": " << anOptions.budget << "," << std::endl;
+    anOutput << "  \"workloads\": [" << std::endl;
+
+    for (size_t i = 0; i < aResults.size(); i++)
+    {
+        const BenchResult& r = aResults[i];
+        double myQueriesPerSecond = r.totalTime > 0 ? r.queryCount / r.totalTime : 0;
+
+        anOutput << "    {"
+            << "\"scene\": \"" << r.scene << "\", "
+            << "\"precision\": \"" << r.precision << "\", "
+            << "\"queries\": " << r.queryCount << ", "
+            << "\"visible\": " << r.visibleCount << ", "
+            << "\"hidden\": " << r.hiddenCount << ", "
+            << "\"failures\": " << r.failureCount << ", "
+            << "\"truncated\": " << (r.truncated ? "true" : "false") << ", "
+            << "\"queriesPerSecond\": " << myQueriesPerSecond << ", "
+            << "\"latencyMs\": {\"p50\": " << r.p50 * 1000 << ", \"p95\": " << r.p95 * 1000 << ", \"p99\": " << r.p99 * 1000 << ", \"max\": " << r.maxLatency * 1000 << "}, "
+            << "\"splits\": " << r.splitCount << ", "
+            << "\"rays\": " << r.rayCount << ", "
+            << "\"peakRssBytes\": " << r.peakMemory
+            << "}" << (i + 1 < aResults.size() ? "," : "") << std::endl;
+    }
+    anOutput << "  ]," << std::endl;
+    anOutput << "  \"peakRssBytes\": " << getPeakMemory() << std::endl;
+    anOutput << "}" << std::endl;
+}
+
+void displayUsage()
+{
+    std::cout << "Usage: visilibBench [--queries N] [--budget SECONDS] [--seed S] [--data DIRECTORY] [--filter NAME] [--output FILE] [--records FILE] [--trace FILE]" << std::endl
+              << "  --queries: number of queries per workload (default 50)" << std::endl
+              << "  --budget: time after which a workload is truncated, 0 for no limit (default 30)" << std::endl
+              << "  --seed: seed of the generation of the queries and of the random scenes (default 12345)" << std::endl
+              << "  --data: directory containing the OBJ scenes (default " << VISILIB_BENCH_DATA_DIR << ")" << std::endl
+              << "  --filter: only run the workloads whose scene or precision name contains NAME" << std::endl
+              << "  --output: write the JSON report to FILE instead of the standard output" << std::endl
+              << "  --records: write the statistics of each query to FILE as JSON lines" << std::endl
+              << "  --trace: write the timeline of the queries to FILE in the Chrome trace event format" << std::endl;
+}
+
+bool parseOptions(int argc, char** argv, BenchOptions& anOptions)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string myOption = argv[i];
+        if (i + 1 >= argc)
+        {
+            return false;
+        }
+        std::string myValue = argv[++i];
+
+        if (myOption == "--queries") { anOptions.queryCount = (size_t)atoi(myValue.c_str()); }
+        else if (myOption == "--budget") { anOptions.budget = atof(myValue.c_str()); }
+        else if (myOption == "--seed") { anOptions.seed = (unsigned int)atoi(myValue.c_str()); }
+        else if (myOption == "--data") { anOptions.dataDirectory = myValue; }
+        else if (myOption == "--filter") { anOptions.filter = myValue; }
+        else if (myOption == "--output") { anOptions.output = myValue; }
+        else if (myOption == "--records") { anOptions.records = myValue; }
+        else if (myOption == "--trace") { anOptions.trace = myValue; }
+        else { return false; }
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    BenchOptions myOptions;
+    if (!parseOptions(argc, argv, myOptions))
+    {
+        displayUsage();
+        return 1;
+    }
+
+    std::vector<VisibilityExactQueryConfiguration::PrecisionType> myPrecisions = { VisibilityExactQueryConfiguration::FLOAT, VisibilityExactQueryConfiguration::DOUBLE };
+#ifdef ENABLE_LEDA
+    myPrecisions.push_back(VisibilityExactQueryConfiguration::LEDA_REAL);
+#endif
+#ifdef ENABLE_MPFR
+    myPrecisions.push_back(VisibilityExactQueryConfiguration::MPFR);
+#endif
+#ifdef ENABLE_GMP
+    myPrecisions.push_back(VisibilityExactQueryConfiguration::GMP_FLOAT);
+    myPrecisions.push_back(VisibilityExactQueryConfiguration::GMP_RATIONAL);
+#endif
+
+    std::ofstream myRecords, myTrace;
+    if (!myOptions.records.empty())
+    {
+        myRecords.open(myOptions.records);
+    }
+    if (!myOptions.trace.empty())
+    {
+        myTrace.open(myOptions.trace);
+    }
+    HelperStatisticRecorder myRecorder(myRecords.is_open() ? &myRecords : nullptr, myTrace.is_open() ? &myTrace : nullptr);
+
+    std::vector<BenchResult> myResults;
+
+    for (auto& myScene : getScenes(myOptions))
+    {
+        HelperTriangleMeshContainer* myContainer = nullptr;
+        GeometryOccluderSet* myOccluderSet = nullptr;
+
+        for (auto myPrecision : myPrecisions)
+        {
+            if (!myOptions.filter.empty() && myScene.name.find(myOptions.filter) == std::string::npos
+                && getPrecisionName(myPrecision).find(myOptions.filter) == std::string::npos)
+            {
+                continue;
+            }
+
+            if (myContainer == nullptr)
+            {
+                myContainer = createScene(myScene, myOptions.seed);
+                if (myContainer == nullptr)
+                {
+                    std::cerr << "Error: cannot load scene " << myScene.fileName << std::endl;
+                    break;
+                }
+                myOccluderSet = DemoHelper::createOccluderSet(myContainer);
+            }
+
+            std::cerr << "Running " << myScene.name << " " << getPrecisionName(myPrecision) << std::endl;
+            myResults.push_back(runWorkload(myOccluderSet, myScene.name, myPrecision, myOptions, &myRecorder));
+        }
+        delete myOccluderSet;
+        delete myContainer;
+    }
+    myRecorder.close();
+
+    if (myOptions.output.empty())
+    {
+        writeJson(std::cout, myResults, myOptions);
+    }
+    else
+    {
+        std::ofstream myOutput(myOptions.output);
+        if (!myOutput)
+        {
+            std::cerr << "Error: cannot write " << myOptions.output << std::endl;
+            return 1;
+        }
+        writeJson(myOutput, myResults, myOptions);
+    }
+    return 0;
+}
@@ -231,6 +231,7 @@ void DemoConfiguration::displaySettings()
     std::cout << "[Normalization: " << getStatusString(normalization) << "]";
 
     std::cout << "  [Arithmetic: " << toStr(precisionType) << "]" << std::endl;
+    std::cout << "[BVH:" << getStatusString(bvh) << "]" << std::endl;
 #if EMBREE
     std::cout << "[Embree:" << getStatusString(embree) << "]" << std::endl;
 #endif
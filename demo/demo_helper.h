@@ -43,6 +43,7 @@ namespace visilibDemo
         int   sceneIndex = 2;
         float globalScaling = 1;
         double tolerance = -1;
+        bool bvh = true;
 #if EMBREE
         bool embree = false;
 #endif
@@ -103,6 +103,7 @@ namespace visilibDemo
 
             config.detectApertureOnly = mDemoConfiguration.detectApertureOnly;
             config.tolerance = mDemoConfiguration.tolerance;
+            config.useBvh = mDemoConfiguration.bvh;
 #if EMBREE
             config.useEmbree = mDemoConfiguration.embree;
 #endif
@@ -168,6 +169,7 @@ namespace visilibDemo
             std::cout << "  n: enable/disable nomalization" << std::endl;
             std::cout << "  e: enable/disable exact arithmetic" << std::endl;
 
+            std::cout << "  b: enable/disable BVH ray tracing" << std::endl;
 #if EMBREE
             std::cout << "  g: enable/disable embree ray tracing" << std::endl;
 #endif
@@ -291,6 +293,11 @@ namespace visilibDemo
                 displaySettings();
                 forceDisplay = true;
                 break;
+            case 'b':
+                mDemoConfiguration.bvh = !mDemoConfiguration.bvh;
+                displaySettings();
+                forceDisplay = true;
+                break;
 #if EMBREE
             case 'g':
                 mDemoConfiguration.embree = !mDemoConfiguration.embree;
@@ -20,5 +20,21 @@ along with Visilib. If not, see <http://www.gnu.org/licenses/>
 
 
 bool MathCombinatorialTest(std::string&);
+bool GeometryTrianglePacketTest(std::string&);
 bool testConfiguration(bool& retflag);
-bool VisibilityTest(std::string&);
\ No newline at end of file
+bool VisibilityTest(std::string&);
+bool HierarchicalVisibilityTest(std::string&);
+bool ParallelVisibilityTest(std::string&);
+bool StatisticAggregatorTest(std::string&);
+bool OcclusionTreeHistogramTest(std::string&);
+bool RayPacketTest(std::string&);
+bool StabbingLineHullTest(std::string&);
+bool SilhouetteBvhTest(std::string&);
+bool SplitOrderingTest(std::string&);
+bool PointVisibilityTest(std::string&);
+bool CoherenceCacheTest(std::string&);
+bool SceneReaderTest(std::string&);
+bool BinarySceneTest(std::string&);
+bool PvsStoreTest(std::string&);
+bool PvsBakeTest(std::string&);
+bool OccluderSetUpdateTest(std::string&);
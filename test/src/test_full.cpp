@@ -33,6 +33,102 @@ int main()
 	   	return 1;
 	}
 
+    if (!GeometryTrianglePacketTest(errorMessage))
+    {
+        std::cout << "GeometryTrianglePacketTest ERROR" << std::endl;
+        return 1;
+    }
+
+    if (!SceneReaderTest(errorMessage))
+    {
+        std::cout << "SceneReaderTest ERROR" << std::endl;
+        return 1;
+    }
+
+    if (!BinarySceneTest(errorMessage))
+    {
+        std::cout << "BinarySceneTest ERROR" << std::endl;
+        return 1;
+    }
+
+    if (!PvsStoreTest(errorMessage))
+    {
+        std::cout << "PvsStoreTest ERROR" << std::endl;
+        return 1;
+    }
+
+    if (!PvsBakeTest(errorMessage))
+    {
+        std::cout << "PvsBakeTest ERROR" << std::endl;
+        return 1;
+    }
+
+    if (!OccluderSetUpdateTest(errorMessage))
+    {
+        std::cout << "OccluderSetUpdateTest ERROR" << std::endl;
+        return 1;
+    }
+
+    if (!HierarchicalVisibilityTest(errorMessage))
+    {
+        std::cout << "HierarchicalVisibilityTest ERROR" << std::endl;
+        return 1;
+    }
+
+    if (!ParallelVisibilityTest(errorMessage))
+    {
+        std::cout << "ParallelVisibilityTest ERROR" << std::endl;
+        return 1;
+    }
+
+    if (!StatisticAggregatorTest(errorMessage))
+    {
+        std::cout << "StatisticAggregatorTest ERROR" << std::endl;
+        return 1;
+    }
+
+    if (!OcclusionTreeHistogramTest(errorMessage))
+    {
+        std::cout << "OcclusionTreeHistogramTest ERROR" << std::endl;
+        return 1;
+    }
+
+    if (!RayPacketTest(errorMessage))
+    {
+        std::cout << "RayPacketTest ERROR" << std::endl;
+        return 1;
+    }
+
+    if (!StabbingLineHullTest(errorMessage))
+    {
+        std::cout << "StabbingLineHullTest ERROR" << std::endl;
+        return 1;
+    }
+
+    if (!SilhouetteBvhTest(errorMessage))
+    {
+        std::cout << "SilhouetteBvhTest ERROR" << std::endl;
+        return 1;
+    }
+
+    if (!SplitOrderingTest(errorMessage))
+    {
+        std::cout << "SplitOrderingTest ERROR" << std::endl;
+        return 1;
+    }
+
+    if (!PointVisibilityTest(errorMessage))
+    {
+        std::cout << "PointVisibilityTest ERROR" << std::endl;
+        return 1;
+    }
+
+    if (!CoherenceCacheTest(errorMessage))
+    {
+        std::cout << "CoherenceCacheTest ERROR" << std::endl;
+        return 1;
+    }
+
     if (!VisibilityTest(errorMessage))
     {
         std::cout << "VisibilityTest ERROR" << std::endl;
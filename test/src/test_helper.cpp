@@ -0,0 +1,390 @@
+/*
+Visilib, an open source library for exact visibility computation.
+Copyright(C) 2021 by Denis Haumont
+
+This file is part of Visilib.
+
+Visilib is free software : you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Visilib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Visilib. If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <algorithm>
+
+#include "../demo/demo_helper.h"
+#include "helper_binary_scene.h"
+#include "helper_geometry_scene_reader.h"
+#include "helper_pvs_bake.h"
+#include "helper_pvs_store.h"
+#include "helper_triangle_mesh_container.h"
+
+using namespace visilib;
+using namespace visilibDemo;
+
+bool SceneReaderTest(std::string&)
+{
+    const std::string fileName = "visilib_test_scene.obj";
+    {
+        std::ofstream output(fileName);
+        output << "# two groups sharing no vertex\n"
+               << "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n"
+               << "g quad\n"
+               << "f 1/1/1 2/2/1 3/3/1 4/4/1\r\n"
+               << "v +2 0 1e0\nv 3 0 1\nv 3 1 1\n"
+               << "o triangle\n"
+               << "f -3 -2 -1";
+    }
+
+    bool success = true;
+    for (size_t threadCount : { 1, 0 })
+    {
+        HelperTriangleMeshContainer scene;
+        HelperGeometrySceneReader reader(&scene);
+
+        bool isValid = reader.readFileObj(fileName, threadCount) && scene.getGeometryCount() == 2;
+        if (isValid)
+        {
+            // The quad is triangulated as a fan, and the second mesh only keeps the vertices it references
+            HelperTriangleMesh* quad = scene.getMeshArray()[0];
+            HelperTriangleMesh* triangle = scene.getMeshArray()[1];
+            isValid = quad->getVertexCount() == 4 && quad->getIndices() == std::vector<int>{ 0, 1, 2, 0, 2, 3 }
+                && triangle->getVertexCount() == 3 && triangle->getIndices() == std::vector<int>{ 0, 1, 2 }
+                && triangle->getVertices()[0] == MathVector3f(2.0f, 0.0f, 1.0f);
+        }
+        if (!isValid)
+        {
+            std::cout << "Error in line " << __LINE__ << std::endl;
+            success = false;
+        }
+    }
+    std::remove(fileName.c_str());
+
+    HelperTriangleMeshContainer scene;
+    HelperGeometrySceneReader reader(&scene);
+    if (reader.readFileObj("visilib_missing_scene.obj"))
+    {
+        std::cout << "Error in line " << __LINE__ - 2 << std::endl;
+        success = false;
+    }
+    std::cout << "SceneReaderTest " << (success ? "SUCCESS" : "FAILED") << std::endl;
+    return success;
+}
+
+bool BinarySceneTest(std::string&)
+{
+    const std::string fileName = "visilib_test_scene.bin";
+
+    HelperTriangleMeshContainer* meshContainer = DemoHelper::createScene(2, 1.0f);
+    GeometryOccluderSet* occluderSet = DemoHelper::createOccluderSet(meshContainer);
+
+    bool success = HelperBinaryScene::write(fileName, occluderSet);
+
+    HelperBinaryScene scene;
+    success = success && scene.open(fileName) && scene.getOccluderCount() == occluderSet->getOccluderCount();
+    if (success)
+    {
+        // The occluder set created from the file references the mapping, with the adjacency and the bounding boxes of the original set
+        GeometryOccluderSet* mappedOccluderSet = scene.createOccluderSet();
+        for (size_t i = 0; i < occluderSet->getOccluderCount() && success; i++)
+        {
+            const std::vector<SilhouetteMeshFace>& faces = *occluderSet->getOccluderConnectedFaces(i);
+            const std::vector<SilhouetteMeshFace>& mappedFaces = *mappedOccluderSet->getOccluderConnectedFaces(i);
+            success = faces.size() == mappedFaces.size()
+                && occluderSet->getOccluderBoundingBox(i).getMin() == mappedOccluderSet->getOccluderBoundingBox(i).getMin()
+                && occluderSet->getOccluderBoundingBox(i).getMax() == mappedOccluderSet->getOccluderBoundingBox(i).getMax();
+            for (size_t j = 0; j < faces.size() && success; j++)
+            {
+                for (size_t k = 0; k < 3; k++)
+                {
+                    success = success && faces[j].getNeighbours(k) == mappedFaces[j].getNeighbours(k) && faces[j].getVertex(k) == mappedFaces[j].getVertex(k);
+                }
+            }
+        }
+
+        std::vector<float> v0, v1;
+        DemoHelper::generatePolygon(v0, 3, 0.3f, -3.14519f, 1.0f);
+        DemoHelper::generatePolygon(v1, 3, 0.3f, 0.0f, 1.0f);
+        VisibilityExactQueryConfiguration config;
+        success = success && areVisible(occluderSet, &v0[0], v0.size() / 3, &v1[0], v1.size() / 3, config, nullptr)
+            == areVisible(mappedOccluderSet, &v0[0], v0.size() / 3, &v1[0], v1.size() / 3, config, nullptr);
+
+        delete mappedOccluderSet;
+    }
+
+    // The BVH of the faces is restored without being built, and a BVH which does not match the occluders is built again
+    {
+        std::ostringstream output;
+        occluderSet->getBvh().write(output);
+        std::string bvh = output.str();
+
+        GeometryOccluderSet* copiedOccluderSet = new GeometryOccluderSet();
+        std::vector<GeometryAABB> boundingBoxes;
+        for (size_t i = 0; i < meshContainer->getGeometryCount(); i++)
+        {
+            copiedOccluderSet->addOccluder(meshContainer->createTriangleMeshDescription(i));
+            boundingBoxes.push_back(occluderSet->getOccluderBoundingBox(i));
+        }
+        success = success && copiedOccluderSet->prepare(boundingBoxes, bvh.data(), bvh.size())
+            && copiedOccluderSet->getBvh().getNodeCount() == occluderSet->getBvh().getNodeCount();
+
+        // The last bytes of the BVH are the parent of its last packet
+        bvh[bvh.size() - 1] ^= 0x40;
+        success = success && !copiedOccluderSet->prepare(boundingBoxes, bvh.data(), bvh.size()) && copiedOccluderSet->isBvhUpToDate()
+            && copiedOccluderSet->getBvh().getNodeCount() == occluderSet->getBvh().getNodeCount();
+        delete copiedOccluderSet;
+    }
+
+    // A file whose index refers to a vertex outside of its occluder is rejected: the first index of the first occluder is replaced
+    success = success && HelperBinaryScene::write(fileName, occluderSet);
+    {
+        const std::streamoff indexOffsetPosition = 40 + 24;     // The index offset of the first occluder entry, after the header of the file
+        std::fstream file(fileName, std::ios::in | std::ios::out | std::ios::binary);
+        uint64_t indexOffset = 0;
+        file.seekg(indexOffsetPosition);
+        file.read(reinterpret_cast<char*>(&indexOffset), sizeof(uint64_t));
+        int32_t index = 1 << 30;
+        file.seekp((std::streamoff)indexOffset);
+        file.write(reinterpret_cast<const char*>(&index), sizeof(int32_t));
+    }
+    success = success && !scene.open(fileName) && scene.getOccluderCount() == 0;
+
+    // A file of another format or version is rejected
+    std::remove(fileName.c_str());
+    {
+        std::ofstream output(fileName);
+        output << "v 0 0 0";
+    }
+    success = success && !scene.open(fileName) && scene.getOccluderCount() == 0;
+    std::remove(fileName.c_str());
+
+    delete occluderSet;
+    delete meshContainer;
+
+    std::cout << "BinarySceneTest " << (success ? "SUCCESS" : "FAILED") << std::endl;
+    return success;
+}
+
+bool PvsStoreTest(std::string&)
+{
+    const std::string fileName = "visilib_test_pvs.bin";
+    const size_t cellCount = 1000;
+
+    // A sparse row, a row made of two large runs, a dense scattered row and an empty row, each one stored with its own encoding
+    std::vector<std::vector<uint32_t>> rows(5);
+    rows[0] = { 3, 500, 999 };
+    for (uint32_t i = 100; i < 400; i++) { rows[1].push_back(i); }
+    for (uint32_t i = 600; i < 1000; i++) { rows[1].push_back(i); }
+    for (uint32_t i = 0; i < cellCount; i += 3) { rows[2].push_back(i); }
+    std::vector<VisibilityResult> results(cellCount, HIDDEN);
+    results[7] = VISIBLE;
+    results[8] = UNKNOWN;
+    rows[4] = { 7, 8 };
+
+    HelperPvsWriter writer;
+    bool success = writer.open(fileName, rows.size(), cellCount);
+
+    // The rows are written in any order, the row 3 is never written
+    writer.writeRow(4, results);
+    writer.writeRow(2, rows[2]);
+    writer.writeRow(0, rows[0]);
+    writer.writeRow(1, rows[1]);
+    success = success && writer.close();
+
+    HelperPvsReader reader;
+    success = success && reader.open(fileName) && reader.getRowCount() == rows.size() && reader.getColumnCount() == cellCount;
+    if (success)
+    {
+        success = reader.getRowEncoding(0) == HelperPvsFormat::ARRAY && reader.getRowEncoding(1) == HelperPvsFormat::RUNS
+            && reader.getRowEncoding(2) == HelperPvsFormat::BITMAP && reader.getRowEncoding(3) == HelperPvsFormat::EMPTY;
+
+        std::vector<uint32_t> visibleColumns;
+        for (size_t i = 0; i < rows.size() && success; i++)
+        {
+            reader.getVisibleColumns(i, visibleColumns);
+            success = visibleColumns == rows[i];
+            for (size_t j = 0; j < cellCount && success; j++)
+            {
+                success = reader.isVisible(i, j) == std::binary_search(rows[i].begin(), rows[i].end(), (uint32_t)j);
+            }
+        }
+    }
+    std::remove(fileName.c_str());
+
+    std::cout << "PvsStoreTest " << (success ? "SUCCESS" : "FAILED") << std::endl;
+    return success;
+}
+
+bool PvsBakeTest(std::string&)
+{
+    const std::string journalFileName = "visilib_test_bake.journal";
+    const std::string pvsFileName = "visilib_test_bake.pvs";
+    const std::string referenceFileName = "visilib_test_bake_reference.pvs";
+    const std::string referenceJournalFileName = "visilib_test_bake_reference.journal";
+
+    HelperTriangleMeshContainer* meshContainer = DemoHelper::createScene(2, 1.0f);
+    GeometryOccluderSet* occluderSet = DemoHelper::createOccluderSet(meshContainer);
+
+    std::vector<std::vector<float>> cells(4);
+    for (size_t i = 0; i < cells.size(); i++)
+    {
+        DemoHelper::generatePolygon(cells[i], 3, 0.1f, 1.5f * i, 1.0f);
+    }
+
+    VisibilityExactQueryConfiguration config;
+    std::remove(journalFileName.c_str());
+
+    // Reference bake, without interruption
+    HelperPvsBake reference(occluderSet, config);
+    bool success = reference.run(cells, journalFileName, referenceFileName) && reference.getComputedRowCount() == cells.size();
+    std::remove(journalFileName.c_str());
+
+    // A bake interrupted after two rows, with a partially written record at the end of its journal, is resumed by the next run
+    HelperPvsBake bake(occluderSet, config);
+    bake.setRowBudget(2);
+    success = success && !bake.run(cells, journalFileName, pvsFileName) && bake.getComputedRowCount() == 2;
+    {
+        std::ofstream journal(journalFileName, std::ios::binary | std::ios::app);
+        journal << "partial";
+    }
+    bake.setRowBudget(cells.size());
+    success = success && bake.run(cells, journalFileName, pvsFileName) && bake.getResumedRowCount() == 2 && bake.getComputedRowCount() == 2;
+
+    {
+        HelperPvsReader pvs, referencePvs;
+        success = success && pvs.open(pvsFileName) && referencePvs.open(referenceFileName) && pvs.getRowCount() == cells.size();
+        for (size_t i = 0; i < cells.size() && success; i++)
+        {
+            std::vector<uint32_t> visibleColumns, referenceVisibleColumns;
+            pvs.getVisibleColumns(i, visibleColumns);
+            referencePvs.getVisibleColumns(i, referenceVisibleColumns);
+            success = visibleColumns == referenceVisibleColumns;
+        }
+    }
+
+    // After an occluder is moved, only the entries whose shaft overlaps its former or new position are computed again
+    MathMatrixf transformation;
+    transformation.setRotateZ(0.0f);
+    transformation.setTranslation(MathVector3f(0.0f, 0.0f, 0.5f));
+    occluderSet->transformOccluder(0, transformation);
+    occluderSet->updateBvh();
+    std::vector<std::pair<size_t, size_t>> entries;
+    bake.getAffectedEntries(occluderSet->getChanges(), entries);
+    success = success && std::count_if(entries.begin(), entries.end(), [](const std::pair<size_t, size_t>& e) { return e.second == 0; }) == (long)cells.size()
+        && bake.update(cells, occluderSet->getChanges(), journalFileName, pvsFileName) && bake.getUpdatedEntryCount() == entries.size();
+    occluderSet->clearChanges();
+
+    success = success && reference.run(cells, referenceJournalFileName, referenceFileName);
+    {
+        HelperPvsReader pvs, referencePvs;
+        success = success && pvs.open(pvsFileName) && referencePvs.open(referenceFileName);
+        for (size_t i = 0; i < cells.size() && success; i++)
+        {
+            std::vector<uint32_t> visibleColumns, referenceVisibleColumns;
+            pvs.getVisibleColumns(i, visibleColumns);
+            referencePvs.getVisibleColumns(i, referenceVisibleColumns);
+            success = visibleColumns == referenceVisibleColumns;
+        }
+    }
+
+    // The rewritten journal resumes the updated rows
+    success = success && bake.run(cells, journalFileName, pvsFileName) && bake.getResumedRowCount() == cells.size();
+
+    // A journal written for other cells or another scene with the same counts is restarted
+    std::vector<std::vector<float>> otherCells(cells.size());
+    for (size_t i = 0; i < otherCells.size(); i++)
+    {
+        DemoHelper::generatePolygon(otherCells[i], 3, 0.1f, 1.5f * i + 0.5f, 1.0f);
+    }
+    success = success && bake.run(otherCells, journalFileName, pvsFileName) && bake.getResumedRowCount() == 0 && bake.getComputedRowCount() == cells.size();
+    success = success && bake.run(cells, journalFileName, pvsFileName) && bake.getResumedRowCount() == 0;
+
+    transformation.setTranslation(MathVector3f(0.0f, 0.0f, -0.5f));
+    occluderSet->transformOccluder(0, transformation);
+    occluderSet->updateBvh();
+    occluderSet->clearChanges();
+    success = success && bake.run(cells, journalFileName, pvsFileName) && bake.getResumedRowCount() == 0;
+    success = success && bake.run(cells, journalFileName, pvsFileName) && bake.getResumedRowCount() == cells.size();
+
+    std::remove(journalFileName.c_str());
+    std::remove(pvsFileName.c_str());
+    std::remove(referenceFileName.c_str());
+    std::remove(referenceJournalFileName.c_str());
+    delete occluderSet;
+    delete meshContainer;
+
+    std::cout << "PvsBakeTest " << (success ? "SUCCESS" : "FAILED") << std::endl;
+    return success;
+}
+
+bool OccluderSetUpdateTest(std::string&)
+{
+    HelperTriangleMeshContainer* meshContainer = DemoHelper::createScene(2, 1.0f);
+    GeometryOccluderSet* occluderSet = DemoHelper::createOccluderSet(meshContainer);
+    size_t occluderCount = occluderSet->getOccluderCount();
+
+    std::vector<std::vector<float>> cells(2);
+    DemoHelper::generatePolygon(cells[0], 3, 0.3f, -3.14519f, 1.0f);
+    DemoHelper::generatePolygon(cells[1], 3, 0.3f, 0.0f, 1.0f);
+    VisibilityExactQueryConfiguration config;
+    VisibilityResult reference = areVisible(occluderSet, &cells[0][0], cells[0].size() / 3, &cells[1][0], cells[1].size() / 3, config, nullptr);
+
+    // A translated occluder keeps its adjacency, and the transformation is applied to its original vertices
+    std::vector<SilhouetteMeshFace> faces = *occluderSet->getOccluderConnectedFaces(0);
+    GeometryAABB box = occluderSet->getOccluderBoundingBox(0);
+    MathMatrixf transformation;
+    transformation.setRotateZ(0.0f);
+    transformation.setTranslation(MathVector3f(100.0f, 0.0f, 0.0f));
+    occluderSet->transformOccluder(0, transformation);
+
+    bool success = occluderSet->getChanges().size() == 1 && occluderSet->getOccluderBoundingBox(0).getMin().x == box.getMin().x + 100.0f;
+    const std::vector<SilhouetteMeshFace>& transformedFaces = *occluderSet->getOccluderConnectedFaces(0);
+    for (size_t i = 0; i < faces.size() && success; i++)
+    {
+        success = transformedFaces[i].getNeighbours(0) == faces[i].getNeighbours(0) && transformedFaces[i].getVertex(0) == faces[i].getVertex(0) + MathVector3f(100.0f, 0.0f, 0.0f);
+    }
+
+    // The faces of a transformed occluder are updated in place in the BVH of the scene
+    success = success && !occluderSet->isBvhUpToDate();
+    occluderSet->updateBvh();
+    success = success && occluderSet->isBvhUpToDate();
+
+    transformation.setRotateZ(0.0f);
+    occluderSet->transformOccluder(0, transformation);
+    occluderSet->updateBvh();
+    success = success && occluderSet->getOccluderBoundingBox(0).getMin() == box.getMin() && occluderSet->getOccluderBoundingBox(0).getMax() == box.getMax()
+        && areVisible(occluderSet, &cells[0][0], cells[0].size() / 3, &cells[1][0], cells[1].size() / 3, config, nullptr) == reference;
+
+    // A removed occluder keeps its id, and is hidden from any cell
+    occluderSet->clearChanges();
+    occluderSet->removeOccluder(1);
+    occluderSet->updateBvh();
+    std::vector<VisibilityResult> results;
+    areOccludersVisible(occluderSet, &cells[0][0], cells[0].size() / 3, results, config);
+    success = success && !occluderSet->hasOccluder(1) && occluderSet->getOccluderCount() == occluderCount && results[1] == HIDDEN
+        && occluderSet->getOccluderConnectedFaces(1)->empty() && occluderSet->getChanges().size() == 1;
+
+    // An occluder added to a prepared set has its bounding box computed
+    size_t id = occluderSet->addOccluder(meshContainer->createTriangleMeshDescription(0));
+    occluderSet->updateBvh();
+    success = success && occluderSet->isBvhUpToDate() && id == occluderCount && occluderSet->getOccluderBoundingBox(id).getMin() == box.getMin() && occluderSet->getChanges().size() == 2;
+
+    delete occluderSet;
+    delete meshContainer;
+
+    std::cout << "OccluderSetUpdateTest " << (success ? "SUCCESS" : "FAILED") << std::endl;
+    return success;
+}
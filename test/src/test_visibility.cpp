@@ -18,10 +18,15 @@ You should have received a copy of the GNU General Public License
 along with Visilib. If not, see <http://www.gnu.org/licenses/>
 */
 
+#include <algorithm>
 #include <string>
 #include <iostream>
+#include <cmath>
+#include <limits>
+#include <thread>
 
 #include "../demo/demo_helper.h"
+#include "helper_synthetic_mesh_builder.h"
 #include "test_definition.h"
 
 using namespace visilib;
@@ -109,3 +114,600 @@ bool VisibilityTest(std::string& )
 
     return result;
 }
+
+bool GeometryTrianglePacketTest(std::string& )
+{
+    // A fan of triangles around the z axis, shifted such that some of them are crossed by the rays
+    std::vector<MathVector3f> vertices;
+    for (size_t i = 0; i < 11; i++)
+    {
+        float angle = 0.6f * i;
+        MathVector3f offset(0.3f * cosf(angle), 0.3f * sinf(angle), 1.0f + 0.5f * i);
+        vertices.push_back(offset + MathVector3f(-0.5f, -0.5f, 0.0f));
+        vertices.push_back(offset + MathVector3f(0.5f, -0.5f, 0.2f));
+        vertices.push_back(offset + MathVector3f(0.0f, 0.5f, -0.2f));
+    }
+
+    std::vector<GeometryTrianglePacket> packets;
+    for (size_t i = 0; i < vertices.size() / 3; i++)
+    {
+        if (packets.empty() || packets.back().isFull())
+            packets.push_back(GeometryTrianglePacket());
+        packets.back().add(vertices[3 * i], vertices[3 * i + 1], vertices[3 * i + 2], 7, i);
+    }
+    if (packets.size() != 2 || packets[1].getCount() != 3 || packets[1].getFaceIndex(2) != 10 || packets[0].getGeometryId(0) != 7)
+        { std::cout << "Error in line " <<  __LINE__ -1 << std::endl; return false;}
+
+    const float infinity = std::numeric_limits<float>::infinity();
+    for (int x = -4; x <= 4; x++)
+    {
+        for (int y = -4; y <= 4; y++)
+        {
+            // The all hits and any hit kernels agree with the scalar test, and the distances match the z coordinate of the hit
+            GeometryRay ray(MathVector3f(0.1f * x, 0.1f * y, 0.0f), MathVector3f(0.0f, 0.0f, 1.0f));
+            for (size_t p = 0; p < packets.size(); p++)
+            {
+                float distances[GeometryTrianglePacket::WIDTH];
+                uint32_t mask = packets[p].intersect(ray, -infinity, infinity, distances);
+                for (size_t j = 0; j < packets[p].getCount(); j++)
+                {
+                    size_t i = packets[p].getFaceIndex(j);
+                    bool hit = MathGeometry::hitsTriangle<float>(ray, vertices[3 * i], vertices[3 * i + 1], vertices[3 * i + 2]);
+                    if (hit != (((mask >> j) & 1) != 0))
+                        { std::cout << "Error in line " <<  __LINE__ -1 << std::endl; return false;}
+
+                    if (hit && fabs(distances[j] - (1.0f + 0.5f * i)) > 0.21f)
+                        { std::cout << "Error in line " <<  __LINE__ -1 << std::endl; return false;}
+                }
+                if (packets[p].intersectAny(ray, -infinity, infinity) != (mask != 0))
+                    { std::cout << "Error in line " <<  __LINE__ -1 << std::endl; return false;}
+
+                // The triangles beyond the end of the segment are ignored
+                if ((packets[p].intersect(ray, 0.0f, 0.5f) != 0) || (packets[p].intersect(ray, -infinity, infinity) != packets[p].intersect(ray, 0.0f, 10.0f)))
+                    { std::cout << "Error in line " <<  __LINE__ -1 << std::endl; return false;}
+            }
+        }
+    }
+
+    std::cout << "GeometryTrianglePacketTest SUCCESS" << std::endl;
+
+    return true;
+}
+
+/** @brief Create the scene of the occluder visibility tests: a wall in the plane x = 0, three cubes hidden behind the wall, one cube in front of the wall
+and one cube beyond the extent of the wall*/
+static GeometryOccluderSet* createWallAndCubesScene(HelperTriangleMeshContainer* meshContainer)
+{
+    HelperTriangleMesh* wall = HelperSyntheticMeshBuilder::generateRegularGrid(0);
+    HelperSyntheticMeshBuilder::rotate(wall, 0.0, (float)M_PI_2, 0.0);
+    HelperSyntheticMeshBuilder::scale(wall, 2.0);
+    meshContainer->add(wall);
+
+    std::vector<MathVector3f> positions = { MathVector3f(0.5f, 0.0f, 0.0f), MathVector3f(0.5f, 0.3f, 0.2f), MathVector3f(0.8f, -0.3f, 0.0f),
+                                            MathVector3f(-0.5f, 0.0f, 0.0f), MathVector3f(0.5f, 3.0f, 0.0f) };
+    for (auto& position : positions)
+    {
+        HelperTriangleMesh* cube = HelperSyntheticMeshBuilder::generateCube(0);
+        HelperSyntheticMeshBuilder::scale(cube, 0.1f);
+        HelperSyntheticMeshBuilder::translate(cube, position);
+        meshContainer->add(cube);
+    }
+    return DemoHelper::createOccluderSet(meshContainer);
+}
+
+bool HierarchicalVisibilityTest(std::string&)
+{
+    HelperTriangleMeshContainer* meshContainer = new HelperTriangleMeshContainer();
+    GeometryOccluderSet* occluderSet = createWallAndCubesScene(meshContainer);
+
+    // The wall, the cube in front of the wall and the cube beyond its extent are visible, the cubes behind the wall are hidden
+    std::vector<VisibilityResult> expected = { VISIBLE, HIDDEN, HIDDEN, HIDDEN, VISIBLE, VISIBLE };
+
+    std::vector<float> v0;
+    DemoHelper::generatePolygon(v0, 4, 0.1f, -3.14519f, 1.0f);
+
+    VisibilityExactQueryConfiguration config;
+    std::vector<VisibilityResult> results;
+    VisibilityResult result = areOccludersVisible(occluderSet, &v0[0], v0.size() / 3, results, config);
+
+    bool success = result == VISIBLE && results == expected;
+    std::cout << "HierarchicalVisibilityTest " << (success ? "SUCCESS" : "FAILED") << std::endl;
+
+    delete occluderSet;
+    delete meshContainer;
+    return success;
+}
+
+bool PointVisibilityTest(std::string&)
+{
+    // A wall in the plane x = 0, of extent [-1, 1] along y and z
+    HelperTriangleMeshContainer* meshContainer = new HelperTriangleMeshContainer();
+
+    HelperTriangleMesh* wall = HelperSyntheticMeshBuilder::generateRegularGrid(0);
+    HelperSyntheticMeshBuilder::rotate(wall, 0.0, (float)M_PI_2, 0.0);
+    HelperSyntheticMeshBuilder::scale(wall, 2.0);
+    meshContainer->add(wall);
+
+    GeometryOccluderSet* occluderSet = DemoHelper::createOccluderSet(meshContainer);
+
+    std::vector<float> point0 = { -1.0f, 0.0f, 0.0f };
+    std::vector<float> points1 = { 1.0f, 0.0f, 0.0f,  1.0f, 0.5f, 0.3f,  -0.5f, 1.0f, 0.0f,  1.0f, 5.0f, 0.0f };
+    std::vector<VisibilityResult> expected = { HIDDEN, HIDDEN, VISIBLE, VISIBLE };
+
+    std::vector<VisibilityResult> results(expected.size(), UNKNOWN);
+    bool success = arePointsVisible(occluderSet, &point0[0], &points1[0], expected.size(), &results[0]) == VISIBLE && results == expected;
+
+    // The shadow ray and the exact query agree on each pair of points
+    VisibilityExactQueryConfiguration config;
+    HelperStatisticAggregator statistics;
+    VisibilityExactQueryConfiguration queryConfig;
+    queryConfig.statistics = &statistics;
+    for (size_t i = 0; i < expected.size(); i++)
+    {
+        success = success && areVisible(occluderSet, &point0[0], 1, &points1[3 * i], 1, config) == expected[i];
+        success = success && areVisible(occluderSet, &point0[0], 1, &points1[3 * i], 1, queryConfig) == expected[i];
+    }
+    success = success && arePointsVisible(occluderSet, &point0[0], &points1[0], 2) == HIDDEN;
+
+    // The BVH of the scene must be updated after a change of the occluders, before which areVisible tests each face of the occluders
+    MathMatrixf transformation;
+    transformation.setRotateZ(0.0f);
+    transformation.setTranslation(MathVector3f(0.0f, 0.0f, 1.5f));
+    occluderSet->transformOccluder(0, transformation);
+    std::vector<float> movedPoint1 = { 1.0f, 0.0f, 2.0f };
+    success = success && arePointsVisible(occluderSet, &point0[0], &points1[0], 1) == FAILURE;
+    success = success && areVisible(occluderSet, &point0[0], 1, &points1[0], 1, config) == VISIBLE
+        && areVisible(occluderSet, &point0[0], 1, &movedPoint1[0], 1, queryConfig) == HIDDEN;
+    occluderSet->removeOccluder(0);
+    occluderSet->updateBvh();
+    success = success && arePointsVisible(occluderSet, &point0[0], &points1[0], expected.size(), &results[0]) == VISIBLE
+        && std::count(results.begin(), results.end(), VISIBLE) == (int)expected.size();
+
+    std::cout << "PointVisibilityTest " << (success ? "SUCCESS" : "FAILED") << std::endl;
+
+    delete occluderSet;
+    delete meshContainer;
+    return success;
+}
+
+bool CoherenceCacheTest(std::string&)
+{
+    // A wall in the plane x = 0 hiding the target from the source, behind a small cube that does not block the source alone
+    HelperTriangleMeshContainer* meshContainer = new HelperTriangleMeshContainer();
+
+    HelperTriangleMesh* cube = HelperSyntheticMeshBuilder::generateCube(0);
+    HelperSyntheticMeshBuilder::scale(cube, 0.08f);
+    HelperSyntheticMeshBuilder::translate(cube, MathVector3f(-0.5f, 0.0f, 0.0f));
+    meshContainer->add(cube);
+
+    HelperTriangleMesh* wall = HelperSyntheticMeshBuilder::generateRegularGrid(0);
+    HelperSyntheticMeshBuilder::rotate(wall, 0.0, (float)M_PI_2, 0.0);
+    HelperSyntheticMeshBuilder::scale(wall, 3.0);
+    meshContainer->add(wall);
+
+    GeometryOccluderSet* occluderSet = DemoHelper::createOccluderSet(meshContainer);
+
+    std::vector<float> v0, v1;
+    DemoHelper::generatePolygon(v0, 4, 0.5f, -3.14519f, 1.0f);
+    DemoHelper::generatePolygon(v1, 5, 0.5f, 0.0f, 1.0f);
+
+    // The first query fills the cache: the second query splits the edges of the wall first, and is resolved with far fewer splits
+    VisibilityCoherenceCache cache;
+    long long splits[2];
+    bool success = true;
+    for (size_t i = 0; i < 2; i++)
+    {
+        HelperStatisticAggregator statistics;
+        VisibilityExactQueryConfiguration config;
+        config.statistics = &statistics;
+        config.coherenceCache = &cache;
+        config.coherenceCell = 1;
+        success = success && areVisible(occluderSet, &v0[0], v0.size() / 3, &v1[0], v1.size() / 3, config) == HIDDEN;
+        splits[i] = statistics.get(POLYTOPE_SPLIT_COUNT);
+        success = success && (cache.getHitCount() > 0) == (i > 0);
+    }
+    success = success && splits[1] < splits[0];
+
+    std::cout << "CoherenceCacheTest " << (success ? "SUCCESS" : "FAILED") << std::endl;
+
+    delete occluderSet;
+    delete meshContainer;
+    return success;
+}
+
+bool ParallelVisibilityTest(std::string&)
+{
+    // Two walls with a thin slot: the visibility of the parts of the sources differs, such that the subdivided queries do not share their result
+    HelperTriangleMeshContainer* meshContainer = DemoHelper::createScene(2, 1.0f);
+    GeometryOccluderSet* occluderSet = DemoHelper::createOccluderSet(meshContainer);
+
+    const size_t threadCount = 4;
+    const size_t taskCount = 16;
+    std::vector<float> phis = { 0.1f, 0.2f, 0.3f, 0.5f };
+    std::vector<float> sizes = { 0.05f, 0.05f, 0.3f, 0.3f };
+
+    // Each source is split until the pool holds 4 tasks per thread: the parallel queries, cancelled or not, agree with the serial query
+    bool success = true;
+    size_t hiddenCount = 0;
+    for (size_t i = 0; i < phis.size(); i++)
+    {
+        std::vector<float> v0, v1;
+        DemoHelper::generatePolygon(v0, 4, sizes[i], phis[i] - 3.14519f, 1.0f);
+        DemoHelper::generatePolygon(v1, 4, sizes[i], phis[i], 1.0f);
+
+        VisibilityExactQueryConfiguration config;
+        VisibilityResult expected = areVisible(occluderSet, &v0[0], v0.size() / 3, &v1[0], v1.size() / 3, config);
+        hiddenCount += expected == HIDDEN;
+
+        HelperStatisticAggregator statistics;
+        config.threadCount = threadCount;
+        success = success && areVisible(occluderSet, &v0[0], v0.size() / 3, &v1[0], v1.size() / 3, config) == expected;
+        config.detectApertureOnly = false;
+        config.statistics = &statistics;
+        success = success && areVisible(occluderSet, &v0[0], v0.size() / 3, &v1[0], v1.size() / 3, config) == expected
+            && statistics.getQueryCount() == (long long)taskCount;
+    }
+    success = success && hiddenCount > 0 && hiddenCount < phis.size();
+
+    // All the parts of the sources see through the slot: the first task finding an aperture cancels the tasks that have not started their query,
+    // such that at most one query per thread is performed
+    std::vector<float> v0, v1;
+    DemoHelper::generatePolygon(v0, 4, 0.14f, -3.14519f, 1.0f);
+    DemoHelper::generatePolygon(v1, 4, 0.14f, 0.0f, 1.0f);
+    long long queryCounts[2] = { 0, 0 };
+    for (bool detectApertureOnly : { false, true })
+    {
+        HelperStatisticAggregator statistics;
+        VisibilityExactQueryConfiguration config;
+        config.threadCount = threadCount;
+        config.detectApertureOnly = detectApertureOnly;
+        config.statistics = &statistics;
+        success = success && areVisible(occluderSet, &v0[0], v0.size() / 3, &v1[0], v1.size() / 3, config) == VISIBLE;
+        queryCounts[detectApertureOnly] = statistics.getQueryCount();
+    }
+    success = success && queryCounts[0] == (long long)taskCount && queryCounts[1] <= (long long)threadCount;
+
+    std::cout << "ParallelVisibilityTest " << (success ? "SUCCESS" : "FAILED") << std::endl;
+
+    delete occluderSet;
+    delete meshContainer;
+    return success;
+}
+
+bool StatisticAggregatorTest(std::string&)
+{
+    HelperTriangleMeshContainer* meshContainer = DemoHelper::createScene(2, 1.0f);
+    GeometryOccluderSet* occluderSet = DemoHelper::createOccluderSet(meshContainer);
+
+    std::vector<float> v0, v1;
+    DemoHelper::generatePolygon(v0, 4, 0.3f, 0.5f - 3.14519f, 1.0f);
+    DemoHelper::generatePolygon(v1, 4, 0.3f, 0.5f, 1.0f);
+
+    // The statistics of a query performed several times are summed, whether the queries are performed one after the other or by concurrent threads
+    const size_t queryCount = 4;
+    HelperStatisticAggregator single, serial, concurrent;
+    VisibilityExactQueryConfiguration config;
+    config.statistics = &single;
+    bool success = areVisible(occluderSet, &v0[0], v0.size() / 3, &v1[0], v1.size() / 3, config) == HIDDEN;
+
+    config.statistics = &serial;
+    for (size_t i = 0; i < queryCount; i++)
+    {
+        areVisible(occluderSet, &v0[0], v0.size() / 3, &v1[0], v1.size() / 3, config);
+    }
+
+    config.statistics = &concurrent;
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < queryCount; i++)
+    {
+        threads.push_back(std::thread([&]() { areVisible(occluderSet, &v0[0], v0.size() / 3, &v1[0], v1.size() / 3, config); }));
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    success = success && single.getQueryCount() == 1 && serial.getQueryCount() == (long long)queryCount
+        && concurrent.getQueryCount() == (long long)queryCount && single.get(RAY_COUNT) > 0;
+    for (size_t i = 0; i < COUNTER_LAST; i++)
+    {
+        CounterType counter = (CounterType)i;
+        success = success && serial.get(counter) == (long long)queryCount * single.get(counter) && concurrent.get(counter) == serial.get(counter);
+    }
+#ifndef DISABLE_TIMERS
+    success = success && serial.getTime(VISIBILITY_QUERY) > 0.0 && concurrent.getTime(VISIBILITY_QUERY) > 0.0;
+#endif
+
+    std::cout << "StatisticAggregatorTest " << (success ? "SUCCESS" : "FAILED") << std::endl;
+
+    delete occluderSet;
+    delete meshContainer;
+    return success;
+}
+
+bool OcclusionTreeHistogramTest(std::string&)
+{
+    // The bucket of a value is the number of bits of the value, the last bucket counting all the larger values
+    bool success = getHistogramBucket(0) == 0 && getHistogramBucket(1) == 1 && getHistogramBucket(3) == 2 && getHistogramBucket(4) == 3
+        && getHistogramBucket(std::numeric_limits<long long>::max()) == HISTOGRAM_BUCKET_COUNT - 1;
+
+    HelperTriangleMeshContainer* meshContainer = DemoHelper::createScene(2, 1.0f);
+    GeometryOccluderSet* occluderSet = DemoHelper::createOccluderSet(meshContainer);
+
+    std::vector<float> v0, v1;
+    DemoHelper::generatePolygon(v0, 4, 0.3f, 0.5f - 3.14519f, 1.0f);
+    DemoHelper::generatePolygon(v1, 4, 0.3f, 0.5f, 1.0f);
+
+    HelperStatisticAggregator single, twice;
+    VisibilityExactQueryConfiguration config;
+    config.statistics = &single;
+    success = success && areVisible(occluderSet, &v0[0], v0.size() / 3, &v1[0], v1.size() / 3, config) == HIDDEN;
+    config.statistics = &twice;
+    for (size_t i = 0; i < 2; i++)
+    {
+        areVisible(occluderSet, &v0[0], v0.size() / 3, &v1[0], v1.size() / 3, config);
+    }
+
+    // Each node of the occlusion tree is counted once in each histogram, the root being the only node at depth 1,
+    // and the deepest node is counted in the last non empty bucket of the depths
+    long long nodeCounts[HISTOGRAM_LAST] = {};
+    size_t lastBucket = 0;
+    for (size_t i = 0; i < HISTOGRAM_BUCKET_COUNT; i++)
+    {
+        for (size_t j = 0; j < HISTOGRAM_LAST; j++)
+        {
+            HistogramType histogram = (HistogramType)j;
+            nodeCounts[j] += single.getHistogram(histogram, i);
+            success = success && twice.getHistogram(histogram, i) == 2 * single.getHistogram(histogram, i);
+        }
+        if (single.getHistogram(TREE_DEPTH_HISTOGRAM, i) > 0)
+            lastBucket = i;
+    }
+    success = success && single.getHistogram(TREE_DEPTH_HISTOGRAM, getHistogramBucket(1)) == 1 && single.get(POLYTOPE_SPLIT_COUNT) > 0
+        && nodeCounts[TREE_DEPTH_HISTOGRAM] > single.get(POLYTOPE_SPLIT_COUNT)
+        && nodeCounts[POLYTOPE_VERTEX_HISTOGRAM] == nodeCounts[TREE_DEPTH_HISTOGRAM] && nodeCounts[POLYTOPE_EDGE_HISTOGRAM] == nodeCounts[TREE_DEPTH_HISTOGRAM]
+        && lastBucket == getHistogramBucket(single.getMax(OCCLUSION_TREE_DEPTH)) && twice.getMax(OCCLUSION_TREE_DEPTH) == single.getMax(OCCLUSION_TREE_DEPTH);
+
+    std::cout << "OcclusionTreeHistogramTest " << (success ? "SUCCESS" : "FAILED") << std::endl;
+
+    delete occluderSet;
+    delete meshContainer;
+    return success;
+}
+
+/** @brief The occluder collections compared by collectTriangles()*/
+enum TestOccluderCollection
+{
+    CYLINDER_COLLECTION,    /**< @brief The former collection: the cylinder around the central line enclosing the extremal stabbing lines, tested against the enclosing circle of each triangle*/
+    HULL_COLLECTION,        /**< @brief VisibilityExactQueryConfiguration::STABBING_LINE_HULL*/
+    PACKET_COLLECTION       /**< @brief VisibilityExactQueryConfiguration::RAY_PACKET, with the central line*/
+};
+
+/** @brief Return the mask of the triangles collected for a bundle of parallel lines joining a square of the plane z = 0 to the same square of the plane z = 1
+
+The triangles lie in the plane z = 0.5: the first one crosses the bundle, the second one is a long thin triangle beside the bundle,
+and the third one is a small triangle inside the bundle, between its central line and its extremal lines.
+*/
+static uint32_t collectTriangles(TestOccluderCollection collection)
+{
+    std::vector<std::pair<MathVector3d, MathVector3d>> segments = { std::make_pair(MathVector3d(0.0, 0.0, 0.0), MathVector3d(0.0, 0.0, 1.0)) };
+    for (double x : { -0.1, 0.1 })
+    {
+        for (double y : { -0.1, 0.1 })
+        {
+            segments.push_back(std::make_pair(MathVector3d(x, y, 0.0), MathVector3d(x, y, 1.0)));
+        }
+    }
+
+    GeometryTrianglePacket triangles;
+    triangles.add(MathVector3f(-1.0f, -1.0f, 0.5f), MathVector3f(1.0f, -1.0f, 0.5f), MathVector3f(0.0f, 1.0f, 0.5f), 0, 0);
+    triangles.add(MathVector3f(-5.0f, 0.15f, 0.5f), MathVector3f(5.0f, 0.15f, 0.5f), MathVector3f(5.0f, 0.2f, 0.5f), 0, 1);
+    triangles.add(MathVector3f(0.05f, 0.05f, 0.5f), MathVector3f(0.06f, 0.05f, 0.5f), MathVector3f(0.05f, 0.06f, 0.5f), 0, 2);
+
+    uint32_t mask = 0;
+    if (collection == PACKET_COLLECTION)
+    {
+        const float infinity = std::numeric_limits<float>::infinity();
+        for (auto& segment : segments)
+        {
+            GeometryRay ray(convert<MathVector3f>(segment.first), convert<MathVector3f>((segment.second - segment.first).getNormalized()));
+            mask |= triangles.intersect(ray, -infinity, infinity);
+        }
+        return mask;
+    }
+
+    GeometryStabbingLineHull hull;
+    hull.build(segments, MathPlane3d(0.0, 0.0, 1.0, 0.0), MathPlane3d(0.0, 0.0, 1.0, -1.0));
+    double radius = 0.0;
+    for (auto& segment : segments)
+    {
+        radius = std::max(radius, std::max((segment.first - segments[0].first).getNorm(), (segment.second - segments[0].second).getNorm()));
+    }
+    GeometryRay centralRay(convert<MathVector3f>(segments[0].first), MathVector3f(0.0f, 0.0f, 1.0f));
+    for (size_t j = 0; j < triangles.getCount(); j++)
+    {
+        bool hit = collection == HULL_COLLECTION ? hull.intersects(triangles.getVertex(j, 0), triangles.getVertex(j, 1), triangles.getVertex(j, 2))
+            : MathGeometry::hitsCylinder<float>(centralRay, (float)radius, triangles.getVertex(j, 0), triangles.getVertex(j, 1), triangles.getVertex(j, 2));
+        mask |= (uint32_t)hit << j;
+    }
+    return mask;
+}
+
+bool RayPacketTest(std::string&)
+{
+    // The packet of lines only collects the triangle crossing the bundle, among the triangles collected by the hull and the three triangles collected by the cylinder
+    uint32_t packetMask = collectTriangles(PACKET_COLLECTION);
+    bool success = packetMask == 1 && (packetMask & ~collectTriangles(HULL_COLLECTION)) == 0 && collectTriangles(CYLINDER_COLLECTION) == 7;
+
+    // The occluders collected by the packet give the visibility of the sources
+    HelperTriangleMeshContainer* meshContainer = DemoHelper::createScene(2, 1.0f);
+    GeometryOccluderSet* occluderSet = DemoHelper::createOccluderSet(meshContainer);
+
+    std::vector<float> phis = { 0.3f, 0.5f };
+    std::vector<VisibilityResult> expected = { VISIBLE, HIDDEN };
+    for (size_t i = 0; i < phis.size(); i++)
+    {
+        std::vector<float> v0, v1;
+        DemoHelper::generatePolygon(v0, 4, 0.3f, phis[i] - 3.14519f, 1.0f);
+        DemoHelper::generatePolygon(v1, 4, 0.3f, phis[i], 1.0f);
+
+        VisibilityExactQueryConfiguration config;
+        config.detectApertureOnly = false;
+        config.occluderCollection = VisibilityExactQueryConfiguration::RAY_PACKET;
+        success = success && areVisible(occluderSet, &v0[0], v0.size() / 3, &v1[0], v1.size() / 3, config) == expected[i];
+    }
+
+    std::cout << "RayPacketTest " << (success ? "SUCCESS" : "FAILED") << std::endl;
+
+    delete occluderSet;
+    delete meshContainer;
+    return success;
+}
+
+bool StabbingLineHullTest(std::string&)
+{
+    // The hull of segments joining a square of the plane z = 0 to a smaller square of the plane z = 1 is a frustum
+    std::vector<std::pair<MathVector3d, MathVector3d>> segments;
+    for (double x : { -1.0, 1.0 })
+    {
+        for (double y : { -1.0, 1.0 })
+        {
+            segments.push_back(std::make_pair(MathVector3d(x, y, 0.0), MathVector3d(0.2 * x, 0.2 * y, 1.0)));
+        }
+    }
+    GeometryStabbingLineHull hull;
+    hull.build(segments, MathPlane3d(0.0, 0.0, 1.0, 0.0), MathPlane3d(0.0, 0.0, 1.0, -1.0));
+
+    // A triangle outside the frustum but inside the bounding box of the segments is rejected by a plane of the hull
+    bool success = hull.intersects(MathVector3f(0.0f, 0.0f, 0.5f), MathVector3f(0.5f, 0.0f, 0.5f), MathVector3f(0.0f, 0.5f, 0.5f))
+        && !hull.intersects(MathVector3f(5.0f, 0.0f, 0.5f), MathVector3f(6.0f, 0.0f, 0.5f), MathVector3f(5.0f, 1.0f, 0.5f))
+        && !hull.intersects(MathVector3f(0.9f, 0.9f, 0.9f), MathVector3f(0.95f, 0.9f, 0.9f), MathVector3f(0.9f, 0.95f, 0.9f))
+        && hull.intersects(MathVector3f(-0.1f, -0.1f, 0.4f), MathVector3f(0.1f, 0.1f, 0.6f))
+        && !hull.intersects(MathVector3f(0.8f, 0.8f, 0.8f), MathVector3f(0.95f, 0.95f, 0.95f));
+
+    // The hull rejects the long thin triangle beside the bundle of lines, collected by the cylinder, and keeps the triangles between the lines
+    success = success && collectTriangles(HULL_COLLECTION) == 5 && collectTriangles(CYLINDER_COLLECTION) == 7;
+
+    std::cout << "StabbingLineHullTest " << (success ? "SUCCESS" : "FAILED") << std::endl;
+    return success;
+}
+
+bool SilhouetteBvhTest(std::string&)
+{
+    HelperTriangleMeshContainer* meshContainer = DemoHelper::createScene(2, 1.0f);
+    GeometryOccluderSet* occluderSet = DemoHelper::createOccluderSet(meshContainer);
+
+    // The same silhouettes are traced with the BVH of the scene, with a BVH of the silhouettes and by testing each of their faces.
+    // The silhouettes first contain two thirds of the faces of each occluder, then all of them
+    SilhouetteContainerBvh sceneContainer(occluderSet);
+    SilhouetteContainerBvh silhouetteContainer;
+    SilhouetteContainer bruteForceContainer;
+    SilhouetteContainer* containers[3] = { &sceneContainer, &silhouetteContainer, &bruteForceContainer };
+    std::vector<Silhouette*> silhouettes[3];
+    for (size_t i = 0; i < 3; i++)
+    {
+        for (size_t geometryId = 0; geometryId < occluderSet->getOccluderCount(); geometryId++)
+        {
+            silhouettes[i].push_back(new Silhouette(*occluderSet->getOccluderConnectedFaces(geometryId), geometryId));
+            containers[i]->addSilhouette(silhouettes[i].back());
+        }
+    }
+
+    bool success = true;
+    size_t hitCount = 0;
+    for (size_t round = 0; round < 2; round++)
+    {
+        for (size_t i = 0; i < 3; i++)
+        {
+            for (Silhouette* silhouette : silhouettes[i])
+            {
+                for (const SilhouetteMeshFace& face : silhouette->getMeshFaces())
+                {
+                    if ((face.getFaceIndex() % 3 == 0) == (round == 1))
+                    {
+                        silhouette->addFace(face);
+                    }
+                }
+            }
+        }
+        sceneContainer.prepare();
+        silhouetteContainer.prepare();
+
+        // The rays cross the walls, through and around their slots: each container reports the same nearest face of each silhouette hit
+        const float infinity = std::numeric_limits<float>::infinity();
+        for (int y = -8; y <= 8; y++)
+        {
+            for (int z = -8; z <= 8; z++)
+            {
+                MathVector3f direction(1.0f, 0.01f * z, -0.02f * y);
+                direction.normalize();
+                GeometryRay ray(MathVector3f(-2.0f, 0.013f + 0.1f * y, 0.007f + 0.1f * z), direction);
+
+                std::vector<std::pair<size_t, size_t>> faces[3];
+                for (size_t i = 0; i < 3; i++)
+                {
+                    std::vector<SilhouetteHit> hits;
+                    containers[i]->intersectSilhouettes(ray, 0.0f, infinity, hits);
+                    for (const SilhouetteHit& hit : hits)
+                    {
+                        faces[i].push_back(std::make_pair(hit.mSilhouette->getGeometryId(), hit.mFaceIndex));
+                    }
+                    std::sort(faces[i].begin(), faces[i].end());
+                }
+                success = success && faces[0] == faces[2] && faces[1] == faces[2];
+                hitCount += faces[2].size();
+            }
+        }
+    }
+    success = success && hitCount > 0;
+
+    std::cout << "SilhouetteBvhTest " << (success ? "SUCCESS" : "FAILED") << std::endl;
+
+    delete occluderSet;
+    delete meshContainer;
+    return success;
+}
+
+bool SplitOrderingTest(std::string&)
+{
+    // A wall in the plane x = 0 of extent [-0.5, 0.5], and a small cube in front of it: the small sources are hidden, the large ones are visible
+    HelperTriangleMeshContainer* meshContainer = new HelperTriangleMeshContainer();
+
+    HelperTriangleMesh* cube = HelperSyntheticMeshBuilder::generateCube(0);
+    HelperSyntheticMeshBuilder::scale(cube, 0.08f);
+    HelperSyntheticMeshBuilder::translate(cube, MathVector3f(-0.5f, 0.05f, 0.0f));
+    meshContainer->add(cube);
+
+    HelperTriangleMesh* wall = HelperSyntheticMeshBuilder::generateRegularGrid(0);
+    HelperSyntheticMeshBuilder::rotate(wall, 0.0, (float)M_PI_2, 0.0);
+    meshContainer->add(wall);
+
+    GeometryOccluderSet* occluderSet = DemoHelper::createOccluderSet(meshContainer);
+
+    std::vector<float> sizes = { 0.2f, 0.3f, 0.8f };
+    std::vector<VisibilityResult> expected = { HIDDEN, HIDDEN, VISIBLE };
+    std::vector<VisibilityExactQueryConfiguration::SplitOrderingType> orderings = { VisibilityExactQueryConfiguration::DEPTH,
+        VisibilityExactQueryConfiguration::ANGULAR_EXTENT, VisibilityExactQueryConfiguration::LINES_BLOCKED };
+
+    // The orderings of the heap only change the order of the splits, not the visibility
+    bool success = true;
+    for (auto ordering : orderings)
+    {
+        for (size_t i = 0; i < sizes.size(); i++)
+        {
+            std::vector<float> v0, v1;
+            DemoHelper::generatePolygon(v0, 4, sizes[i], -3.14519f, 1.0f);
+            DemoHelper::generatePolygon(v1, 5, sizes[i], 0.0f, 1.0f);
+
+            VisibilityExactQueryConfiguration config;
+            config.splitOrdering = ordering;
+            success = success && areVisible(occluderSet, &v0[0], v0.size() / 3, &v1[0], v1.size() / 3, config) == expected[i];
+        }
+    }
+
+    std::cout << "SplitOrderingTest " << (success ? "SUCCESS" : "FAILED") << std::endl;
+
+    delete occluderSet;
+    delete meshContainer;
+    return success;
+}
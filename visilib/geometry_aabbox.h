@@ -20,6 +20,7 @@ along with Visilib. If not, see <http://www.gnu.org/licenses/>
 
 #pragma once
 
+#include <algorithm>
 #include "math_vector_3.h"
 
 namespace visilib
@@ -48,6 +49,8 @@ namespace visilib
         {
         }
 
+        GeometryAABB& operator=(const GeometryAABB& aBox) = default;
+
         const MathVector3f& getMin() const
         {
             return mMin;
@@ -63,6 +66,21 @@ namespace visilib
             mMin = aMin; mMax = aMax;
         }
 
+        /** @brief Extend the box such that it contains another box*/
+        void add(const GeometryAABB& aBox)
+        {
+            mMin.x = std::min(mMin.x, aBox.mMin.x); mMin.y = std::min(mMin.y, aBox.mMin.y); mMin.z = std::min(mMin.z, aBox.mMin.z);
+            mMax.x = std::max(mMax.x, aBox.mMax.x); mMax.y = std::max(mMax.y, aBox.mMax.y); mMax.z = std::max(mMax.z, aBox.mMax.z);
+        }
+
+        /** @brief Test if the box overlaps another box (touching boxes are considered as overlapping)*/
+        bool intersects(const GeometryAABB& aBox) const
+        {
+            return mMin.x <= aBox.mMax.x && aBox.mMin.x <= mMax.x
+                && mMin.y <= aBox.mMax.y && aBox.mMin.y <= mMax.y
+                && mMin.z <= aBox.mMax.z && aBox.mMin.z <= mMax.z;
+        }
+
 
     private:
         MathVector3f mMin;
@@ -0,0 +1,148 @@
+/*
+Visilib, an open source library for exact visibility computation.
+Copyright(C) 2021 by Denis Haumont
+
+This file is part of Visilib.
+
+Visilib is free software : you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Visilib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Visilib. If not, see <http://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include "geometry_aabbox.h"
+#include "geometry_occluder_set.h"
+
+namespace visilib
+{
+    /** @brief Node of a GeometryOccluderHierarchy*/
+
+    struct GeometryOccluderHierarchyNode
+    {
+        GeometryAABB mBox;      /**< @brief The bounding box of all the occluders of the node*/
+        size_t mChildren[2];    /**< @brief The indices of the two child nodes (undefined for a leaf)*/
+        size_t mBegin;          /**< @brief The index of the first occluder of the node in the ordered occluder list*/
+        size_t mEnd;            /**< @brief The index following the last occluder of the node in the ordered occluder list*/
+
+        bool isLeaf() const
+        {
+            return mEnd - mBegin == 1;
+        }
+    };
+
+    /** @brief Binary hierarchy of the occluders of a scene, built from the occluders bounding boxes.
+
+    The hierarchy is used for object-level visibility queries: the bounding box of a node encloses all the occluders of its subtree,
+    such that a whole group of occluders can be classified as hidden by a single query against the box of the group.
+    The hierarchy is built top-down by splitting the occluders at the median of their box centers along the largest axis.
+    */
+
+    class GeometryOccluderHierarchy
+    {
+    public:
+        /** @brief Build the hierarchy of the occluders of a scene. The bounding boxes of the scene must have been computed by GeometryOccluderSet::prepare()*/
+        GeometryOccluderHierarchy(const GeometryOccluderSet* aScene);
+
+        size_t getNodeCount() const
+        {
+            return mNodes.size();
+        }
+
+        /** @brief Return a node of the hierarchy. The root node is stored at index 0.*/
+        const GeometryOccluderHierarchyNode& getNode(size_t i) const
+        {
+            return mNodes[i];
+        }
+
+        /** @brief Return the occluder id stored at a given position of the ordered occluder list*/
+        size_t getOccluder(size_t i) const
+        {
+            return mOccluders[i];
+        }
+
+    private:
+        size_t build(const GeometryOccluderSet* aScene, size_t aBegin, size_t anEnd);
+
+        std::vector<GeometryOccluderHierarchyNode> mNodes;  /**< @brief The nodes of the hierarchy*/
+        std::vector<size_t> mOccluders;                    /**< @brief The occluder ids, ordered such that each node references a contiguous range*/
+    };
+
+    inline GeometryOccluderHierarchy::GeometryOccluderHierarchy(const GeometryOccluderSet* aScene)
+    {
+        // The removed occluders are not part of the hierarchy
+        for (size_t i = 0; i < aScene->getOccluderCount(); i++)
+        {
+            if (aScene->hasOccluder(i))
+            {
+                mOccluders.push_back(i);
+            }
+        }
+
+        size_t myCount = mOccluders.size();
+        if (myCount == 0)
+        {
+            return;
+        }
+        mNodes.reserve(2 * myCount - 1);
+        build(aScene, 0, myCount);
+    }
+
+    inline size_t GeometryOccluderHierarchy::build(const GeometryOccluderSet* aScene, size_t aBegin, size_t anEnd)
+    {
+        size_t myNodeIndex = mNodes.size();
+        mNodes.push_back(GeometryOccluderHierarchyNode());
+
+        GeometryAABB myBox = aScene->getOccluderBoundingBox(mOccluders[aBegin]);
+        MathVector3f myCenterMin = (myBox.getMin() + myBox.getMax()) * 0.5f;
+        MathVector3f myCenterMax = myCenterMin;
+
+        for (size_t i = aBegin + 1; i < anEnd; i++)
+        {
+            const GeometryAABB& myOccluderBox = aScene->getOccluderBoundingBox(mOccluders[i]);
+            myBox.add(myOccluderBox);
+
+            MathVector3f myCenter = (myOccluderBox.getMin() + myOccluderBox.getMax()) * 0.5f;
+            myCenterMin.x = std::min(myCenterMin.x, myCenter.x); myCenterMin.y = std::min(myCenterMin.y, myCenter.y); myCenterMin.z = std::min(myCenterMin.z, myCenter.z);
+            myCenterMax.x = std::max(myCenterMax.x, myCenter.x); myCenterMax.y = std::max(myCenterMax.y, myCenter.y); myCenterMax.z = std::max(myCenterMax.z, myCenter.z);
+        }
+
+        mNodes[myNodeIndex].mBox = myBox;
+        mNodes[myNodeIndex].mBegin = aBegin;
+        mNodes[myNodeIndex].mEnd = anEnd;
+
+        if (anEnd - aBegin > 1)
+        {
+            MathVector3f myExtent = myCenterMax - myCenterMin;
+            int myAxis = 0;
+            if (myExtent.y > myExtent[myAxis]) myAxis = 1;
+            if (myExtent.z > myExtent[myAxis]) myAxis = 2;
+
+            size_t myMiddle = (aBegin + anEnd) / 2;
+            std::nth_element(mOccluders.begin() + aBegin, mOccluders.begin() + myMiddle, mOccluders.begin() + anEnd,
+                [aScene, myAxis](size_t a, size_t b)
+                {
+                    const GeometryAABB& myBoxA = aScene->getOccluderBoundingBox(a);
+                    const GeometryAABB& myBoxB = aScene->getOccluderBoundingBox(b);
+                    return myBoxA.getMin()[myAxis] + myBoxA.getMax()[myAxis] < myBoxB.getMin()[myAxis] + myBoxB.getMax()[myAxis];
+                });
+
+            size_t myLeft = build(aScene, aBegin, myMiddle);
+            size_t myRight = build(aScene, myMiddle, anEnd);
+            mNodes[myNodeIndex].mChildren[0] = myLeft;
+            mNodes[myNodeIndex].mChildren[1] = myRight;
+        }
+        return myNodeIndex;
+    }
+}
@@ -20,6 +20,7 @@ along with Visilib. If not, see <http://www.gnu.org/licenses/>
 
 #pragma once
 
+#include <limits>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -27,29 +28,153 @@ along with Visilib. If not, see <http://www.gnu.org/licenses/>
 #include <queue>
 #include "silhouette_mesh_face.h"
 #include "geometry_ray.h"
+#include "geometry_triangle_bvh.h"
 #include "math_geometry.h"
+#include "math_matrix_4.h"
 
 namespace visilib
 {
     struct GeometryDiscreteMeshDescription;
     class SilhouetteMeshFace;
 
+    /** @brief A change of an occluder of a prepared occluder set*/
+    struct GeometryOccluderChange
+    {
+        size_t mGeometryId;             /**< @brief The id of the occluder*/
+        GeometryAABB mOldBox;           /**< @brief The bounding box of the occluder before the change, empty if the occluder has been added*/
+        GeometryAABB mNewBox;           /**< @brief The bounding box of the occluder after the change, empty if the occluder has been removed*/
+    };
+
     /** @brief Stores the occluders against which visibility is tested. The occluders are stored under the form of a connected set of faces, that are used for efficient silhouette detection.
-    Connectivity information of the occluders is computed in a lazy way, only when required.*/
+    Connectivity information of the occluders is computed in a lazy way, only when required.
+
+    Once the set is prepared, the occluders can be added, removed, replaced or transformed individually: only the adjacency and the bounding box of the
+    changed occluder are updated. The ids of the other occluders are preserved (a removed occluder leaves an empty slot), and each change is recorded
+    with the bounding boxes of the occluder before and after the change, such that the results depending on the changed region can be recomputed.
+
+The set also stores a BVH of all the faces of the occluders, shared by the queries: it is built by prepare(), and updated by updateBvh() after a change.
+The queries only read the BVH, such that they can share it between threads: a query performed while the BVH is not up to date does not use it.
+The faces of the occluders transformed, removed, or replaced by a mesh with the same number of faces are updated in place and the boxes of their ancestors
+are refitted, at a cost proportional to their number of faces. An added occluder, or a replacement changing the number of faces, requires a complete rebuild.*/
 
     class GeometryOccluderSet
     {
     public:
-        void addOccluder(GeometryDiscreteMeshDescription* info);
+        /** @brief Add an occluder to the set
+
+        @param info: the triangle mesh of the occluder
+        @param aNeighbours: the neighbour of each edge of each face as computed by extractConnectedMeshFaces (3 per face, -1 for a border edge), optional.
+        When provided, the table must remain valid as long as the occluder set, and the adjacency of the occluder is not computed.
+        */
+        size_t addOccluder(GeometryDiscreteMeshDescription* info, const int* aNeighbours = nullptr);
+
+        /** @brief Remove an occluder from the set. The id of the occluder is not reused*/
+        void removeOccluder(size_t geometryId);
+
+        /** @brief Replace the triangle mesh of an occluder, keeping its id. The adjacency of the occluder is recomputed when required*/
+        void replaceOccluder(size_t geometryId, GeometryDiscreteMeshDescription* info, const int* aNeighbours = nullptr);
+
+        /** @brief Transform an occluder
+
+        The transformation is applied to the vertices of the triangle mesh as it has been added, such that successive transformations do not accumulate.
+        The adjacency of the occluder is preserved.
+        @param geometryId: the id of the occluder
+        @param aTransformation: the transformation of the vertices
+        */
+        void transformOccluder(size_t geometryId, const MathMatrixf& aTransformation);
+
+        /** @brief Return true if the occluder has not been removed*/
+        bool hasOccluder(size_t geometryId) const
+        {
+            return geometryId < mOccluders.size() && mOccluders[geometryId] != nullptr;
+        }
+
+        /** @brief Return the changes of the occluders performed since the set has been prepared or since the last call to clearChanges()*/
+        const std::vector<GeometryOccluderChange>& getChanges() const
+        {
+            return mChanges;
+        }
+
+        void clearChanges()
+        {
+            mChanges.clear();
+        }
 
         /** @brief Prepare the scene before ray tracing */
         void prepare();
 
+        /** @brief Prepare the scene before ray tracing, using precomputed bounding boxes of the occluders*/
+        void prepare(const std::vector<GeometryAABB>& aBoundingBoxes);
+
+        /** @brief Prepare the scene before ray tracing, using precomputed bounding boxes of the occluders and a BVH of their faces written by GeometryTriangleBvh::write()
+
+        The BVH is used without being built if each face id appears once in its packets, with the id of its occluder and its face index. Otherwise, the BVH is built.
+        @return: true if the BVH has been used
+        */
+        bool prepare(const std::vector<GeometryAABB>& aBoundingBoxes, const char* aBvhData, size_t aBvhSize);
+
+        /** @brief Return the triangle mesh of an occluder*/
+        GeometryDiscreteMeshDescription* getOccluder(size_t geometryId) const
+        {
+            return mOccluders[geometryId];
+        }
+
+        /** @brief Return the number of occluder ids, including the ids of the removed occluders*/
         size_t getOccluderCount()const
         {
             return mOccluders.size();
         }
 
+        /** @brief Return the axis aligned bounding box of an occluder, as computed by prepare()*/
+        const GeometryAABB& getOccluderBoundingBox(size_t geometryId) const
+        {
+            V_ASSERT(geometryId < mBoundingBoxes.size());
+            return mBoundingBoxes[geometryId];
+        }
+
+        /** @brief Update the BVH of the faces of all the occluders after changes of the occluders
+
+        The function is not thread safe: it is called after the changes, before the queries use the BVH.
+        */
+        void updateBvh();
+
+        /** @brief Return true if the BVH takes into account all the changes of the occluders*/
+        bool isBvhUpToDate() const
+        {
+            return !mIsBvhDirty && mBvhChanges.empty();
+        }
+
+        /** @brief Return the BVH of the faces of all the occluders, which must be up to date (updateBvh())
+
+        The key of each face in the BVH is its face id (getFaceId()).
+        */
+        const GeometryTriangleBvh& getBvh() const
+        {
+            V_ASSERT(isBvhUpToDate());
+            return mBvh;
+        }
+
+        /** @brief Return true if a segment intersects a face of an occluder
+
+        The segment is tested by an any-hit query on the BVH of the scene, without silhouette extraction nor memory allocation.
+        If the BVH is not up to date (updateBvh()), the segment is tested against each face of the occluders.
+        */
+        bool intersectsSegment(const MathVector3d& aBegin, const MathVector3d& anEnd) const;
+
+        /** @brief Return the unique id of a face of an occluder in the BVH, between 0 and getFaceIdCount()*/
+        size_t getFaceId(size_t geometryId, size_t aFace) const
+        {
+            V_ASSERT(!mIsBvhDirty);
+            return mFaceOffsets[geometryId] + aFace;
+        }
+
+        /** @brief Return the number of face ids of the BVH*/
+        size_t getFaceIdCount() const
+        {
+            V_ASSERT(!mIsBvhDirty);
+            return mFaceOffsets.empty() ? 0 : mFaceOffsets.back();
+        }
+
         /** @brief Return the list of connected faces of a mesh
 
         @param scene: the scene containing the triangle mesh
@@ -92,6 +217,21 @@ namespace visilib
             return v0 < v1 ? v0 * myFaceNumber + v1 : v1 * myFaceNumber + v0;
         }
 
+        /** @brief Compute the bounding box of an occluder from its vertices, empty if the occluder has been removed*/
+        GeometryAABB computeBoundingBox(size_t geometryId) const;
+
+        /** @brief Build the BVH of the faces of all the occluders*/
+        void buildBvh();
+
+        /** @brief Restore the BVH of the faces of all the occluders written by GeometryTriangleBvh::write(), return false if it does not match the occluders*/
+        bool readBvh(const char* aData, size_t aSize);
+
+        /** @brief Record the change of the faces of an occluder in the BVH, updated in place if the occluder keeps its number of faces*/
+        void recordBvhChange(size_t geometryId);
+
+        /** @brief Discard the adjacency of an occluder, and record the change of its bounding box and of its faces*/
+        void updateOccluder(size_t geometryId);
+
         /** @brief Compute the list of faces of a triangle mesh, containing the adjacency information
 
         The adjacency is computed in a single pass over the triangle mesh, by constructing on the fly the edge connectivity information
@@ -107,9 +247,18 @@ namespace visilib
         The faces are stored in a map indexed by the id of the mesh
         */
         std::vector<std::vector<SilhouetteMeshFace>*> mConnectedFacesCache;
-        std::unordered_map<size_t, size_t> mLastHit;
         std::vector<GeometryDiscreteMeshDescription*> mOccluders;
+        std::vector<const int*> mNeighbours;                           /**< @brief The precomputed neighbour table of each occluder, nullptr if it must be computed*/
         std::vector<GeometryAABB> mBoundingBoxes;
+        std::vector<const float*> mInitialVertices;                    /**< @brief The vertices of each occluder as it has been added, before any transformation*/
+        std::vector<std::vector<float>> mTransformedVertices;          /**< @brief The vertices of the transformed occluders*/
+        std::vector<GeometryOccluderChange> mChanges;                  /**< @brief The changes performed since the set has been prepared*/
+        bool mIsPrepared = false;                                      /**< @brief The bounding boxes have been computed: the changes are tracked*/
+        GeometryTriangleBvh mBvh;                                      /**< @brief The BVH of the faces of all the occluders*/
+        std::vector<size_t> mFaceOffsets;                              /**< @brief The face id of the first face of each occluder, followed by the number of face ids*/
+        std::vector<uint32_t> mFaceLanes;                              /**< @brief The lane of each face id in the packets of the BVH (packet * width + lane)*/
+        std::vector<size_t> mBvhChanges;                               /**< @brief The occluders whose faces are updated in place by the next updateBvh()*/
+        bool mIsBvhDirty = true;                                       /**< @brief The BVH must be built again by the next updateBvh()*/
     };
 
     inline std::vector<SilhouetteMeshFace>* GeometryOccluderSet::getOccluderConnectedFaces(size_t geometryId)
@@ -121,7 +270,28 @@ namespace visilib
             GeometryDiscreteMeshDescription* mesh = mOccluders[geometryId];
 
             myFaces = new std::vector<SilhouetteMeshFace>();
-            extractConnectedMeshFaces(mesh, *myFaces);
+            if (mesh == nullptr)
+            {
+                // A removed occluder has no face
+            }
+            else if (mNeighbours[geometryId] != nullptr)
+            {
+                const int* myNeighbours = mNeighbours[geometryId];
+
+                myFaces->resize(mesh->faceCount);
+                for (size_t i = 0; i < mesh->faceCount; i++)
+                {
+                    (*myFaces)[i].setGeometry(mesh, i);
+                    for (size_t j = 0; j < 3; j++)
+                    {
+                        (*myFaces)[i].setNeighbour(j, myNeighbours[i * 3 + j]);
+                    }
+                }
+            }
+            else
+            {
+                extractConnectedMeshFaces(mesh, *myFaces);
+            }
             mConnectedFacesCache[geometryId] = myFaces;
         }
         return mConnectedFacesCache[geometryId];
@@ -134,7 +304,10 @@ namespace visilib
         {
             GeometryDiscreteMeshDescription* mesh = mOccluders[geometryId];
 
-            setOccluderConnectedFaces(mesh, *mConnectedFacesCache[geometryId]);
+            if (mesh != nullptr && mConnectedFacesCache[geometryId] != nullptr)
+            {
+                setOccluderConnectedFaces(mesh, *mConnectedFacesCache[geometryId]);
+            }
         }
     }
 
@@ -191,21 +364,331 @@ namespace visilib
         }
     }
 
-    inline void GeometryOccluderSet::addOccluder(GeometryDiscreteMeshDescription* info)
+    inline size_t GeometryOccluderSet::addOccluder(GeometryDiscreteMeshDescription* info, const int* aNeighbours)
     {
+        size_t myGeometryId = mOccluders.size();
         mOccluders.push_back(info);
+        mNeighbours.push_back(aNeighbours);
         mConnectedFacesCache.push_back(nullptr);
+        mInitialVertices.push_back(info->vertexArray);
+        mTransformedVertices.push_back(std::vector<float>());
+        mIsBvhDirty = true;
+
+        if (mIsPrepared)
+        {
+            mBoundingBoxes.push_back(GeometryAABB(MathVector3f(FLT_MAX, FLT_MAX, FLT_MAX), MathVector3f(-FLT_MAX, -FLT_MAX, -FLT_MAX)));
+            updateOccluder(myGeometryId);
+        }
+        return myGeometryId;
+    }
+
+    inline void GeometryOccluderSet::removeOccluder(size_t geometryId)
+    {
+        V_ASSERT(hasOccluder(geometryId));
+
+        delete mOccluders[geometryId];
+        mOccluders[geometryId] = nullptr;
+        mNeighbours[geometryId] = nullptr;
+        mInitialVertices[geometryId] = nullptr;
+        std::vector<float>().swap(mTransformedVertices[geometryId]);
+        updateOccluder(geometryId);
+    }
+
+    inline void GeometryOccluderSet::replaceOccluder(size_t geometryId, GeometryDiscreteMeshDescription* info, const int* aNeighbours)
+    {
+        V_ASSERT(hasOccluder(geometryId));
+
+        if (mOccluders[geometryId] != info)
+        {
+            delete mOccluders[geometryId];
+        }
+        mOccluders[geometryId] = info;
+        mNeighbours[geometryId] = aNeighbours;
+        mInitialVertices[geometryId] = info->vertexArray;
+        std::vector<float>().swap(mTransformedVertices[geometryId]);
+        updateOccluder(geometryId);
+    }
+
+    inline void GeometryOccluderSet::transformOccluder(size_t geometryId, const MathMatrixf& aTransformation)
+    {
+        V_ASSERT(hasOccluder(geometryId));
+
+        GeometryDiscreteMeshDescription* myMesh = mOccluders[geometryId];
+        const MathVector3f* myVertices = reinterpret_cast<const MathVector3f*>(mInitialVertices[geometryId]);
+        std::vector<float>& myTransformedVertices = mTransformedVertices[geometryId];
+
+        myTransformedVertices.resize(myMesh->vertexCount * 3);
+        for (size_t i = 0; i < myMesh->vertexCount; i++)
+        {
+            MathVector3f v = aTransformation.multiply(myVertices[i]);
+            myTransformedVertices[i * 3] = v.x;
+            myTransformedVertices[i * 3 + 1] = v.y;
+            myTransformedVertices[i * 3 + 2] = v.z;
+        }
+        myMesh->vertexArray = myTransformedVertices.data();
+        recordBvhChange(geometryId);
+
+        // The topology is unchanged: the faces only reference the new vertices
+        std::vector<SilhouetteMeshFace>* myFaces = mConnectedFacesCache[geometryId];
+        if (myFaces != nullptr)
+        {
+            setOccluderConnectedFaces(myMesh, *myFaces);
+        }
+
+        if (mIsPrepared)
+        {
+            GeometryOccluderChange myChange = { geometryId, mBoundingBoxes[geometryId], computeBoundingBox(geometryId) };
+            mBoundingBoxes[geometryId] = myChange.mNewBox;
+            mChanges.push_back(myChange);
+        }
+    }
+
+    inline GeometryAABB GeometryOccluderSet::computeBoundingBox(size_t geometryId) const
+    {
+        MathVector3f myMin, myMax;
+        if (hasOccluder(geometryId))
+        {
+            GeometryDiscreteMeshDescription* myTriangleMesh = mOccluders[geometryId];
+            MathArithmetic<float>::getMinMax(myTriangleMesh->vertexArray, myTriangleMesh->vertexCount, myMin, myMax);
+        }
+        else
+        {
+            MathArithmetic<float>::getMinMax(nullptr, 0, myMin, myMax);
+        }
+        return GeometryAABB(myMin, myMax);
+    }
+
+    inline void GeometryOccluderSet::updateOccluder(size_t geometryId)
+    {
+        delete mConnectedFacesCache[geometryId];
+        mConnectedFacesCache[geometryId] = nullptr;
+        recordBvhChange(geometryId);
+
+        if (mIsPrepared)
+        {
+            GeometryOccluderChange myChange = { geometryId, mBoundingBoxes[geometryId], computeBoundingBox(geometryId) };
+            mBoundingBoxes[geometryId] = myChange.mNewBox;
+            mChanges.push_back(myChange);
+        }
     }
 
     /** @brief Prepare the scene before ray tracing */
     inline void GeometryOccluderSet::prepare()
     {
+        mBoundingBoxes.clear();
         for (size_t i = 0; i < mOccluders.size(); i++)
         {
-            GeometryDiscreteMeshDescription* myTriangleMesh = mOccluders[i];
-            MathVector3f myMin, myMax;
-            MathArithmetic<float>::getMinMax(myTriangleMesh->vertexArray, myTriangleMesh->vertexCount, myMin, myMax);
-            mBoundingBoxes.push_back(GeometryAABB(myMin, myMax));
+            mBoundingBoxes.push_back(computeBoundingBox(i));
+        }
+        mChanges.clear();
+        mIsPrepared = true;
+        buildBvh();
+    }
+
+    inline void GeometryOccluderSet::prepare(const std::vector<GeometryAABB>& aBoundingBoxes)
+    {
+        V_ASSERT(aBoundingBoxes.size() == mOccluders.size());
+        mBoundingBoxes = aBoundingBoxes;
+        mChanges.clear();
+        mIsPrepared = true;
+        buildBvh();
+    }
+
+    inline bool GeometryOccluderSet::prepare(const std::vector<GeometryAABB>& aBoundingBoxes, const char* aBvhData, size_t aBvhSize)
+    {
+        V_ASSERT(aBoundingBoxes.size() == mOccluders.size());
+        mBoundingBoxes = aBoundingBoxes;
+        mChanges.clear();
+        mIsPrepared = true;
+        if (readBvh(aBvhData, aBvhSize))
+        {
+            return true;
+        }
+        buildBvh();
+        return false;
+    }
+
+    inline bool GeometryOccluderSet::readBvh(const char* aData, size_t aSize)
+    {
+        mFaceOffsets.resize(mOccluders.size() + 1);
+        size_t myFaceId = 0;
+        for (size_t geometryId = 0; geometryId < mOccluders.size(); geometryId++)
+        {
+            mFaceOffsets[geometryId] = myFaceId;
+            myFaceId += mOccluders[geometryId] == nullptr ? 0 : mOccluders[geometryId]->faceCount;
+        }
+        mFaceOffsets[mOccluders.size()] = myFaceId;
+
+        if (!mBvh.read(aData, aSize))
+        {
+            return false;
+        }
+
+        // Each face id is stored in a single lane, whose identifiers are the ones of the face
+        const uint32_t myNoLane = std::numeric_limits<uint32_t>::max();
+        mFaceLanes.assign(myFaceId, myNoLane);
+        size_t myLaneCount = 0;
+        bool isValid = true;
+        for (size_t i = 0; i < mBvh.getPacketCount() && isValid; i++)
+        {
+            const GeometryTrianglePacket& myPacket = mBvh.getPacket(i);
+            for (size_t j = 0; j < myPacket.getCount() && isValid; j++)
+            {
+                size_t myKey = mBvh.getKey(i, j);
+                size_t geometryId = myPacket.getGeometryId(j);
+                isValid = geometryId < mOccluders.size() && myPacket.getFaceIndex(j) < mFaceOffsets[geometryId + 1] - mFaceOffsets[geometryId]
+                    && mFaceOffsets[geometryId] + myPacket.getFaceIndex(j) == myKey && mFaceLanes[myKey] == myNoLane;
+                if (isValid)
+                {
+                    mFaceLanes[myKey] = (uint32_t)(i * GeometryTrianglePacket::WIDTH + j);
+                    myLaneCount++;
+                }
+            }
+        }
+
+        if (!isValid || myLaneCount != myFaceId)
+        {
+            mBvh.clear();
+            return false;
+        }
+        mBvhChanges.clear();
+        mIsBvhDirty = false;
+        return true;
+    }
+
+    inline bool GeometryOccluderSet::intersectsSegment(const MathVector3d& aBegin, const MathVector3d& anEnd) const
+    {
+        MathVector3d myDirection = anEnd - aBegin;
+        double myLength = myDirection.normalize();
+        if (myLength == 0.0)
+        {
+            return false;
+        }
+        GeometryRay myRay(convert<MathVector3f>(aBegin), convert<MathVector3f>(myDirection));
+        if (isBvhUpToDate())
+        {
+            return mBvh.intersectAny(myRay, 0.0f, (float)myLength);
+        }
+
+        // The faces are gathered in packets, as in the leaves of the BVH
+        GeometryTrianglePacket myPacket;
+        for (size_t geometryId = 0; geometryId < mOccluders.size(); geometryId++)
+        {
+            GeometryDiscreteMeshDescription* myMesh = mOccluders[geometryId];
+            if (myMesh == nullptr)
+            {
+                continue;
+            }
+
+            const MathVector3f* myVertices = reinterpret_cast<const MathVector3f*>(myMesh->vertexArray);
+            for (size_t i = 0; i < myMesh->faceCount; i++)
+            {
+                if (myPacket.isFull())
+                {
+                    if (myPacket.intersectAny(myRay, 0.0f, (float)myLength))
+                    {
+                        return true;
+                    }
+                    myPacket = GeometryTrianglePacket();
+                }
+                std::vector<int> myIndices = myMesh->getIndices(i);
+                myPacket.add(myVertices[myIndices[0]], myVertices[myIndices[1]], myVertices[myIndices[2]], geometryId, i);
+            }
+        }
+        return myPacket.getCount() > 0 && myPacket.intersectAny(myRay, 0.0f, (float)myLength);
+    }
+
+    inline void GeometryOccluderSet::buildBvh()
+    {
+        mBvh.clear();
+        mFaceOffsets.resize(mOccluders.size() + 1);
+
+        size_t myFaceId = 0;
+        for (size_t geometryId = 0; geometryId < mOccluders.size(); geometryId++)
+        {
+            mFaceOffsets[geometryId] = myFaceId;
+
+            GeometryDiscreteMeshDescription* myMesh = mOccluders[geometryId];
+            if (myMesh == nullptr)
+            {
+                continue;
+            }
+
+            // The faces are the ones of getOccluderConnectedFaces(), whose first three vertices are tested by the ray tracing
+            const MathVector3f* myVertices = reinterpret_cast<const MathVector3f*>(myMesh->vertexArray);
+            for (size_t i = 0; i < myMesh->faceCount; i++)
+            {
+                std::vector<int> myIndices = myMesh->getIndices(i);
+                mBvh.addTriangle(myVertices[myIndices[0]], myVertices[myIndices[1]], myVertices[myIndices[2]], geometryId, i, myFaceId + i);
+            }
+            myFaceId += myMesh->faceCount;
+        }
+        mFaceOffsets[mOccluders.size()] = myFaceId;
+
+        mBvh.build();
+        mFaceLanes.assign(myFaceId, 0);
+        for (size_t i = 0; i < mBvh.getPacketCount(); i++)
+        {
+            for (size_t j = 0; j < mBvh.getPacket(i).getCount(); j++)
+            {
+                mFaceLanes[mBvh.getKey(i, j)] = (uint32_t)(i * GeometryTrianglePacket::WIDTH + j);
+            }
+        }
+        mBvhChanges.clear();
+        mIsBvhDirty = false;
+    }
+
+    inline void GeometryOccluderSet::recordBvhChange(size_t geometryId)
+    {
+        if (mIsBvhDirty)
+        {
+            return;
+        }
+
+        // A removed occluder keeps its face ids, whose triangles become degenerate
+        size_t myFaceCount = mOccluders[geometryId] == nullptr ? 0 : mOccluders[geometryId]->faceCount;
+        if (geometryId + 1 < mFaceOffsets.size() && (mOccluders[geometryId] == nullptr || myFaceCount == mFaceOffsets[geometryId + 1] - mFaceOffsets[geometryId]))
+        {
+            mBvhChanges.push_back(geometryId);
+        }
+        else
+        {
+            mIsBvhDirty = true;
+        }
+    }
+
+    inline void GeometryOccluderSet::updateBvh()
+    {
+        if (mIsBvhDirty)
+        {
+            buildBvh();
+            return;
+        }
+        if (mBvhChanges.empty())
+        {
+            return;
+        }
+
+        for (size_t geometryId : mBvhChanges)
+        {
+            GeometryDiscreteMeshDescription* myMesh = mOccluders[geometryId];
+            for (size_t myFaceId = mFaceOffsets[geometryId]; myFaceId < mFaceOffsets[geometryId + 1]; myFaceId++)
+            {
+                size_t myPacket = mFaceLanes[myFaceId] / GeometryTrianglePacket::WIDTH;
+                size_t myLane = mFaceLanes[myFaceId] % GeometryTrianglePacket::WIDTH;
+                if (myMesh == nullptr)
+                {
+                    // A triangle reduced to a point is never hit, as the unused lanes of the packets
+                    MathVector3f v = mBvh.getPacket(myPacket).getVertex(myLane, 0);
+                    mBvh.setTriangle(myPacket, myLane, v, v, v);
+                    continue;
+                }
+                const MathVector3f* myVertices = reinterpret_cast<const MathVector3f*>(myMesh->vertexArray);
+                std::vector<int> myIndices = myMesh->getIndices(myFaceId - mFaceOffsets[geometryId]);
+                mBvh.setTriangle(myPacket, myLane, myVertices[myIndices[0]], myVertices[myIndices[1]], myVertices[myIndices[2]]);
+            }
         }
+        mBvhChanges.clear();
+        mBvh.refit();
     }
 }
@@ -103,9 +103,8 @@ namespace visilib
     }
 
     inline GeometryRay::GeometryRay(const GeometryRay& other)
-        : Sx(0.0), Sy(0.0), Sz(0.0), kx(0), ky(0), kz(0)
+        : mStart(other.mStart), mDirection(other.mDirection), Sx(other.Sx), Sy(other.Sy), Sz(other.Sz), kx(other.kx), ky(other.ky), kz(other.kz)
     {
-        initialize(other.mStart, other.mDirection);
     }
 
     // Note: the initialize method is defined in "MathGeometry.h"
@@ -0,0 +1,345 @@
+/*
+Visilib, an open source library for exact visibility computation.
+Copyright(C) 2021 by Denis Haumont
+
+This file is part of Visilib.
+
+Visilib is free software : you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Visilib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Visilib. If not, see <http://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "math_plane_3.h"
+#include "math_vector_3.h"
+
+namespace visilib
+{
+    /** @brief The convex hull of the extremal stabbing lines of a polytope, clipped by the planes of the two query polygons
+
+    The lines of a polytope cross the plane of each query polygon inside the convex hull of the endpoints of its extremal stabbing lines:
+    the segments of the polytope lines between the two planes lie inside the 3D convex hull of all the endpoints. The hull is stored as a
+    list of planes, with the hull on their positive side, and is used to collect the triangles that may block the lines of the polytope.
+
+    The triangle test is conservative: a triangle is rejected if it lies outside one of the planes of the hull, if all the endpoints lie on the
+    same side of its plane, or if it lies outside the bounding box of the endpoints. The planes are stored as arrays of coordinates, such that
+    the loop over the planes has no dependency between its iterations.
+    */
+
+    class GeometryStabbingLineHull
+    {
+    public:
+        GeometryStabbingLineHull();
+
+        /** @brief Compute the hull of a set of segments
+
+        @param aSegments: the extremal stabbing lines, as segments joining aPlane0 to aPlane1
+        @param aPlane0: the plane of the first query polygon, containing the first endpoint of each segment
+        @param aPlane1: the plane of the second query polygon, containing the second endpoint of each segment
+        */
+        void build(const std::vector<std::pair<MathVector3d, MathVector3d>>& aSegments, const MathPlane3d& aPlane0, const MathPlane3d& aPlane1);
+
+        /** @brief Return false if the triangle does not intersect the hull, true if it may intersect it*/
+        bool intersects(const MathVector3f& v0, const MathVector3f& v1, const MathVector3f& v2) const;
+
+        /** @brief Return false if the box does not intersect the hull, true if it may intersect it*/
+        bool intersects(const MathVector3f& aMin, const MathVector3f& aMax) const;
+
+        size_t getPlaneCount() const
+        {
+            return mD.size();
+        }
+
+    private:
+        /** @brief Compute the 2D convex hull of points lying in a plane, in counter clockwise order around the normal of the plane*/
+        static void computePolygon(const std::vector<MathVector3d>& aPoints, const MathVector3d& aNormal, double aTolerance, std::vector<MathVector3d>& aPolygon);
+
+        /** @brief Add the plane through three points if all the endpoints lie on the same side of the plane*/
+        void addPlane(const MathVector3d& a, const MathVector3d& b, const MathVector3d& c);
+
+        /** @brief Add a plane if all the endpoints lie on the same side of the plane*/
+        void addPlane(const MathPlane3d& aPlane);
+
+        std::vector<MathVector3d> mPoints;      /**< @brief The endpoints of the segments*/
+        std::vector<float> mPointX;             /**< @brief The coordinates of the endpoints*/
+        std::vector<float> mPointY;
+        std::vector<float> mPointZ;
+        std::vector<float> mNormalX;            /**< @brief The normalized equations of the planes of the hull*/
+        std::vector<float> mNormalY;
+        std::vector<float> mNormalZ;
+        std::vector<float> mD;
+        MathVector3f mMin;                      /**< @brief The bounding box of the endpoints*/
+        MathVector3f mMax;
+        double mTolerance;                      /**< @brief The tolerance used to classify the endpoints against a candidate plane*/
+        float mMargin;                          /**< @brief The margin added to the planes to absorb the rounding of the single precision tests*/
+    };
+
+    inline GeometryStabbingLineHull::GeometryStabbingLineHull()
+        : mTolerance(0),
+        mMargin(0)
+    {
+    }
+
+    inline void GeometryStabbingLineHull::computePolygon(const std::vector<MathVector3d>& aPoints, const MathVector3d& aNormal, double aTolerance, std::vector<MathVector3d>& aPolygon)
+    {
+        aPolygon.clear();
+        if (aPoints.empty())
+        {
+            return;
+        }
+
+        // A basis of the plane
+        MathVector3d myAxis = std::fabs(aNormal.x) < 0.5 ? MathVector3d(1, 0, 0) : MathVector3d(0, 1, 0);
+        MathVector3d myU = MathVector3d::cross(aNormal, myAxis);
+        myU.normalize();
+        MathVector3d myV = MathVector3d::cross(aNormal, myU);
+
+        std::vector<std::pair<std::pair<double, double>, size_t>> myProjections;
+        myProjections.reserve(aPoints.size());
+        for (size_t i = 0; i < aPoints.size(); i++)
+        {
+            myProjections.push_back(std::make_pair(std::make_pair(aPoints[i].dot(myU), aPoints[i].dot(myV)), i));
+        }
+        std::sort(myProjections.begin(), myProjections.end());
+
+        // Monotone chain: the lower then the upper hull, the nearly collinear points being discarded
+        auto cross = [&myProjections](size_t o, size_t a, size_t b)
+        {
+            const auto& myO = myProjections[o].first;
+            const auto& myA = myProjections[a].first;
+            const auto& myB = myProjections[b].first;
+            return (myA.first - myO.first) * (myB.second - myO.second) - (myA.second - myO.second) * (myB.first - myO.first);
+        };
+
+        std::vector<size_t> myHull(2 * myProjections.size());
+        size_t k = 0;
+        for (size_t i = 0; i < myProjections.size(); i++)
+        {
+            while (k >= 2 && cross(myHull[k - 2], myHull[k - 1], i) <= aTolerance)
+                k--;
+            myHull[k++] = i;
+        }
+        for (size_t i = myProjections.size() - 1, t = k + 1; i > 0; i--)
+        {
+            while (k >= t && cross(myHull[k - 2], myHull[k - 1], i - 1) <= aTolerance)
+                k--;
+            myHull[k++] = i - 1;
+        }
+        if (k > 1)
+        {
+            k--;
+        }
+
+        for (size_t i = 0; i < k; i++)
+        {
+            aPolygon.push_back(aPoints[myProjections[myHull[i]].second]);
+        }
+    }
+
+    inline void GeometryStabbingLineHull::addPlane(const MathPlane3d& aPlane)
+    {
+        double myNorm = std::sqrt(aPlane.mNormal.getSquaredNorm());
+        if (myNorm == 0)
+        {
+            return;
+        }
+
+        bool hasPositive = false;
+        bool hasNegative = false;
+        for (size_t i = 0; i < mPoints.size() && !(hasPositive && hasNegative); i++)
+        {
+            double myDistance = aPlane.dot(mPoints[i]) / myNorm;
+            hasPositive = hasPositive || myDistance > mTolerance;
+            hasNegative = hasNegative || myDistance < -mTolerance;
+        }
+        if (hasPositive && hasNegative)
+        {
+            return;
+        }
+
+        double myScale = (hasNegative ? -1.0 : 1.0) / myNorm;
+        float myX = (float)(myScale * aPlane.mNormal.x);
+        float myY = (float)(myScale * aPlane.mNormal.y);
+        float myZ = (float)(myScale * aPlane.mNormal.z);
+        float myD = (float)(myScale * aPlane.d) + mMargin;
+
+        // The faces joining two parallel edges are found several times
+        for (size_t i = 0; i < mD.size(); i++)
+        {
+            if (std::fabs(mNormalX[i] - myX) + std::fabs(mNormalY[i] - myY) + std::fabs(mNormalZ[i] - myZ) < 1e-6f && std::fabs(mD[i] - myD) <= mMargin)
+            {
+                return;
+            }
+        }
+        mNormalX.push_back(myX);
+        mNormalY.push_back(myY);
+        mNormalZ.push_back(myZ);
+        mD.push_back(myD);
+    }
+
+    inline void GeometryStabbingLineHull::addPlane(const MathVector3d& a, const MathVector3d& b, const MathVector3d& c)
+    {
+        MathVector3d myNormal = MathVector3d::cross(b - a, c - a);
+        double myNorm = myNormal.normalize();
+        if (myNorm <= mTolerance * mTolerance)
+        {
+            return;
+        }
+        addPlane(MathPlane3d(myNormal, -myNormal.dot(a)));
+    }
+
+    inline void GeometryStabbingLineHull::build(const std::vector<std::pair<MathVector3d, MathVector3d>>& aSegments, const MathPlane3d& aPlane0, const MathPlane3d& aPlane1)
+    {
+        mPoints.clear();
+        mNormalX.clear();
+        mNormalY.clear();
+        mNormalZ.clear();
+        mD.clear();
+
+        std::vector<MathVector3d> myPoints0;
+        std::vector<MathVector3d> myPoints1;
+        for (const auto& mySegment : aSegments)
+        {
+            myPoints0.push_back(mySegment.first);
+            myPoints1.push_back(mySegment.second);
+            mPoints.push_back(mySegment.first);
+            mPoints.push_back(mySegment.second);
+        }
+
+        mPointX.resize(mPoints.size());
+        mPointY.resize(mPoints.size());
+        mPointZ.resize(mPoints.size());
+        mMin = MathVector3f(FLT_MAX, FLT_MAX, FLT_MAX);
+        mMax = MathVector3f(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+        for (size_t i = 0; i < mPoints.size(); i++)
+        {
+            mPointX[i] = (float)mPoints[i].x;
+            mPointY[i] = (float)mPoints[i].y;
+            mPointZ[i] = (float)mPoints[i].z;
+            mMin = MathVector3f(std::min(mMin.x, mPointX[i]), std::min(mMin.y, mPointY[i]), std::min(mMin.z, mPointZ[i]));
+            mMax = MathVector3f(std::max(mMax.x, mPointX[i]), std::max(mMax.y, mPointY[i]), std::max(mMax.z, mPointZ[i]));
+        }
+        if (mPoints.empty())
+        {
+            return;
+        }
+
+        double myExtent = std::sqrt((convert<MathVector3d>(mMax) - convert<MathVector3d>(mMin)).getSquaredNorm());
+        mTolerance = 1e-9 * myExtent;
+        mMargin = (float)(1e-5 * myExtent);
+        mMin -= MathVector3f(mMargin, mMargin, mMargin);
+        mMax += MathVector3f(mMargin, mMargin, mMargin);
+
+        // The two caps, then the faces joining an edge of one cap to a vertex of the other one
+        addPlane(aPlane0);
+        addPlane(aPlane1);
+
+        std::vector<MathVector3d> myPolygon0;
+        std::vector<MathVector3d> myPolygon1;
+        computePolygon(myPoints0, aPlane0.mNormal, mTolerance * myExtent, myPolygon0);
+        computePolygon(myPoints1, aPlane1.mNormal, mTolerance * myExtent, myPolygon1);
+
+        for (int mySide = 0; mySide < 2; mySide++)
+        {
+            const std::vector<MathVector3d>& myEdges = mySide == 0 ? myPolygon0 : myPolygon1;
+            const std::vector<MathVector3d>& myVertices = mySide == 0 ? myPolygon1 : myPolygon0;
+            if (myEdges.size() < 2)
+            {
+                continue;
+            }
+            // A polygon reduced to a segment has a single edge
+            size_t myEdgeCount = myEdges.size() == 2 ? 1 : myEdges.size();
+            for (size_t i = 0; i < myEdgeCount; i++)
+            {
+                for (const MathVector3d& myVertex : myVertices)
+                {
+                    addPlane(myEdges[i], myEdges[(i + 1) % myEdges.size()], myVertex);
+                }
+            }
+        }
+    }
+
+    inline bool GeometryStabbingLineHull::intersects(const MathVector3f& v0, const MathVector3f& v1, const MathVector3f& v2) const
+    {
+        if (mPoints.empty())
+        {
+            return false;
+        }
+
+        if (std::max(v0.x, std::max(v1.x, v2.x)) < mMin.x || std::min(v0.x, std::min(v1.x, v2.x)) > mMax.x
+            || std::max(v0.y, std::max(v1.y, v2.y)) < mMin.y || std::min(v0.y, std::min(v1.y, v2.y)) > mMax.y
+            || std::max(v0.z, std::max(v1.z, v2.z)) < mMin.z || std::min(v0.z, std::min(v1.z, v2.z)) > mMax.z)
+        {
+            return false;
+        }
+
+        // A plane of the hull separates the triangle if its three vertices are outside
+        const size_t myPlaneCount = mD.size();
+        int isSeparated = 0;
+        for (size_t i = 0; i < myPlaneCount; i++)
+        {
+            float d0 = mNormalX[i] * v0.x + mNormalY[i] * v0.y + mNormalZ[i] * v0.z + mD[i];
+            float d1 = mNormalX[i] * v1.x + mNormalY[i] * v1.y + mNormalZ[i] * v1.z + mD[i];
+            float d2 = mNormalX[i] * v2.x + mNormalY[i] * v2.y + mNormalZ[i] * v2.z + mD[i];
+            isSeparated |= (d0 < 0) & (d1 < 0) & (d2 < 0);
+        }
+        if (isSeparated)
+        {
+            return false;
+        }
+
+        // The plane of the triangle separates the hull if all the endpoints are on the same side
+        MathVector3f myNormal = MathVector3f::cross(v1 - v0, v2 - v0);
+        float myNorm = myNormal.normalize();
+        if (myNorm == 0)
+        {
+            return true;
+        }
+        float myD = -myNormal.dot(v0);
+
+        const size_t myPointCount = mPointX.size();
+        int hasPositive = 0;
+        int hasNegative = 0;
+        for (size_t i = 0; i < myPointCount; i++)
+        {
+            float d = myNormal.x * mPointX[i] + myNormal.y * mPointY[i] + myNormal.z * mPointZ[i] + myD;
+            hasPositive |= d > -mMargin;
+            hasNegative |= d < mMargin;
+        }
+        return hasPositive && hasNegative;
+    }
+
+    inline bool GeometryStabbingLineHull::intersects(const MathVector3f& aMin, const MathVector3f& aMax) const
+    {
+        if (mPoints.empty() || aMax.x < mMin.x || aMin.x > mMax.x || aMax.y < mMin.y || aMin.y > mMax.y || aMax.z < mMin.z || aMin.z > mMax.z)
+        {
+            return false;
+        }
+
+        // A plane of the hull separates the box if the corner of the box the furthest along its normal is outside
+        const size_t myPlaneCount = mD.size();
+        int isSeparated = 0;
+        for (size_t i = 0; i < myPlaneCount; i++)
+        {
+            float d = mNormalX[i] * (mNormalX[i] > 0 ? aMax.x : aMin.x) + mNormalY[i] * (mNormalY[i] > 0 ? aMax.y : aMin.y) + mNormalZ[i] * (mNormalZ[i] > 0 ? aMax.z : aMin.z) + mD[i];
+            isSeparated |= d < 0;
+        }
+        return !isSeparated;
+    }
+}
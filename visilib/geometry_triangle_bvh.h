@@ -0,0 +1,700 @@
+/*
+Visilib, an open source library for exact visibility computation.
+Copyright(C) 2021 by Denis Haumont
+
+This file is part of Visilib.
+
+Visilib is free software : you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Visilib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Visilib. If not, see <http://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <ostream>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "geometry_ray.h"
+#include "geometry_triangle_packet.h"
+#include "math_vector_3.h"
+#include "visilib_core.h"
+
+namespace visilib
+{
+    /** @brief An 8-wide bounding volume hierarchy of triangles
+
+    Each leaf is a GeometryTrianglePacket. The 8 children of a node are stored as arrays of coordinates and tested against a ray in a single loop,
+    and the triangles of a leaf are tested by the packet kernel. The hierarchy is built top-down, by splitting the largest range of triangles at the
+    median of their centroids until a node has 8 children. Each triangle carries a key chosen by the caller, returned with the hits.
+    The traversal stack is sized from the depth of the hierarchy computed by build(): it is stored on the call stack unless the hierarchy is deeper than expected.
+    The vertices of the triangles can be moved after the build (setTriangle()), followed by a refit() of the boxes of their ancestors: the topology of the
+    hierarchy is kept, such that its quality decreases with the amplitude of the moves, but the cost of the update is proportional to the number of triangles moved.
+    */
+
+    class GeometryTriangleBvh
+    {
+    public:
+        static constexpr size_t WIDTH = 8;
+
+        GeometryTriangleBvh();
+
+        /** @brief Remove all the triangles*/
+        void clear();
+
+        /** @brief Add a triangle, taken into account by the next build()
+
+        @param aGeometryId, aFaceIndex: the identifiers of the triangle returned by the packets
+        @param aKey: a value associated to the triangle (getKey())
+        */
+        void addTriangle(const MathVector3f& v0, const MathVector3f& v1, const MathVector3f& v2, size_t aGeometryId, size_t aFaceIndex, size_t aKey);
+
+        /** @brief Build the hierarchy of the triangles added since the last clear()*/
+        void build();
+
+        /** @brief Replace the vertices of the triangle of a lane of a packet. The hierarchy is valid again after refit()*/
+        void setTriangle(size_t aPacket, size_t aLane, const MathVector3f& v0, const MathVector3f& v1, const MathVector3f& v2);
+
+        /** @brief Recompute the boxes of the nodes containing the triangles changed by setTriangle(), bottom-up*/
+        void refit();
+
+        /** @brief Write the hierarchy in the byte order of the machine, such that read() restores it without building it*/
+        void write(std::ostream& anOutput) const;
+
+        /** @brief Restore a hierarchy written by write() from a memory buffer
+
+        The children and the parents of the nodes are checked, such that the traversals stay inside the hierarchy, and its depth is computed again.
+        The triangles and the keys of the packets are used as is.
+        @return: false if the buffer does not contain a valid hierarchy, which is then empty
+        */
+        bool read(const char* aData, size_t aSize);
+
+        bool isEmpty() const
+        {
+            return mRoot == EMPTY;
+        }
+
+        size_t getNodeCount() const
+        {
+            return mNodes.size();
+        }
+
+        size_t getPacketCount() const
+        {
+            return mPackets.size();
+        }
+
+        const GeometryTrianglePacket& getPacket(size_t aPacket) const
+        {
+            return mPackets[aPacket];
+        }
+
+        /** @brief Return the key of the triangle of a lane of a packet*/
+        size_t getKey(size_t aPacket, size_t aLane) const
+        {
+            return mKeys[aPacket * GeometryTrianglePacket::WIDTH + aLane];
+        }
+
+        /** @brief Visit the leaves whose box is hit by a ray segment
+
+        @param aVisitor: called with the index of the packet of each leaf, returns false to stop the traversal
+        */
+        template<class Visitor>
+        void traverse(const GeometryRay& aRay, float aTnear, float aTfar, Visitor aVisitor) const;
+
+        /** @brief Visit once the leaves whose box is hit by at least one ray segment of a packet, in a single traversal of the hierarchy
+
+        @param aVisitor: called with the index of the packet of each leaf, returns false to stop the traversal
+        */
+        template<class Visitor>
+        void traverse(const std::vector<GeometryRay>& aRays, float aTnear, float aTfar, Visitor aVisitor) const;
+
+        /** @brief Return true if one of the triangles is hit by the ray segment ("any hit"), stopping at the first hit found*/
+        bool intersectAny(const GeometryRay& aRay, float aTnear, float aTfar) const
+        {
+            bool hasIntersection = false;
+            traverse(aRay, aTnear, aTfar, [&](size_t aPacket)
+                {
+                    hasIntersection = mPackets[aPacket].intersectAny(aRay, aTnear, aTfar);
+                    return !hasIntersection;
+                });
+            return hasIntersection;
+        }
+
+        /** @brief Visit the leaves whose box is accepted by a predicate
+
+        @param aPredicate: called with the bounds of the boxes of the children of the nodes, returns false to cull a child
+        @param aVisitor: called with the index of the packet of each leaf
+        */
+        template<class Predicate, class Visitor>
+        void traverse(Predicate aPredicate, Visitor aVisitor) const;
+
+    private:
+        /** @brief A node of the BVH. A child is either a node (index >= 0), a leaf (~ index of the packet) or empty*/
+        struct Node
+        {
+            float mMinX[WIDTH], mMinY[WIDTH], mMinZ[WIDTH];
+            float mMaxX[WIDTH], mMaxY[WIDTH], mMaxZ[WIDTH];
+            int32_t mChildren[WIDTH];
+        };
+
+        struct Primitive
+        {
+            MathVector3f mVertices[3];
+            MathVector3f mMin;
+            MathVector3f mMax;
+            MathVector3f mCentroid;
+            size_t mGeometryId;
+            size_t mFaceIndex;
+            size_t mKey;
+        };
+
+        /** @brief A ray prepared for the slab test of the boxes of the nodes*/
+        struct RaySlabs
+        {
+            MathVector3f mStart;
+            float mInverse[3];
+        };
+
+        /** @brief The header of a hierarchy written by write(), followed by the nodes, the packets, the keys (64 bits), the parents of the nodes and of the packets*/
+        struct SerializedHeader
+        {
+            uint32_t mWidth;
+            uint32_t mNodeSize;
+            uint32_t mPacketSize;
+            int32_t mRoot;
+            uint64_t mNodeCount;
+            uint64_t mPacketCount;
+        };
+
+        static constexpr int32_t EMPTY = std::numeric_limits<int32_t>::min();
+        static constexpr int32_t NO_PARENT = -1;
+        static constexpr size_t STACK_SIZE = 256;
+
+        static RaySlabs getRaySlabs(const GeometryRay& aRay);
+
+        /** @brief Return the mask of the children of a node whose box is hit by a ray segment*/
+        static uint32_t intersectChildren(const Node& aNode, const RaySlabs& aRay, float aTnear, float aTfar);
+
+        /** @brief Visit the leaves reached from the root, descending in the children selected by a function
+
+        @param aSelector: called with each node reached, returns the mask of its children to visit
+        @param aVisitor: called with the index of the packet of each leaf, returns false to stop the traversal
+        */
+        template<class Selector, class Visitor>
+        void traverseNodes(Selector aSelector, Visitor aVisitor) const;
+
+        /** @brief Build the subtree of a range of primitives at a depth, and return its child code*/
+        int32_t build(size_t aBegin, size_t anEnd, size_t aDepth);
+
+        /** @brief Compute the box of a child of a node from its packet or from the boxes of its own children*/
+        void getChildBox(int32_t aChild, MathVector3f& aMin, MathVector3f& aMax) const;
+
+        /** @brief Store a range of at most WIDTH primitives in a packet, and return its child code*/
+        int32_t buildLeaf(size_t aBegin, size_t anEnd);
+
+        std::vector<Node> mNodes;
+        std::vector<GeometryTrianglePacket> mPackets;
+        std::vector<size_t> mKeys;                  /**< @brief The key of each lane of the packets*/
+        std::vector<int32_t> mNodeParents;          /**< @brief The parent of each node, NO_PARENT for the root*/
+        std::vector<int32_t> mPacketParents;        /**< @brief The node whose child is each packet, NO_PARENT if the root is a leaf*/
+        std::vector<uint8_t> mIsNodeChanged;        /**< @brief The nodes whose boxes are recomputed by the next refit()*/
+        std::vector<Primitive> mPrimitives;         /**< @brief The triangles added since the last build*/
+        int32_t mRoot;
+        size_t mDepth;                              /**< @brief The number of levels of nodes of the hierarchy*/
+    };
+
+    inline GeometryTriangleBvh::GeometryTriangleBvh()
+        : mRoot(EMPTY),
+        mDepth(0)
+    {
+    }
+
+    inline void GeometryTriangleBvh::clear()
+    {
+        mNodes.clear();
+        mPackets.clear();
+        mKeys.clear();
+        mNodeParents.clear();
+        mPacketParents.clear();
+        mIsNodeChanged.clear();
+        mPrimitives.clear();
+        mRoot = EMPTY;
+        mDepth = 0;
+    }
+
+    inline void GeometryTriangleBvh::addTriangle(const MathVector3f& v0, const MathVector3f& v1, const MathVector3f& v2, size_t aGeometryId, size_t aFaceIndex, size_t aKey)
+    {
+        Primitive myPrimitive;
+        myPrimitive.mVertices[0] = v0;
+        myPrimitive.mVertices[1] = v1;
+        myPrimitive.mVertices[2] = v2;
+        myPrimitive.mMin = MathVector3f(std::min(v0.x, std::min(v1.x, v2.x)), std::min(v0.y, std::min(v1.y, v2.y)), std::min(v0.z, std::min(v1.z, v2.z)));
+        myPrimitive.mMax = MathVector3f(std::max(v0.x, std::max(v1.x, v2.x)), std::max(v0.y, std::max(v1.y, v2.y)), std::max(v0.z, std::max(v1.z, v2.z)));
+        myPrimitive.mCentroid = (myPrimitive.mMin + myPrimitive.mMax) * 0.5f;
+        myPrimitive.mGeometryId = aGeometryId;
+        myPrimitive.mFaceIndex = aFaceIndex;
+        myPrimitive.mKey = aKey;
+        mPrimitives.push_back(myPrimitive);
+    }
+
+    inline void GeometryTriangleBvh::build()
+    {
+        mNodes.clear();
+        mPackets.clear();
+        mKeys.clear();
+        mNodeParents.clear();
+        mPacketParents.clear();
+        mDepth = 0;
+
+        mRoot = mPrimitives.empty() ? EMPTY : build(0, mPrimitives.size(), 0);
+        mPrimitives.clear();
+        mIsNodeChanged.assign(mNodes.size(), 0);
+    }
+
+    inline void GeometryTriangleBvh::setTriangle(size_t aPacket, size_t aLane, const MathVector3f& v0, const MathVector3f& v1, const MathVector3f& v2)
+    {
+        V_ASSERT(aLane < mPackets[aPacket].getCount());
+
+        mPackets[aPacket].setVertices(aLane, v0, v1, v2);
+
+        // The ancestors are marked up to the first one already marked, whose own ancestors are marked
+        for (int32_t myNode = mPacketParents[aPacket]; myNode != NO_PARENT && !mIsNodeChanged[myNode]; myNode = mNodeParents[myNode])
+        {
+            mIsNodeChanged[myNode] = 1;
+        }
+    }
+
+    inline void GeometryTriangleBvh::refit()
+    {
+        // The children of a node are built after it: the nodes are visited in reverse order such that the boxes of the children are up to date
+        for (size_t i = mNodes.size(); i-- > 0;)
+        {
+            if (!mIsNodeChanged[i])
+            {
+                continue;
+            }
+            mIsNodeChanged[i] = 0;
+
+            Node& myNode = mNodes[i];
+            for (size_t j = 0; j < WIDTH; j++)
+            {
+                if (myNode.mChildren[j] == EMPTY)
+                {
+                    continue;
+                }
+                MathVector3f myMin, myMax;
+                getChildBox(myNode.mChildren[j], myMin, myMax);
+                myNode.mMinX[j] = myMin.x; myNode.mMinY[j] = myMin.y; myNode.mMinZ[j] = myMin.z;
+                myNode.mMaxX[j] = myMax.x; myNode.mMaxY[j] = myMax.y; myNode.mMaxZ[j] = myMax.z;
+            }
+        }
+    }
+
+    inline void GeometryTriangleBvh::write(std::ostream& anOutput) const
+    {
+        static_assert(std::is_trivially_copyable<Node>::value && std::is_trivially_copyable<GeometryTrianglePacket>::value, "The nodes and the packets are written as is");
+
+        SerializedHeader myHeader;
+        memset(&myHeader, 0, sizeof(SerializedHeader));
+        myHeader.mWidth = (uint32_t)WIDTH;
+        myHeader.mNodeSize = (uint32_t)sizeof(Node);
+        myHeader.mPacketSize = (uint32_t)sizeof(GeometryTrianglePacket);
+        myHeader.mRoot = mRoot;
+        myHeader.mNodeCount = mNodes.size();
+        myHeader.mPacketCount = mPackets.size();
+
+        std::vector<uint64_t> myKeys(mKeys.begin(), mKeys.end());
+        anOutput.write(reinterpret_cast<const char*>(&myHeader), sizeof(SerializedHeader));
+        anOutput.write(reinterpret_cast<const char*>(mNodes.data()), mNodes.size() * sizeof(Node));
+        anOutput.write(reinterpret_cast<const char*>(mPackets.data()), mPackets.size() * sizeof(GeometryTrianglePacket));
+        anOutput.write(reinterpret_cast<const char*>(myKeys.data()), myKeys.size() * sizeof(uint64_t));
+        anOutput.write(reinterpret_cast<const char*>(mNodeParents.data()), mNodeParents.size() * sizeof(int32_t));
+        anOutput.write(reinterpret_cast<const char*>(mPacketParents.data()), mPacketParents.size() * sizeof(int32_t));
+    }
+
+    inline bool GeometryTriangleBvh::read(const char* aData, size_t aSize)
+    {
+        clear();
+
+        SerializedHeader myHeader;
+        if (aSize < sizeof(SerializedHeader))
+            return false;
+        memcpy(&myHeader, aData, sizeof(SerializedHeader));
+        if (myHeader.mWidth != WIDTH || myHeader.mNodeSize != sizeof(Node) || myHeader.mPacketSize != sizeof(GeometryTrianglePacket))
+            return false;
+
+        // The counts are bounded by the size of the buffer before computing the size of the sections
+        const size_t myNodeSize = sizeof(Node) + sizeof(int32_t);
+        const size_t myPacketSize = sizeof(GeometryTrianglePacket) + GeometryTrianglePacket::WIDTH * sizeof(uint64_t) + sizeof(int32_t);
+        if (myHeader.mNodeCount > aSize / myNodeSize || myHeader.mPacketCount > aSize / myPacketSize
+            || sizeof(SerializedHeader) + myHeader.mNodeCount * myNodeSize + myHeader.mPacketCount * myPacketSize != aSize)
+            return false;
+
+        size_t myNodeCount = (size_t)myHeader.mNodeCount;
+        size_t myPacketCount = (size_t)myHeader.mPacketCount;
+        const char* myData = aData + sizeof(SerializedHeader);
+
+        mNodes.resize(myNodeCount);
+        memcpy(mNodes.data(), myData, myNodeCount * sizeof(Node));
+        myData += myNodeCount * sizeof(Node);
+        mPackets.resize(myPacketCount);
+        memcpy(static_cast<void*>(mPackets.data()), myData, myPacketCount * sizeof(GeometryTrianglePacket));
+        myData += myPacketCount * sizeof(GeometryTrianglePacket);
+        mKeys.resize(myPacketCount * GeometryTrianglePacket::WIDTH);
+        for (size_t i = 0; i < mKeys.size(); i++)
+        {
+            uint64_t myKey;
+            memcpy(&myKey, myData + i * sizeof(uint64_t), sizeof(uint64_t));
+            mKeys[i] = (size_t)myKey;
+        }
+        myData += mKeys.size() * sizeof(uint64_t);
+        mNodeParents.resize(myNodeCount);
+        memcpy(mNodeParents.data(), myData, myNodeCount * sizeof(int32_t));
+        myData += myNodeCount * sizeof(int32_t);
+        mPacketParents.resize(myPacketCount);
+        memcpy(mPacketParents.data(), myData, myPacketCount * sizeof(int32_t));
+
+        // The root is the first node built, or the only packet. Each other node and packet is the child of a single node built before it
+        bool isValid = myHeader.mRoot == EMPTY ? myNodeCount == 0 && myPacketCount == 0
+            : myHeader.mRoot >= 0 ? myHeader.mRoot == 0 && myNodeCount > 0 && mNodeParents[0] == NO_PARENT
+            : myHeader.mRoot == ~0 && myNodeCount == 0 && myPacketCount == 1 && mPacketParents[0] == NO_PARENT;
+
+        std::vector<size_t> myLevels(myNodeCount, 0);
+        std::vector<uint8_t> myNodeReferences(myNodeCount, 0);
+        std::vector<uint8_t> myPacketReferences(myPacketCount, 0);
+        if (myNodeCount > 0)
+        {
+            myLevels[0] = 1;
+            myNodeReferences[0] = 1;
+        }
+        for (size_t i = 0; i < myNodeCount && isValid; i++)
+        {
+            mDepth = std::max(mDepth, myLevels[i]);
+            for (size_t j = 0; j < WIDTH && isValid; j++)
+            {
+                int32_t myChild = mNodes[i].mChildren[j];
+                if (myChild == EMPTY)
+                {
+                    continue;
+                }
+                if (myChild >= 0)
+                {
+                    isValid = (size_t)myChild > i && (size_t)myChild < myNodeCount && mNodeParents[myChild] == (int32_t)i && myNodeReferences[myChild]++ == 0;
+                    if (isValid)
+                        myLevels[myChild] = myLevels[i] + 1;
+                }
+                else
+                {
+                    isValid = (size_t)~myChild < myPacketCount && mPacketParents[~myChild] == (int32_t)i && myPacketReferences[~myChild]++ == 0;
+                }
+            }
+        }
+        for (size_t i = 0; i < myNodeCount && isValid; i++)
+        {
+            isValid = myNodeReferences[i] == 1;
+        }
+        for (size_t i = 0; i < myPacketCount && isValid; i++)
+        {
+            isValid = (myPacketReferences[i] == 1 || myNodeCount == 0) && mPackets[i].getCount() <= GeometryTrianglePacket::WIDTH;
+        }
+
+        if (!isValid)
+        {
+            clear();
+            return false;
+        }
+        mRoot = myHeader.mRoot;
+        mIsNodeChanged.assign(myNodeCount, 0);
+        return true;
+    }
+
+    inline void GeometryTriangleBvh::getChildBox(int32_t aChild, MathVector3f& aMin, MathVector3f& aMax) const
+    {
+        aMin = MathVector3f(FLT_MAX, FLT_MAX, FLT_MAX);
+        aMax = MathVector3f(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+        if (aChild < 0)
+        {
+            const GeometryTrianglePacket& myPacket = mPackets[~aChild];
+            for (size_t i = 0; i < myPacket.getCount(); i++)
+            {
+                for (size_t j = 0; j < 3; j++)
+                {
+                    MathVector3f v = myPacket.getVertex(i, j);
+                    aMin = MathVector3f(std::min(aMin.x, v.x), std::min(aMin.y, v.y), std::min(aMin.z, v.z));
+                    aMax = MathVector3f(std::max(aMax.x, v.x), std::max(aMax.y, v.y), std::max(aMax.z, v.z));
+                }
+            }
+            return;
+        }
+
+        const Node& myNode = mNodes[aChild];
+        for (size_t i = 0; i < WIDTH; i++)
+        {
+            if (myNode.mChildren[i] != EMPTY)
+            {
+                aMin = MathVector3f(std::min(aMin.x, myNode.mMinX[i]), std::min(aMin.y, myNode.mMinY[i]), std::min(aMin.z, myNode.mMinZ[i]));
+                aMax = MathVector3f(std::max(aMax.x, myNode.mMaxX[i]), std::max(aMax.y, myNode.mMaxY[i]), std::max(aMax.z, myNode.mMaxZ[i]));
+            }
+        }
+    }
+
+    inline int32_t GeometryTriangleBvh::buildLeaf(size_t aBegin, size_t anEnd)
+    {
+        GeometryTrianglePacket myPacket;
+        mKeys.resize((mPackets.size() + 1) * GeometryTrianglePacket::WIDTH, 0);
+        for (size_t i = aBegin; i < anEnd; i++)
+        {
+            const Primitive& myPrimitive = mPrimitives[i];
+            mKeys[mPackets.size() * GeometryTrianglePacket::WIDTH + myPacket.getCount()] = myPrimitive.mKey;
+            myPacket.add(myPrimitive.mVertices[0], myPrimitive.mVertices[1], myPrimitive.mVertices[2], myPrimitive.mGeometryId, myPrimitive.mFaceIndex);
+        }
+        mPackets.push_back(myPacket);
+        mPacketParents.push_back(NO_PARENT);
+        return ~(int32_t)(mPackets.size() - 1);
+    }
+
+    inline int32_t GeometryTriangleBvh::build(size_t aBegin, size_t anEnd, size_t aDepth)
+    {
+        if (anEnd - aBegin <= GeometryTrianglePacket::WIDTH)
+        {
+            return buildLeaf(aBegin, anEnd);
+        }
+        mDepth = std::max(mDepth, aDepth + 1);
+
+        // Split the largest range at the median of the centroids along their largest extent, until the node has WIDTH children
+        std::vector<std::pair<size_t, size_t>> myRanges(1, std::make_pair(aBegin, anEnd));
+        while (myRanges.size() < WIDTH)
+        {
+            size_t myLargest = 0;
+            for (size_t i = 1; i < myRanges.size(); i++)
+            {
+                if (myRanges[i].second - myRanges[i].first > myRanges[myLargest].second - myRanges[myLargest].first)
+                    myLargest = i;
+            }
+            size_t myBegin = myRanges[myLargest].first;
+            size_t myEnd = myRanges[myLargest].second;
+            if (myEnd - myBegin <= GeometryTrianglePacket::WIDTH)
+            {
+                break;
+            }
+
+            MathVector3f myMin(FLT_MAX, FLT_MAX, FLT_MAX);
+            MathVector3f myMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+            for (size_t i = myBegin; i < myEnd; i++)
+            {
+                const MathVector3f& c = mPrimitives[i].mCentroid;
+                myMin = MathVector3f(std::min(myMin.x, c.x), std::min(myMin.y, c.y), std::min(myMin.z, c.z));
+                myMax = MathVector3f(std::max(myMax.x, c.x), std::max(myMax.y, c.y), std::max(myMax.z, c.z));
+            }
+            MathVector3f myExtent = myMax - myMin;
+            int myAxis = myExtent.x >= myExtent.y && myExtent.x >= myExtent.z ? 0 : (myExtent.y >= myExtent.z ? 1 : 2);
+
+            size_t myMiddle = (myBegin + myEnd) / 2;
+            std::nth_element(mPrimitives.begin() + myBegin, mPrimitives.begin() + myMiddle, mPrimitives.begin() + myEnd,
+                [myAxis](const Primitive& a, const Primitive& b)
+                {
+                    return a.mCentroid[myAxis] < b.mCentroid[myAxis];
+                });
+
+            myRanges[myLargest] = std::make_pair(myBegin, myMiddle);
+            myRanges.push_back(std::make_pair(myMiddle, myEnd));
+        }
+
+        size_t myNodeIndex = mNodes.size();
+        mNodes.push_back(Node());
+        mNodeParents.push_back(NO_PARENT);
+        for (size_t i = 0; i < WIDTH; i++)
+        {
+            int32_t myChild = EMPTY;
+            MathVector3f myMin(FLT_MAX, FLT_MAX, FLT_MAX);
+            MathVector3f myMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+            if (i < myRanges.size())
+            {
+                for (size_t j = myRanges[i].first; j < myRanges[i].second; j++)
+                {
+                    const Primitive& p = mPrimitives[j];
+                    myMin = MathVector3f(std::min(myMin.x, p.mMin.x), std::min(myMin.y, p.mMin.y), std::min(myMin.z, p.mMin.z));
+                    myMax = MathVector3f(std::max(myMax.x, p.mMax.x), std::max(myMax.y, p.mMax.y), std::max(myMax.z, p.mMax.z));
+                }
+                myChild = build(myRanges[i].first, myRanges[i].second, aDepth + 1);
+                if (myChild < 0)
+                    mPacketParents[~myChild] = (int32_t)myNodeIndex;
+                else
+                    mNodeParents[myChild] = (int32_t)myNodeIndex;
+            }
+
+            // The nodes may have been reallocated by the recursive build
+            Node& myNode = mNodes[myNodeIndex];
+            myNode.mMinX[i] = myMin.x; myNode.mMinY[i] = myMin.y; myNode.mMinZ[i] = myMin.z;
+            myNode.mMaxX[i] = myMax.x; myNode.mMaxY[i] = myMax.y; myNode.mMaxZ[i] = myMax.z;
+            myNode.mChildren[i] = myChild;
+        }
+        return (int32_t)myNodeIndex;
+    }
+
+    inline GeometryTriangleBvh::RaySlabs GeometryTriangleBvh::getRaySlabs(const GeometryRay& aRay)
+    {
+        RaySlabs mySlabs;
+        mySlabs.mStart = aRay.getStart();
+
+        // A null component of the direction is replaced by a tiny one, such that the slabs are never computed from 0 * infinity
+        const MathVector3f& myDirection = aRay.getDirection();
+        for (int i = 0; i < 3; i++)
+        {
+            float d = myDirection[i];
+            if (std::fabs(d) < 1e-30f)
+                d = d < 0 ? -1e-30f : 1e-30f;
+            mySlabs.mInverse[i] = 1.0f / d;
+        }
+        return mySlabs;
+    }
+
+    inline uint32_t GeometryTriangleBvh::intersectChildren(const Node& aNode, const RaySlabs& aRay, float aTnear, float aTfar)
+    {
+        // The far distance of the slabs is enlarged to absorb the rounding of their computation, as in a robust traversal
+        const float myRounding = 1.0f + 4.0f * FLT_EPSILON;
+        const MathVector3f& myStart = aRay.mStart;
+
+        uint32_t myHits[WIDTH];
+        for (size_t i = 0; i < WIDTH; i++)
+        {
+            float tx0 = (aNode.mMinX[i] - myStart.x) * aRay.mInverse[0];
+            float tx1 = (aNode.mMaxX[i] - myStart.x) * aRay.mInverse[0];
+            float ty0 = (aNode.mMinY[i] - myStart.y) * aRay.mInverse[1];
+            float ty1 = (aNode.mMaxY[i] - myStart.y) * aRay.mInverse[1];
+            float tz0 = (aNode.mMinZ[i] - myStart.z) * aRay.mInverse[2];
+            float tz1 = (aNode.mMaxZ[i] - myStart.z) * aRay.mInverse[2];
+
+            float tmin = std::max(std::max(std::min(tx0, tx1), std::min(ty0, ty1)), std::max(std::min(tz0, tz1), aTnear));
+            float tmax = std::min(std::min(std::max(tx0, tx1), std::max(ty0, ty1)), std::min(std::max(tz0, tz1), aTfar));
+            myHits[i] = tmin <= tmax * (tmax > 0 ? myRounding : 2.0f - myRounding);
+        }
+
+        uint32_t myMask = 0;
+        for (size_t i = 0; i < WIDTH; i++)
+        {
+            myMask |= myHits[i] << i;
+        }
+        return myMask;
+    }
+
+    template<class Selector, class Visitor>
+    inline void GeometryTriangleBvh::traverseNodes(Selector aSelector, Visitor aVisitor) const
+    {
+        if (mRoot == EMPTY)
+        {
+            return;
+        }
+
+        // Each level of the path to the current node leaves at most WIDTH - 1 children in the stack
+        size_t myMaxStackSize = mDepth * (WIDTH - 1) + 1;
+        int32_t myLocalStack[STACK_SIZE];
+        std::vector<int32_t> myLargeStack;
+        int32_t* myStack = myLocalStack;
+        if (myMaxStackSize > STACK_SIZE)
+        {
+            myLargeStack.resize(myMaxStackSize);
+            myStack = myLargeStack.data();
+        }
+
+        size_t myStackSize = 0;
+        myStack[myStackSize++] = mRoot;
+
+        while (myStackSize > 0)
+        {
+            int32_t myCode = myStack[--myStackSize];
+            if (myCode < 0)
+            {
+                if (!aVisitor((size_t)~myCode))
+                    return;
+                continue;
+            }
+
+            const Node& myNode = mNodes[myCode];
+            uint32_t myMask = aSelector(myNode);
+            for (size_t i = 0; i < WIDTH; i++)
+            {
+                if (((myMask >> i) & 1) && myNode.mChildren[i] != EMPTY)
+                {
+                    V_ASSERT(myStackSize < myMaxStackSize);
+                    myStack[myStackSize++] = myNode.mChildren[i];
+                }
+            }
+        }
+    }
+
+    template<class Visitor>
+    inline void GeometryTriangleBvh::traverse(const GeometryRay& aRay, float aTnear, float aTfar, Visitor aVisitor) const
+    {
+        RaySlabs mySlabs = getRaySlabs(aRay);
+        traverseNodes([&](const Node& aNode)
+            {
+                return intersectChildren(aNode, mySlabs, aTnear, aTfar);
+            },
+            aVisitor);
+    }
+
+    template<class Visitor>
+    inline void GeometryTriangleBvh::traverse(const std::vector<GeometryRay>& aRays, float aTnear, float aTfar, Visitor aVisitor) const
+    {
+        static thread_local std::vector<RaySlabs> mySlabs;
+        mySlabs.clear();
+        for (const GeometryRay& myRay : aRays)
+        {
+            mySlabs.push_back(getRaySlabs(myRay));
+        }
+
+        traverseNodes([&](const Node& aNode)
+            {
+                // The children already hit by a ray of the packet are not tested against the next rays
+                const uint32_t myAll = (1u << WIDTH) - 1;
+                uint32_t myMask = 0;
+                for (size_t i = 0; i < mySlabs.size() && myMask != myAll; i++)
+                {
+                    myMask |= intersectChildren(aNode, mySlabs[i], aTnear, aTfar);
+                }
+                return myMask;
+            },
+            aVisitor);
+    }
+
+    template<class Predicate, class Visitor>
+    inline void GeometryTriangleBvh::traverse(Predicate aPredicate, Visitor aVisitor) const
+    {
+        traverseNodes([&](const Node& aNode)
+            {
+                uint32_t myMask = 0;
+                for (size_t i = 0; i < WIDTH; i++)
+                {
+                    if (aNode.mChildren[i] != EMPTY
+                        && aPredicate(MathVector3f(aNode.mMinX[i], aNode.mMinY[i], aNode.mMinZ[i]), MathVector3f(aNode.mMaxX[i], aNode.mMaxY[i], aNode.mMaxZ[i])))
+                    {
+                        myMask |= 1u << i;
+                    }
+                }
+                return myMask;
+            },
+            [&](size_t aPacket)
+            {
+                aVisitor(aPacket);
+                return true;
+            });
+    }
+}
@@ -0,0 +1,251 @@
+/*
+Visilib, an open source library for exact visibility computation.
+Copyright(C) 2021 by Denis Haumont
+
+This file is part of Visilib.
+
+Visilib is free software : you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Visilib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Visilib. If not, see <http://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "geometry_ray.h"
+#include "math_vector_3.h"
+#include "visilib_core.h"
+
+namespace visilib
+{
+    /** @brief A packet of N triangles stored as arrays of coordinates, intersected at once by a ray
+
+    The intersection is the watertight ray-triangle test of MathGeometry::hitsTriangle, evaluated for the N triangles of the packet by loops
+    without dependency between their iterations. The loops are written to be auto-vectorized: there is no intrinsic nor runtime dispatch, and
+    the vector instructions used, if any, are the ones enabled by the compiler flags (e.g. -mavx2).
+    The lanes whose edge functions are exactly zero are computed again in double precision, as in the scalar test.
+    The unused lanes of a packet contain degenerate triangles, which are never hit.
+    */
+
+    template<size_t N>
+    class GeometryTrianglePacket_
+    {
+    public:
+        static_assert(N > 0 && N <= 32, "The hits of a packet are returned as a 32 bits mask");
+
+        static constexpr size_t WIDTH = N;
+
+        GeometryTrianglePacket_();
+
+        /** @brief Add a triangle to the packet
+
+        @param aGeometryId, aFaceIndex: the identifiers returned for the triangle
+        @return: false if the packet is full
+        */
+        bool add(const MathVector3f& v0, const MathVector3f& v1, const MathVector3f& v2, size_t aGeometryId, size_t aFaceIndex);
+
+        /** @brief Replace the vertices of the triangle of a lane, keeping its identifiers*/
+        void setVertices(size_t aLane, const MathVector3f& v0, const MathVector3f& v1, const MathVector3f& v2);
+
+        size_t getCount() const
+        {
+            return mCount;
+        }
+
+        bool isFull() const
+        {
+            return mCount == N;
+        }
+
+        /** @brief Get a vertex (0, 1 or 2) of the triangle of a lane*/
+        MathVector3f getVertex(size_t aLane, size_t aVertex) const
+        {
+            return MathVector3f(mVertices[aVertex][0][aLane], mVertices[aVertex][1][aLane], mVertices[aVertex][2][aLane]);
+        }
+
+        size_t getGeometryId(size_t aLane) const
+        {
+            return mGeometryIds[aLane];
+        }
+
+        size_t getFaceIndex(size_t aLane) const
+        {
+            return mFaceIndices[aLane];
+        }
+
+        /** @brief Intersect the triangles with a ray segment ("all hits")
+
+        @param aRay: the ray
+        @param aTnear, aTfar: the distances along the ray bounding the segment
+        @param aDistances: if not nullptr, receives the distance of the hit of each lane of the returned mask
+        @return: a mask whose bit i is set if the triangle of lane i is hit
+        */
+        uint32_t intersect(const GeometryRay& aRay, float aTnear, float aTfar, float* aDistances = nullptr) const;
+
+        /** @brief Return true if one of the triangles is hit by the ray segment ("any hit")*/
+        bool intersectAny(const GeometryRay& aRay, float aTnear, float aTfar) const
+        {
+            return intersect(aRay, aTnear, aTfar) != 0;
+        }
+
+    private:
+        /** @brief The watertight test of one lane in double precision, used when an edge function is zero in single precision*/
+        bool intersectLane(size_t aLane, const GeometryRay& aRay, float aTnear, float aTfar, float& aDistance) const;
+
+        alignas(64) float mVertices[3][3][N];   /**< @brief The coordinates of the triangles, indexed by vertex, axis and lane*/
+        size_t mGeometryIds[N];
+        size_t mFaceIndices[N];
+        size_t mCount;
+    };
+
+    /** @brief The packet width, filling a 256 bits vector register when the compiler targets AVX2*/
+    typedef GeometryTrianglePacket_<8> GeometryTrianglePacket;
+
+    template<size_t N>
+    inline GeometryTrianglePacket_<N>::GeometryTrianglePacket_()
+        : mCount(0)
+    {
+        memset(mVertices, 0, sizeof(mVertices));
+        memset(mGeometryIds, 0, sizeof(mGeometryIds));
+        memset(mFaceIndices, 0, sizeof(mFaceIndices));
+    }
+
+    template<size_t N>
+    inline bool GeometryTrianglePacket_<N>::add(const MathVector3f& v0, const MathVector3f& v1, const MathVector3f& v2, size_t aGeometryId, size_t aFaceIndex)
+    {
+        if (mCount == N)
+        {
+            return false;
+        }
+
+        setVertices(mCount, v0, v1, v2);
+        mGeometryIds[mCount] = aGeometryId;
+        mFaceIndices[mCount] = aFaceIndex;
+        mCount++;
+        return true;
+    }
+
+    template<size_t N>
+    inline void GeometryTrianglePacket_<N>::setVertices(size_t aLane, const MathVector3f& v0, const MathVector3f& v1, const MathVector3f& v2)
+    {
+        V_ASSERT(aLane < N);
+
+        for (size_t j = 0; j < 3; j++)
+        {
+            mVertices[0][j][aLane] = v0[j];
+            mVertices[1][j][aLane] = v1[j];
+            mVertices[2][j][aLane] = v2[j];
+        }
+    }
+
+    template<size_t N>
+    inline uint32_t GeometryTrianglePacket_<N>::intersect(const GeometryRay& aRay, float aTnear, float aTfar, float* aDistances) const
+    {
+        float Sx, Sy, Sz;
+        int kx, ky, kz;
+        aRay.get(Sx, Sy, Sz, kx, ky, kz);
+        const MathVector3f& myStart = aRay.getStart();
+
+        const float* myAx = mVertices[0][kx]; const float* myAy = mVertices[0][ky]; const float* myAz = mVertices[0][kz];
+        const float* myBx = mVertices[1][kx]; const float* myBy = mVertices[1][ky]; const float* myBz = mVertices[1][kz];
+        const float* myCx = mVertices[2][kx]; const float* myCy = mVertices[2][ky]; const float* myCz = mVertices[2][kz];
+        const float myOx = myStart[kx];
+        const float myOy = myStart[ky];
+        const float myOz = myStart[kz];
+
+        float myDistances[N];
+        uint32_t myHits[N];
+        uint32_t myFallbacks[N];
+
+        for (size_t i = 0; i < N; i++)
+        {
+            // Translate and shear the vertices, such that the ray is the z axis
+            const float Az = myAz[i] - myOz;
+            const float Bz = myBz[i] - myOz;
+            const float Cz = myCz[i] - myOz;
+            const float Ax = (myAx[i] - myOx) - Sx * Az;
+            const float Ay = (myAy[i] - myOy) - Sy * Az;
+            const float Bx = (myBx[i] - myOx) - Sx * Bz;
+            const float By = (myBy[i] - myOy) - Sy * Bz;
+            const float Cx = (myCx[i] - myOx) - Sx * Cz;
+            const float Cy = (myCy[i] - myOy) - Sy * Cz;
+
+            const float U = Cx * By - Cy * Bx;
+            const float V = Ax * Cy - Ay * Cx;
+            const float W = Bx * Ay - By * Ax;
+
+            const float det = U + V + W;
+            const float T = Sz * (U * Az + V * Bz + W * Cz);
+            const float t = T / (det != 0.0f ? det : 1.0f);
+
+            const uint32_t isOutside = ((U < 0.0f) | (V < 0.0f) | (W < 0.0f)) & ((U > 0.0f) | (V > 0.0f) | (W > 0.0f));
+            myHits[i] = (1u - isOutside) & (det != 0.0f) & (t >= aTnear) & (t <= aTfar);
+            myFallbacks[i] = (U == 0.0f) | (V == 0.0f) | (W == 0.0f);
+            myDistances[i] = t;
+        }
+
+        uint32_t myMask = 0;
+        for (size_t i = 0; i < mCount; i++)
+        {
+            if (myFallbacks[i])
+            {
+                myHits[i] = intersectLane(i, aRay, aTnear, aTfar, myDistances[i]) ? 1 : 0;
+            }
+            myMask |= myHits[i] << i;
+        }
+
+        if (aDistances != nullptr)
+        {
+            memcpy(aDistances, myDistances, sizeof(myDistances));
+        }
+        return myMask;
+    }
+
+    template<size_t N>
+    inline bool GeometryTrianglePacket_<N>::intersectLane(size_t aLane, const GeometryRay& aRay, float aTnear, float aTfar, float& aDistance) const
+    {
+        double Sx, Sy, Sz;
+        int kx, ky, kz;
+        aRay.get(Sx, Sy, Sz, kx, ky, kz);
+        const MathVector3f& myStart = aRay.getStart();
+
+        const double Az = (double)mVertices[0][kz][aLane] - myStart[kz];
+        const double Bz = (double)mVertices[1][kz][aLane] - myStart[kz];
+        const double Cz = (double)mVertices[2][kz][aLane] - myStart[kz];
+        const double Ax = ((double)mVertices[0][kx][aLane] - myStart[kx]) - Sx * Az;
+        const double Ay = ((double)mVertices[0][ky][aLane] - myStart[ky]) - Sy * Az;
+        const double Bx = ((double)mVertices[1][kx][aLane] - myStart[kx]) - Sx * Bz;
+        const double By = ((double)mVertices[1][ky][aLane] - myStart[ky]) - Sy * Bz;
+        const double Cx = ((double)mVertices[2][kx][aLane] - myStart[kx]) - Sx * Cz;
+        const double Cy = ((double)mVertices[2][ky][aLane] - myStart[ky]) - Sy * Cz;
+
+        const double U = Cx * By - Cy * Bx;
+        const double V = Ax * Cy - Ay * Cx;
+        const double W = Bx * Ay - By * Ax;
+
+        if ((U < 0.0 || V < 0.0 || W < 0.0) && (U > 0.0 || V > 0.0 || W > 0.0))
+        {
+            return false;
+        }
+
+        const double det = U + V + W;
+        if (det == 0.0)
+        {
+            return false;
+        }
+
+        aDistance = (float)(Sz * (U * Az + V * Bz + W * Cz) / det);
+        return aDistance >= aTnear && aDistance <= aTfar;
+    }
+}
@@ -0,0 +1,295 @@
+/*
+Visilib, an open source library for exact visibility computation.
+Copyright(C) 2021 by Denis Haumont
+
+This file is part of Visilib.
+
+Visilib is free software : you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Visilib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Visilib. If not, see <http://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "geometry_mesh_description.h"
+#include "geometry_occluder_set.h"
+#include "helper_mapped_file.h"
+
+namespace visilib
+{
+    /** @brief A preprocessed occluder set stored in a binary file
+
+    The file contains, for each occluder, its vertex and index tables, the neighbour table of its faces (as computed by GeometryOccluderSet)
+    and its bounding box, followed by the BVH of the faces of all the occluders. The file is mapped in memory and used in place: the occluder sets
+    created from the file reference the mapping directly, without parsing nor computing the adjacency of the faces, and copy the BVH without building it.
+    Several processes opening the same file share its pages. The indices and the neighbours are checked when the file is opened.
+
+    Layout of the file, in the byte order of the machine that wrote it:
+    - Header
+    - OccluderEntry table, one entry per occluder
+    - the sections referenced by the entries: vertices (3 floats per vertex), indices and neighbours (3 ints per face)
+    - the BVH of the faces (GeometryTriangleBvh::write()), if the BVH of the occluder set was up to date when the file has been written
+    */
+
+    class HelperBinaryScene
+    {
+    public:
+        /** @brief The version of the format, incremented at each incompatible change*/
+        static constexpr uint32_t VERSION = 1;
+
+        /** @brief Write the occluders of a prepared occluder set to a binary file
+
+        @param aFileName: the name of the file
+        @param anOccluderSet: the occluder set, prepared (GeometryOccluderSet::prepare()). Only the triangle meshes are supported.
+        A removed occluder is stored as an empty mesh, such that the ids of the occluders are preserved. The BVH of the set is stored if it is up
+        to date (GeometryOccluderSet::updateBvh()) and if no removed occluder keeps face ids in it; otherwise it is built when the file is loaded.
+        @return: true if the file has been written
+        */
+        static bool write(const std::string& aFileName, GeometryOccluderSet* anOccluderSet);
+
+        HelperBinaryScene();
+
+        /** @brief Map a binary file in memory and check its header, the bounds of its sections, and the indices and neighbours of the faces
+
+        @return: true if the file is a valid binary scene of the current version
+        */
+        bool open(const std::string& aFileName);
+
+        size_t getOccluderCount() const
+        {
+            return mHeader == nullptr ? 0 : (size_t)mHeader->mOccluderCount;
+        }
+
+        /** @brief Create an occluder set referencing the content of the file.
+
+        The occluder set is prepared, with the BVH stored in the file if it matches the occluders. It must be deleted before the HelperBinaryScene is closed or destroyed.
+        */
+        GeometryOccluderSet* createOccluderSet() const;
+
+    private:
+        struct Header
+        {
+            char mMagic[4];                 /**< @brief The identifier of the format: "VSLB"*/
+            uint32_t mVersion;              /**< @brief The version of the format*/
+            uint32_t mByteOrder;            /**< @brief The value BYTE_ORDER_MARK written in the byte order of the machine that wrote the file*/
+            uint32_t mReserved;
+            uint64_t mOccluderCount;        /**< @brief The number of occluders*/
+            uint64_t mBvhOffset;            /**< @brief The offset of a serialized BVH of the occluders, 0 if the file does not contain a BVH*/
+            uint64_t mBvhSize;              /**< @brief The size of the serialized BVH in bytes*/
+        };
+
+        struct OccluderEntry
+        {
+            uint64_t mVertexCount;          /**< @brief The number of vertices of the occluder*/
+            uint64_t mFaceCount;            /**< @brief The number of triangles of the occluder*/
+            uint64_t mVertexOffset;         /**< @brief The offset of the vertex table in the file*/
+            uint64_t mIndexOffset;          /**< @brief The offset of the index table in the file*/
+            uint64_t mNeighbourOffset;      /**< @brief The offset of the neighbour table in the file*/
+            float mMin[3];                  /**< @brief The bounding box of the occluder*/
+            float mMax[3];
+        };
+
+        static constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+        /** @brief Return true if a section of the file lies inside the mapping*/
+        bool isInside(uint64_t anOffset, uint64_t aCount, uint64_t anElementSize) const
+        {
+            return anOffset % 4 == 0 && anOffset <= mFile.getSize() && aCount <= (mFile.getSize() - anOffset) / anElementSize;
+        }
+
+        HelperMappedFile mFile;             /**< @brief The mapping of the file*/
+        const Header* mHeader;              /**< @brief The header of the file, nullptr if no valid file is opened*/
+        const OccluderEntry* mOccluders;    /**< @brief The occluder table of the file*/
+    };
+
+    inline HelperBinaryScene::HelperBinaryScene()
+        : mHeader(nullptr),
+        mOccluders(nullptr)
+    {
+    }
+
+    inline bool HelperBinaryScene::write(const std::string& aFileName, GeometryOccluderSet* anOccluderSet)
+    {
+        size_t myOccluderCount = anOccluderSet->getOccluderCount();
+
+        Header myHeader;
+        memset(&myHeader, 0, sizeof(Header));
+        memcpy(myHeader.mMagic, "VSLB", 4);
+        myHeader.mVersion = VERSION;
+        myHeader.mByteOrder = BYTE_ORDER_MARK;
+        myHeader.mOccluderCount = myOccluderCount;
+
+        // The sections follow the occluder table
+        std::vector<OccluderEntry> myEntries(myOccluderCount);
+        uint64_t myOffset = sizeof(Header) + myOccluderCount * sizeof(OccluderEntry);
+        uint64_t myFaceCount = 0;
+        for (size_t i = 0; i < myOccluderCount; i++)
+        {
+            GeometryDiscreteMeshDescription* myMesh = anOccluderSet->getOccluder(i);
+            const GeometryAABB& myBox = anOccluderSet->getOccluderBoundingBox(i);
+            OccluderEntry& myEntry = myEntries[i];
+
+            myEntry.mVertexCount = myMesh == nullptr ? 0 : myMesh->vertexCount;
+            myEntry.mFaceCount = myMesh == nullptr ? 0 : myMesh->faceCount;
+            myFaceCount += myEntry.mFaceCount;
+            myEntry.mVertexOffset = myOffset;
+            myOffset += myEntry.mVertexCount * 3 * sizeof(float);
+            myEntry.mIndexOffset = myOffset;
+            myOffset += myEntry.mFaceCount * 3 * sizeof(int32_t);
+            myEntry.mNeighbourOffset = myOffset;
+            myOffset += myEntry.mFaceCount * 3 * sizeof(int32_t);
+
+            myEntry.mMin[0] = myBox.getMin().x; myEntry.mMin[1] = myBox.getMin().y; myEntry.mMin[2] = myBox.getMin().z;
+            myEntry.mMax[0] = myBox.getMax().x; myEntry.mMax[1] = myBox.getMax().y; myEntry.mMax[2] = myBox.getMax().z;
+        }
+
+        // The face ids of the BVH are the ones of the occluders of the file if the removed occluders do not keep faces in it
+        std::ostringstream myBvh;
+        if (anOccluderSet->isBvhUpToDate() && anOccluderSet->getFaceIdCount() == myFaceCount)
+        {
+            anOccluderSet->getBvh().write(myBvh);
+            myHeader.mBvhOffset = myOffset;
+            myHeader.mBvhSize = myBvh.str().size();
+        }
+
+        std::ofstream myOutput(aFileName.c_str(), std::ios::binary);
+        if (!myOutput.good())
+            return false;
+
+        myOutput.write(reinterpret_cast<const char*>(&myHeader), sizeof(Header));
+        myOutput.write(reinterpret_cast<const char*>(myEntries.data()), myEntries.size() * sizeof(OccluderEntry));
+
+        std::vector<int32_t> myIndices;
+        std::vector<int32_t> myNeighbours;
+        for (size_t i = 0; i < myOccluderCount; i++)
+        {
+            GeometryDiscreteMeshDescription* myMesh = anOccluderSet->getOccluder(i);
+            if (myMesh == nullptr)
+                continue;
+
+            const std::vector<SilhouetteMeshFace>* myFaces = anOccluderSet->getOccluderConnectedFaces(i);
+
+            myIndices.clear();
+            myNeighbours.clear();
+            for (size_t myFace = 0; myFace < myMesh->faceCount; myFace++)
+            {
+                std::vector<int> myFaceIndices = myMesh->getIndices(myFace);
+                if (myFaceIndices.size() != 3)
+                    return false;
+
+                for (size_t j = 0; j < 3; j++)
+                {
+                    myIndices.push_back(myFaceIndices[j]);
+                    myNeighbours.push_back((*myFaces)[myFace].getNeighbours(j));
+                }
+            }
+            myOutput.write(reinterpret_cast<const char*>(myMesh->vertexArray), myMesh->vertexCount * 3 * sizeof(float));
+            myOutput.write(reinterpret_cast<const char*>(myIndices.data()), myIndices.size() * sizeof(int32_t));
+            myOutput.write(reinterpret_cast<const char*>(myNeighbours.data()), myNeighbours.size() * sizeof(int32_t));
+        }
+        const std::string myBvhData = myBvh.str();
+        myOutput.write(myBvhData.data(), myBvhData.size());
+        return myOutput.good();
+    }
+
+    inline bool HelperBinaryScene::open(const std::string& aFileName)
+    {
+        mHeader = nullptr;
+        mOccluders = nullptr;
+
+        if (!mFile.open(aFileName) || mFile.getSize() < sizeof(Header))
+            return false;
+
+        const Header* myHeader = reinterpret_cast<const Header*>(mFile.getData());
+        if (memcmp(myHeader->mMagic, "VSLB", 4) != 0 || myHeader->mVersion != VERSION || myHeader->mByteOrder != BYTE_ORDER_MARK)
+            return false;
+
+        if (!isInside(sizeof(Header), myHeader->mOccluderCount, sizeof(OccluderEntry)))
+            return false;
+
+        if (myHeader->mBvhOffset != 0 && !isInside(myHeader->mBvhOffset, myHeader->mBvhSize, 1))
+            return false;
+
+        // The vertices are used as is, the indices and the neighbours are checked such that the faces and their adjacency stay inside the occluder
+        const OccluderEntry* myOccluders = reinterpret_cast<const OccluderEntry*>(mFile.getData() + sizeof(Header));
+        for (size_t i = 0; i < myHeader->mOccluderCount; i++)
+        {
+            const OccluderEntry& myEntry = myOccluders[i];
+            if (!isInside(myEntry.mVertexOffset, myEntry.mVertexCount, 3 * sizeof(float))
+                || !isInside(myEntry.mIndexOffset, myEntry.mFaceCount, 3 * sizeof(int32_t))
+                || !isInside(myEntry.mNeighbourOffset, myEntry.mFaceCount, 3 * sizeof(int32_t)))
+                return false;
+
+            const int32_t* myIndices = reinterpret_cast<const int32_t*>(mFile.getData() + myEntry.mIndexOffset);
+            const int32_t* myNeighbours = reinterpret_cast<const int32_t*>(mFile.getData() + myEntry.mNeighbourOffset);
+            for (size_t j = 0; j < myEntry.mFaceCount * 3; j++)
+            {
+                if (myIndices[j] < 0 || (uint64_t)myIndices[j] >= myEntry.mVertexCount
+                    || myNeighbours[j] < -1 || (myNeighbours[j] >= 0 && (uint64_t)myNeighbours[j] >= myEntry.mFaceCount))
+                    return false;
+            }
+        }
+
+        mHeader = myHeader;
+        mOccluders = myOccluders;
+        return true;
+    }
+
+    inline GeometryOccluderSet* HelperBinaryScene::createOccluderSet() const
+    {
+        GeometryOccluderSet* myOccluderSet = new GeometryOccluderSet();
+        std::vector<GeometryAABB> myBoundingBoxes;
+        myBoundingBoxes.reserve(getOccluderCount());
+
+        for (size_t i = 0; i < getOccluderCount(); i++)
+        {
+            const OccluderEntry& myEntry = mOccluders[i];
+
+            GeometryTriangleMeshDescription* myMesh = new GeometryTriangleMeshDescription();
+            myMesh->vertexCount = (size_t)myEntry.mVertexCount;
+            myMesh->faceCount = (size_t)myEntry.mFaceCount;
+            myMesh->vertexArray = reinterpret_cast<const float*>(mFile.getData() + myEntry.mVertexOffset);
+            myMesh->indexArray = reinterpret_cast<const int*>(mFile.getData() + myEntry.mIndexOffset);
+
+            myOccluderSet->addOccluder(myMesh, reinterpret_cast<const int*>(mFile.getData() + myEntry.mNeighbourOffset));
+            myBoundingBoxes.push_back(GeometryAABB(MathVector3f(myEntry.mMin[0], myEntry.mMin[1], myEntry.mMin[2]),
+                                                   MathVector3f(myEntry.mMax[0], myEntry.mMax[1], myEntry.mMax[2])));
+        }
+        if (mHeader->mBvhOffset != 0)
+        {
+            myOccluderSet->prepare(myBoundingBoxes, mFile.getData() + mHeader->mBvhOffset, (size_t)mHeader->mBvhSize);
+        }
+        else
+        {
+            myOccluderSet->prepare(myBoundingBoxes);
+        }
+
+        // The empty meshes are the occluders removed before the file has been written
+        for (size_t i = 0; i < getOccluderCount(); i++)
+        {
+            if (mOccluders[i].mFaceCount == 0)
+            {
+                myOccluderSet->removeOccluder(i);
+            }
+        }
+        myOccluderSet->updateBvh();
+        myOccluderSet->clearChanges();
+        return myOccluderSet;
+    }
+}
@@ -20,11 +20,16 @@ along with Visilib. If not, see <http://www.gnu.org/licenses/>
 
 #pragma once
 
+#include <algorithm>
+#include <charconv>
+#include <cstring>
 #include <vector>
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <thread>
 
+#include "helper_mapped_file.h"
 #include "helper_triangle_mesh_container.h"
 #include "helper_triangle_mesh.h"
 
@@ -34,7 +39,9 @@ namespace visilib
 
     /** @brief An helper class allowing to read triangle mesh stored in the ".obj" file format
 
-    The obj reader code is inspired from Meshlab implementation http://meshlab.sourceforge.net/
+    The file is mapped in memory and parsed in place, without allocation per line. Large files can be parsed by several threads,
+    each thread parsing a range of lines. One triangle mesh is added to the scene for each group ("g") or object ("o") of the file,
+    so that each part of the scene can be handled as a separate occluder. The polygonal faces are triangulated as fans.
     */
 
     class HelperGeometrySceneReader
@@ -45,13 +52,60 @@ namespace visilib
 
         ~HelperGeometrySceneReader();
 
-        bool readFileObj(const std::string& fileName);
+        /** @brief Read a ".obj" file and add its triangle meshes to the scene
+
+        @param fileName: the name of the file
+        @param aThreadCount: the number of threads parsing the file, 0 to use all the hardware threads
+        @return: true if the file has been read, false if it cannot be opened or is malformed
+        */
+        bool readFileObj(const std::string& fileName, size_t aThreadCount = 1);
 
         static void tokenizeNextLine(std::istream& stream, std::vector< std::string >& tokens);
 
 
     private:
 
+        /** @brief The content parsed from a range of lines of an ".obj" file*/
+        struct ObjChunk
+        {
+            std::vector<MathVector3f> mVertices;            /**< @brief The vertices defined in the range*/
+            std::vector<long long> mTriangles;              /**< @brief The vertex indices of the triangles, global or relative to the first vertex of the range*/
+            std::vector<size_t> mRelativeIndices;           /**< @brief The position in mTriangles of the indices relative to the first vertex of the range*/
+            std::vector<size_t> mGroupStarts;               /**< @brief The number of triangles of the range preceding each group or object statement*/
+            bool mIsValid = true;                           /**< @brief False if a malformed statement has been found*/
+        };
+
+        /** @brief Parse the complete lines contained in [aBegin, anEnd[*/
+        static void parseObjChunk(const char* aBegin, const char* anEnd, ObjChunk& aChunk);
+
+        /** @brief Merge the parsed ranges and add one triangle mesh per group to the scene*/
+        bool addObjMeshes(std::vector<ObjChunk>& aChunks);
+
+        static bool isBlank(char c)
+        {
+            return c == ' ' || c == '\t' || c == '\r';
+        }
+
+        static const char* skipBlanks(const char* aBegin, const char* anEnd)
+        {
+            while (aBegin != anEnd && isBlank(*aBegin))
+                aBegin++;
+            return aBegin;
+        }
+
+        static const char* skipToken(const char* aBegin, const char* anEnd)
+        {
+            while (aBegin != anEnd && !isBlank(*aBegin))
+                aBegin++;
+            return aBegin;
+        }
+
+        /** @brief Return true if the line starts with the given statement keyword*/
+        static bool hasKeyword(const char* aBegin, const char* anEnd, char aKeyword)
+        {
+            return aBegin[0] == aKeyword && (aBegin + 1 == anEnd || isBlank(aBegin[1]));
+        }
+
         HelperTriangleMeshContainer* mScene;
     };
 
@@ -101,117 +155,231 @@ namespace visilib
         } while (from < length);
     } // end TokenizeNextLine
 
-    inline bool HelperGeometrySceneReader::readFileObj(const std::string & fileName)
+    inline void HelperGeometrySceneReader::parseObjChunk(const char* aBegin, const char* anEnd, ObjChunk& aChunk)
     {
-        std::ifstream stream(fileName.c_str());
-
-        if (!stream.good())
-            return false;
-
-        std::vector< std::string > tokens;
-        std::string	header;
-
-        std::vector<float> vertices;
-        std::vector<int> indices;
+        const char* myLine = aBegin;
 
-        size_t faceCount = 0;
-        size_t firstVertexIndex = 0;
-        size_t indexCount = 0;
-
-        while (!stream.eof())
+        while (myLine < anEnd && aChunk.mIsValid)
         {
-            tokens.clear();
-            tokenizeNextLine(stream, tokens);
+            const char* myLineEnd = reinterpret_cast<const char*>(memchr(myLine, '\n', anEnd - myLine));
+            if (myLineEnd == nullptr)
+                myLineEnd = anEnd;
 
-            int numTokens = static_cast<int>(tokens.size());
-            if (numTokens == 0) continue;
+            const char* p = skipBlanks(myLine, myLineEnd);
+            myLine = myLineEnd + 1;
 
-            header.clear();
-            header = tokens[0];
+            if (p == myLineEnd)
+                continue;
 
-            if (header.compare("g") == 0)	// vertex
+            if (hasKeyword(p, myLineEnd, 'v'))	// vertex
             {
-                /*std::string surfaceName = "";
-                for (int i = 1; i < numTokens; i++)
+                float myCoordinates[3];
+                p++;
+                for (int i = 0; i < 3; i++)
                 {
-                surfaceName += tokens[i];
-                surfaceName += " ";
+                    p = skipBlanks(p, myLineEnd);
+                    // from_chars does not accept the leading plus sign
+                    if (p != myLineEnd && *p == '+')
+                        p++;
+                    auto myResult = std::from_chars(p, myLineEnd, myCoordinates[i]);
+                    if (myResult.ec != std::errc())
+                    {
+                        aChunk.mIsValid = false;
+                        return;
+                    }
+                    p = myResult.ptr;
                 }
-
-                if (faceCount > 0 && vertices.size() > 0)
+                aChunk.mVertices.push_back(MathVector3f(myCoordinates[0], myCoordinates[1], myCoordinates[2]));
+            }
+            else if (hasKeyword(p, myLineEnd, 'f'))  // face
+            {
+                long long myFirst = 0;
+                long long myPrevious = 0;
+                bool isFirstRelative = false;
+                bool isPreviousRelative = false;
+                size_t myVertexCount = 0;
+                p++;
+
+                while (true)
                 {
-                GeometryMesh* mesh = new GeometryMesh(vertices, indices);
-
-                mScene->add(mesh);
-                firstVertexIndex += (vertices.size()/3);
-                }
+                    p = skipBlanks(p, myLineEnd);
+                    if (p == myLineEnd)
+                        break;
+
+                    // The texture and normal indices following the vertex index ("v/vt/vn") are ignored
+                    long long myIndex = 0;
+                    auto myResult = std::from_chars(p, myLineEnd, myIndex);
+                    if (myResult.ec != std::errc() || myIndex == 0)
+                    {
+                        aChunk.mIsValid = false;
+                        return;
+                    }
+                    p = skipToken(myResult.ptr, myLineEnd);
 
-                faceCount = 0;
-                indexCount = 0;
+                    // remember index starts from 1 instead of 0, and negative indices are relative to the last vertex defined
+                    bool isRelative = myIndex < 0;
+                    myIndex = isRelative ? (long long)aChunk.mVertices.size() + myIndex : myIndex - 1;
 
-                vertices.clear();
-                indices.clear();			*/
+                    if (myVertexCount >= 2)
+                    {
+                        long long myTriangle[3] = { myFirst, myPrevious, myIndex };
+                        bool isRelativeTriangle[3] = { isFirstRelative, isPreviousRelative, isRelative };
+                        for (int i = 0; i < 3; i++)
+                        {
+                            if (isRelativeTriangle[i])
+                            {
+                                aChunk.mRelativeIndices.push_back(aChunk.mTriangles.size());
+                            }
+                            aChunk.mTriangles.push_back(myTriangle[i]);
+                        }
+                    }
+                    if (myVertexCount == 0)
+                    {
+                        myFirst = myIndex;
+                        isFirstRelative = isRelative;
+                    }
+                    myPrevious = myIndex;
+                    isPreviousRelative = isRelative;
+                    myVertexCount++;
+                }
             }
-            if (header.compare("v") == 0)	// vertex
+            else if (hasKeyword(p, myLineEnd, 'g') || hasKeyword(p, myLineEnd, 'o'))  // group or object
             {
-                if (numTokens < 4) return false;
-
-                float x = (float)atof(tokens[1].c_str());
-                float y = (float)atof(tokens[2].c_str());
-                float z = (float)atof(tokens[3].c_str());
-                vertices.push_back(x);
-                vertices.push_back(y);
-                vertices.push_back(z);
+                aChunk.mGroupStarts.push_back(aChunk.mTriangles.size() / 3);
             }
-            else if (header.compare("vt") == 0)	// vertex texture coords
-            {
-                if (numTokens < 3) return false;
+            // The other statements (comments, texture coordinates, normals, materials...) are ignored
+        }
+    }
+
+    inline bool HelperGeometrySceneReader::addObjMeshes(std::vector<ObjChunk>& aChunks)
+    {
+        // Resolve the vertex indices relative to the ranges, and gather the vertices of the file
+        size_t myVertexCount = 0;
+        for (auto& myChunk : aChunks)
+        {
+            if (!myChunk.mIsValid)
+                return false;
 
-                //float u = static_cast<float>(atof(tokens[1].c_str()));
-                //float t = static_cast<float>(atof(tokens[2].c_str()));
+            for (size_t myPosition : myChunk.mRelativeIndices)
+            {
+                myChunk.mTriangles[myPosition] += (long long)myVertexCount;
             }
-            else if (header.compare("vn") == 0)  // vertex normal
+            myVertexCount += myChunk.mVertices.size();
+        }
+
+        std::vector<MathVector3f> myVertices;
+        myVertices.reserve(myVertexCount);
+        for (auto& myChunk : aChunks)
+        {
+            myVertices.insert(myVertices.end(), myChunk.mVertices.begin(), myChunk.mVertices.end());
+            std::vector<MathVector3f>().swap(myChunk.mVertices);
+        }
+
+        // Each group only keeps the vertices it references, in the order of the file
+        std::vector<int> myLocalIndices(myVertexCount, -1);
+        std::vector<MathVector3f> myGroupVertices;
+        std::vector<int> myGroupIndices;
+
+        auto addGroup = [&](const long long* aTriangles, size_t aTriangleCount) -> bool
+        {
+            if (aTriangleCount == 0)
+                return true;
+
+            long long myMin = (long long)myVertexCount;
+            long long myMax = -1;
+            for (size_t i = 0; i < aTriangleCount * 3; i++)
             {
-                if (numTokens != 4) return false;
+                long long myIndex = aTriangles[i];
+                if (myIndex < 0 || myIndex >= (long long)myVertexCount)
+                    return false;
+                myLocalIndices[myIndex] = 0;
+                myMin = std::min(myMin, myIndex);
+                myMax = std::max(myMax, myIndex);
+            }
 
-                //float nx = (float)atof(tokens[1].c_str());
-                //float ny = (float)atof(tokens[2].c_str());
-                //float nz = (float)atof(tokens[3].c_str());
+            myGroupVertices.clear();
+            for (long long i = myMin; i <= myMax; i++)
+            {
+                if (myLocalIndices[i] == 0)
+                {
+                    myLocalIndices[i] = static_cast<int>(myGroupVertices.size()) + 1;
+                    myGroupVertices.push_back(myVertices[i]);
+                }
             }
-            else if ((header.compare("f") == 0))  // face
+
+            myGroupIndices.resize(aTriangleCount * 3);
+            for (size_t i = 0; i < aTriangleCount * 3; i++)
             {
-                size_t vertexCount = tokens.size() - 1;
+                myGroupIndices[i] = myLocalIndices[aTriangles[i]] - 1;
+            }
+            std::fill(myLocalIndices.begin() + myMin, myLocalIndices.begin() + myMax + 1, -1);
 
-                if (vertexCount >= 3)
-                {
-                    faceCount++;
+            mScene->add(new HelperTriangleMesh(myGroupVertices, myGroupIndices));
+            return true;
+        };
 
-                    for (int i = 0; i < vertexCount; ++i) // remember index starts from 1 instead of 0
-                    {
-                        size_t vertexIndex = atoi(tokens[i + 1].c_str());
-                        indices.push_back(static_cast<int>(vertexIndex - 1 - firstVertexIndex));
-                    }
-                    indexCount += vertexCount;
-                }
+        // The triangles of a group can span several ranges: they are gathered until the next group statement
+        std::vector<long long> myGroupTriangles;
+        for (auto& myChunk : aChunks)
+        {
+            size_t myBegin = 0;
+            for (size_t myGroupStart : myChunk.mGroupStarts)
+            {
+                myGroupTriangles.insert(myGroupTriangles.end(), myChunk.mTriangles.begin() + myBegin * 3, myChunk.mTriangles.begin() + myGroupStart * 3);
+                if (!addGroup(myGroupTriangles.data(), myGroupTriangles.size() / 3))
+                    return false;
+                myGroupTriangles.clear();
+                myBegin = myGroupStart;
             }
+            myGroupTriangles.insert(myGroupTriangles.end(), myChunk.mTriangles.begin() + myBegin * 3, myChunk.mTriangles.end());
+            std::vector<long long>().swap(myChunk.mTriangles);
         }
+        return addGroup(myGroupTriangles.data(), myGroupTriangles.size() / 3);
+    }
+
+    inline bool HelperGeometrySceneReader::readFileObj(const std::string & fileName, size_t aThreadCount)
+    {
+        HelperMappedFile myFile;
+
+        if (!myFile.open(fileName))
+            return false;
+
+        const char* myData = myFile.getData();
+        const char* myEnd = myData + myFile.getSize();
 
-        if (faceCount > 0 && vertices.size() > 0)
+        if (aThreadCount == 0)
         {
-            if (indices[0] < 0)
-            {
-                size_t firstVertex = vertices.size() / 3 + 1;
+            aThreadCount = std::max<size_t>(1, std::thread::hardware_concurrency());
+        }
 
-                for (int i = 0; i < indices.size(); i++)
-                {
-                    indices[i] = static_cast<int>(firstVertex + indices[i]);
-                }
-            }
-            HelperTriangleMesh* mesh = new HelperTriangleMesh(vertices, indices);
+        // Each thread parses at least one megabyte, the ranges ending at line boundaries
+        const size_t myMinimalChunkSize = 1 << 20;
+        size_t myChunkCount = std::max<size_t>(1, std::min(aThreadCount, myFile.getSize() / myMinimalChunkSize));
+
+        std::vector<const char*> myBoundaries(myChunkCount + 1, myEnd);
+        myBoundaries[0] = myData;
+        for (size_t i = 1; i < myChunkCount; i++)
+        {
+            const char* myBoundary = std::max(myBoundaries[i - 1], myData + myFile.getSize() * i / myChunkCount);
+            const char* myLineEnd = myBoundary < myEnd ? reinterpret_cast<const char*>(memchr(myBoundary, '\n', myEnd - myBoundary)) : nullptr;
+            myBoundaries[i] = myLineEnd == nullptr ? myEnd : myLineEnd + 1;
+        }
 
-            mScene->add(mesh);
+        std::vector<ObjChunk> myChunks(myChunkCount);
+        std::vector<std::thread> myThreads;
+        for (size_t i = 1; i < myChunkCount; i++)
+        {
+            myThreads.push_back(std::thread(&HelperGeometrySceneReader::parseObjChunk, myBoundaries[i], myBoundaries[i + 1], std::ref(myChunks[i])));
+        }
+        if (myData != nullptr)
+        {
+            parseObjChunk(myBoundaries[0], myBoundaries[1], myChunks[0]);
+        }
+        for (auto& myThread : myThreads)
+        {
+            myThread.join();
         }
 
-        return true;
+        return addObjMeshes(myChunks);
     }
 };
@@ -0,0 +1,201 @@
+/*
+Visilib, an open source library for exact visibility computation.
+Copyright(C) 2021 by Denis Haumont
+
+This file is part of Visilib.
+
+Visilib is free software : you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Visilib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Visilib. If not, see <http://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace visilib
+{
+    /** @brief A read-only view of the content of a file mapped in memory
+
+    The pages of the file are loaded on demand by the operating system, without copying the content of the file in a buffer.
+    */
+
+    class HelperMappedFile
+    {
+    public:
+        HelperMappedFile();
+
+        ~HelperMappedFile();
+
+        /** @brief Map a file in memory, replacing the file currently mapped
+
+        @return: true if the file has been mapped, false if it cannot be opened
+        */
+        bool open(const std::string& aFileName);
+
+        /** @brief Unmap the file*/
+        void close();
+
+        /** @brief Return the first byte of the file, nullptr if the file is empty*/
+        const char* getData() const
+        {
+            return mData;
+        }
+
+        size_t getSize() const
+        {
+            return mSize;
+        }
+
+    private:
+        HelperMappedFile(const HelperMappedFile&) = delete;
+        HelperMappedFile& operator=(const HelperMappedFile&) = delete;
+
+        const char* mData;          /**< @brief The content of the file*/
+        size_t mSize;               /**< @brief The size of the file in bytes*/
+#ifdef _WIN32
+        HANDLE mFile;               /**< @brief The handle of the file*/
+        HANDLE mMapping;            /**< @brief The handle of the file mapping*/
+#endif
+    };
+
+    inline HelperMappedFile::HelperMappedFile()
+        : mData(nullptr),
+        mSize(0)
+#ifdef _WIN32
+        , mFile(INVALID_HANDLE_VALUE),
+        mMapping(nullptr)
+#endif
+    {
+    }
+
+    inline HelperMappedFile::~HelperMappedFile()
+    {
+        close();
+    }
+
+#ifdef _WIN32
+    inline bool HelperMappedFile::open(const std::string& aFileName)
+    {
+        close();
+
+        mFile = CreateFileA(aFileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (mFile == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER mySize;
+        if (!GetFileSizeEx(mFile, &mySize))
+        {
+            close();
+            return false;
+        }
+        mSize = (size_t)mySize.QuadPart;
+
+        // An empty file cannot be mapped
+        if (mSize == 0)
+            return true;
+
+        mMapping = CreateFileMappingA(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mMapping == nullptr)
+        {
+            close();
+            return false;
+        }
+
+        mData = reinterpret_cast<const char*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+        if (mData == nullptr)
+        {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    inline void HelperMappedFile::close()
+    {
+        if (mData != nullptr)
+        {
+            UnmapViewOfFile(mData);
+        }
+        if (mMapping != nullptr)
+        {
+            CloseHandle(mMapping);
+        }
+        if (mFile != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(mFile);
+        }
+        mData = nullptr;
+        mSize = 0;
+        mMapping = nullptr;
+        mFile = INVALID_HANDLE_VALUE;
+    }
+#else
+    inline bool HelperMappedFile::open(const std::string& aFileName)
+    {
+        close();
+
+        int myFile = ::open(aFileName.c_str(), O_RDONLY);
+        if (myFile < 0)
+            return false;
+
+        struct stat myStatus;
+        if (fstat(myFile, &myStatus) != 0)
+        {
+            ::close(myFile);
+            return false;
+        }
+
+        // An empty file cannot be mapped
+        if (myStatus.st_size == 0)
+        {
+            ::close(myFile);
+            return true;
+        }
+
+        void* myData = mmap(nullptr, (size_t)myStatus.st_size, PROT_READ, MAP_PRIVATE, myFile, 0);
+
+        // The mapping remains valid once the file descriptor is closed
+        ::close(myFile);
+
+        if (myData == MAP_FAILED)
+            return false;
+
+        madvise(myData, (size_t)myStatus.st_size, MADV_SEQUENTIAL);
+        mData = reinterpret_cast<const char*>(myData);
+        mSize = (size_t)myStatus.st_size;
+        return true;
+    }
+
+    inline void HelperMappedFile::close()
+    {
+        if (mData != nullptr)
+        {
+            munmap(const_cast<char*>(mData), mSize);
+        }
+        mData = nullptr;
+        mSize = 0;
+    }
+#endif
+}
@@ -0,0 +1,492 @@
+/*
+Visilib, an open source library for exact visibility computation.
+Copyright(C) 2021 by Denis Haumont
+
+This file is part of Visilib.
+
+Visilib is free software : you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Visilib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Visilib. If not, see <http://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "visilib.h"
+#include "helper_pvs_shaft_index.h"
+#include "helper_pvs_store.h"
+
+namespace visilib
+{
+    /** @brief Resumable computation of the PVS of a set of cells
+
+    The PVS row of each cell is computed with areOccludersVisible: the columns of the PVS are the occluders of the scene.
+    Each completed row is appended to a journal file, flushed periodically. When a bake is interrupted (crash, preemption or row budget),
+    running it again with the same journal skips the rows already in the journal. A partially written record at the end of the journal
+    is discarded. The journal is restarted if it has been written for other cells or another scene, as identified by a hash of the vertices
+    of the cells and a hash of the face count and bounding box of each occluder. Once all the rows are completed, the PVS file is written from the journal.
+
+    A completed bake records the shaft of each entry in an invalidation index (HelperPvsShaftIndex). After a local edit of the occluders,
+    update() only computes again the entries whose shaft overlaps a changed occluder, and rewrites the journal and the PVS file.
+
+    Layout of the journal, in the byte order of the machine that wrote it:
+    - JournalHeader
+    - one record per completed row: the row index (uint64), the number of visible columns (uint32), the visible columns (uint32 each)
+      and a checksum of the record (uint32)
+    */
+
+    class HelperPvsBake
+    {
+    public:
+        /** @brief Create a bake
+
+        @param aScene: the occluders, prepared (GeometryOccluderSet::prepare())
+        @param aConfiguration: the configuration of the visibility queries
+        */
+        HelperPvsBake(GeometryOccluderSet* aScene, const VisibilityExactQueryConfiguration& aConfiguration);
+
+        /** @brief Set the number of rows between two flushes of the journal (default 1)*/
+        void setFlushInterval(size_t aRowCount)
+        {
+            mFlushInterval = aRowCount > 0 ? aRowCount : 1;
+        }
+
+        /** @brief Set the maximal number of rows computed by a single run, e.g. to share a worker between several bakes (default: no limit)*/
+        void setRowBudget(size_t aRowCount)
+        {
+            mRowBudget = aRowCount;
+        }
+
+        /** @brief Compute the PVS of the cells, resuming the rows already stored in the journal
+
+        @param aCells: the convex source polygon of each cell, as arrays of coordinates (3 per vertex)
+        @param aJournalFileName: the journal storing the completed rows
+        @param aPvsFileName: the PVS file written when all the rows are completed
+        @return: true if all the rows are completed and the PVS file has been written, false if the run stopped before or failed
+        */
+        bool run(const std::vector<std::vector<float>>& aCells, const std::string& aJournalFileName, const std::string& aPvsFileName);
+
+        /** @brief Update the PVS of a completed bake after changes of the occluders
+
+        All the affected entries are computed in a single batch, grouped by cell, then the journal and the PVS file are rewritten.
+        @param aCells: the cells used by the last run
+        @param aChanges: the changes of the occluders since the last run or update (GeometryOccluderSet::getChanges())
+        @param aJournalFileName: the journal of the bake
+        @param aPvsFileName: the PVS file
+        @return: true if the PVS file has been written, false if the bake is not completed or if the files cannot be written
+        */
+        bool update(const std::vector<std::vector<float>>& aCells, const std::vector<GeometryOccluderChange>& aChanges,
+            const std::string& aJournalFileName, const std::string& aPvsFileName);
+
+        /** @brief Return the PVS entries that may be affected by changes of the occluders, as pairs (row, column) sorted by row
+
+        The entries are found with the invalidation index of the last completed run, which is empty before.
+        */
+        void getAffectedEntries(const std::vector<GeometryOccluderChange>& aChanges, std::vector<std::pair<size_t, size_t>>& anEntries) const
+        {
+            mShaftIndex.getAffectedEntries(aChanges, anEntries);
+        }
+
+        /** @brief Return the invalidation index of the last completed run*/
+        HelperPvsShaftIndex& getShaftIndex()
+        {
+            return mShaftIndex;
+        }
+
+        /** @brief Return the number of entries computed by the last update*/
+        size_t getUpdatedEntryCount() const
+        {
+            return mUpdatedEntryCount;
+        }
+
+        /** @brief Return the number of rows read from the journal by the last run*/
+        size_t getResumedRowCount() const
+        {
+            return mResumedRowCount;
+        }
+
+        /** @brief Return the number of rows computed by the last run*/
+        size_t getComputedRowCount() const
+        {
+            return mComputedRowCount;
+        }
+
+    private:
+        struct JournalHeader
+        {
+            char mMagic[4];                 /**< @brief The identifier of the format: "VSLJ"*/
+            uint32_t mVersion;              /**< @brief The version of the format*/
+            uint64_t mRowCount;             /**< @brief The number of rows of the PVS*/
+            uint64_t mColumnCount;          /**< @brief The number of columns of the PVS*/
+            uint64_t mCellHash;             /**< @brief The hash of the vertices of the cells*/
+            uint64_t mSceneHash;            /**< @brief The hash of the face count and bounding box of each occluder*/
+        };
+
+        static constexpr uint32_t VERSION = 2;
+
+        /** @brief Return the checksum of a record (FNV-1a)*/
+        static uint32_t getChecksum(uint64_t aRow, const std::vector<uint32_t>& aVisibleColumns);
+
+        /** @brief Add bytes to a 64 bits FNV-1a hash*/
+        static void addToHash(uint64_t& aHash, const void* aData, size_t aSize);
+
+        /** @brief Return the hash of the vertices of the cells (FNV-1a)*/
+        static uint64_t getCellHash(const std::vector<std::vector<float>>& aCells);
+
+        /** @brief Return the hash of the face count and bounding box of each occluder of the scene (FNV-1a)*/
+        uint64_t getSceneHash() const;
+
+        /** @brief Write the header of a new journal*/
+        bool writeJournalHeader(std::ofstream& aJournal, const std::vector<std::vector<float>>& aCells) const;
+
+        /** @brief Append a record to a journal*/
+        static bool writeJournalRecord(std::ofstream& aJournal, size_t aRow, const std::vector<uint32_t>& aVisibleColumns);
+
+        /** @brief Write the PVS file from the completed rows*/
+        bool writePvs(const std::string& aPvsFileName) const;
+
+        /** @brief Record the shaft of an entry, or forget it if the occluder has been removed*/
+        void updateShaft(size_t aRow, const std::vector<MathVector3d>& aSource, size_t aColumn);
+
+        /** @brief Read the valid records of a journal, and return the size of the valid part of the file (0 if the journal does not match the bake)*/
+        uint64_t readJournal(const std::string& aJournalFileName, const std::vector<std::vector<float>>& aCells, std::vector<std::vector<uint32_t>>& aRows, std::vector<bool>& isCompleted);
+
+        GeometryOccluderSet* mScene;
+        VisibilityExactQueryConfiguration mConfiguration;
+        size_t mFlushInterval;
+        size_t mRowBudget;
+        size_t mResumedRowCount;
+        size_t mComputedRowCount;
+        size_t mUpdatedEntryCount;
+        std::vector<std::vector<uint32_t>> mRows;   /**< @brief The visible columns of each row, once the bake is completed*/
+        HelperPvsShaftIndex mShaftIndex;            /**< @brief The shaft of each entry, once the bake is completed*/
+    };
+
+    inline HelperPvsBake::HelperPvsBake(GeometryOccluderSet* aScene, const VisibilityExactQueryConfiguration& aConfiguration)
+        : mScene(aScene),
+        mConfiguration(aConfiguration),
+        mFlushInterval(1),
+        mRowBudget(std::numeric_limits<size_t>::max()),
+        mResumedRowCount(0),
+        mComputedRowCount(0),
+        mUpdatedEntryCount(0)
+    {
+    }
+
+    inline uint32_t HelperPvsBake::getChecksum(uint64_t aRow, const std::vector<uint32_t>& aVisibleColumns)
+    {
+        uint32_t myHash = 2166136261u;
+        auto add = [&myHash](const void* aData, size_t aSize)
+        {
+            const unsigned char* myBytes = reinterpret_cast<const unsigned char*>(aData);
+            for (size_t i = 0; i < aSize; i++)
+            {
+                myHash = (myHash ^ myBytes[i]) * 16777619u;
+            }
+        };
+        uint32_t myCount = (uint32_t)aVisibleColumns.size();
+        add(&aRow, sizeof(uint64_t));
+        add(&myCount, sizeof(uint32_t));
+        add(aVisibleColumns.data(), aVisibleColumns.size() * sizeof(uint32_t));
+        return myHash;
+    }
+
+    inline void HelperPvsBake::addToHash(uint64_t& aHash, const void* aData, size_t aSize)
+    {
+        const unsigned char* myBytes = reinterpret_cast<const unsigned char*>(aData);
+        for (size_t i = 0; i < aSize; i++)
+        {
+            aHash = (aHash ^ myBytes[i]) * 1099511628211ull;
+        }
+    }
+
+    inline uint64_t HelperPvsBake::getCellHash(const std::vector<std::vector<float>>& aCells)
+    {
+        uint64_t myHash = 14695981039346656037ull;
+        for (const std::vector<float>& myCell : aCells)
+        {
+            uint64_t myCount = myCell.size();
+            addToHash(myHash, &myCount, sizeof(uint64_t));
+            addToHash(myHash, myCell.data(), myCell.size() * sizeof(float));
+        }
+        return myHash;
+    }
+
+    inline uint64_t HelperPvsBake::getSceneHash() const
+    {
+        uint64_t myHash = 14695981039346656037ull;
+        for (size_t i = 0; i < mScene->getOccluderCount(); i++)
+        {
+            // A removed occluder is hashed as an occluder without faces
+            uint64_t myFaceCount = mScene->hasOccluder(i) ? mScene->getOccluder(i)->faceCount : 0;
+            addToHash(myHash, &myFaceCount, sizeof(uint64_t));
+            if (myFaceCount > 0)
+            {
+                const GeometryAABB& myBox = mScene->getOccluderBoundingBox(i);
+                float myBounds[6] = { myBox.getMin().x, myBox.getMin().y, myBox.getMin().z, myBox.getMax().x, myBox.getMax().y, myBox.getMax().z };
+                addToHash(myHash, myBounds, sizeof(myBounds));
+            }
+        }
+        return myHash;
+    }
+
+    inline uint64_t HelperPvsBake::readJournal(const std::string& aJournalFileName, const std::vector<std::vector<float>>& aCells, std::vector<std::vector<uint32_t>>& aRows, std::vector<bool>& isCompleted)
+    {
+        std::ifstream myInput(aJournalFileName.c_str(), std::ios::binary);
+        if (!myInput.good())
+            return 0;
+
+        size_t myRowCount = aCells.size();
+        JournalHeader myHeader;
+        if (!myInput.read(reinterpret_cast<char*>(&myHeader), sizeof(JournalHeader))
+            || memcmp(myHeader.mMagic, "VSLJ", 4) != 0 || myHeader.mVersion != VERSION
+            || myHeader.mRowCount != myRowCount || myHeader.mColumnCount != mScene->getOccluderCount()
+            || myHeader.mCellHash != getCellHash(aCells) || myHeader.mSceneHash != getSceneHash())
+            return 0;
+
+        uint64_t myValidSize = sizeof(JournalHeader);
+        std::vector<uint32_t> myVisibleColumns;
+        while (true)
+        {
+            uint64_t myRow = 0;
+            uint32_t myCount = 0;
+            uint32_t myChecksum = 0;
+            if (!myInput.read(reinterpret_cast<char*>(&myRow), sizeof(uint64_t)) || !myInput.read(reinterpret_cast<char*>(&myCount), sizeof(uint32_t))
+                || myRow >= myRowCount || myCount > myHeader.mColumnCount)
+                break;
+
+            myVisibleColumns.resize(myCount);
+            if (!myInput.read(reinterpret_cast<char*>(myVisibleColumns.data()), myCount * sizeof(uint32_t))
+                || !myInput.read(reinterpret_cast<char*>(&myChecksum), sizeof(uint32_t))
+                || myChecksum != getChecksum(myRow, myVisibleColumns))
+                break;
+
+            aRows[myRow] = myVisibleColumns;
+            isCompleted[myRow] = true;
+            myValidSize += sizeof(uint64_t) + sizeof(uint32_t) * (2 + myCount);
+        }
+        return myValidSize;
+    }
+
+    inline bool HelperPvsBake::writeJournalHeader(std::ofstream& aJournal, const std::vector<std::vector<float>>& aCells) const
+    {
+        JournalHeader myHeader;
+        memset(&myHeader, 0, sizeof(JournalHeader));
+        memcpy(myHeader.mMagic, "VSLJ", 4);
+        myHeader.mVersion = VERSION;
+        myHeader.mRowCount = aCells.size();
+        myHeader.mColumnCount = mScene->getOccluderCount();
+        myHeader.mCellHash = getCellHash(aCells);
+        myHeader.mSceneHash = getSceneHash();
+        aJournal.write(reinterpret_cast<const char*>(&myHeader), sizeof(JournalHeader));
+        return aJournal.good();
+    }
+
+    inline bool HelperPvsBake::writeJournalRecord(std::ofstream& aJournal, size_t aRow, const std::vector<uint32_t>& aVisibleColumns)
+    {
+        uint64_t myRow = aRow;
+        uint32_t myCount = (uint32_t)aVisibleColumns.size();
+        uint32_t myChecksum = getChecksum(myRow, aVisibleColumns);
+        aJournal.write(reinterpret_cast<const char*>(&myRow), sizeof(uint64_t));
+        aJournal.write(reinterpret_cast<const char*>(&myCount), sizeof(uint32_t));
+        aJournal.write(reinterpret_cast<const char*>(aVisibleColumns.data()), myCount * sizeof(uint32_t));
+        aJournal.write(reinterpret_cast<const char*>(&myChecksum), sizeof(uint32_t));
+        return aJournal.good();
+    }
+
+    inline bool HelperPvsBake::writePvs(const std::string& aPvsFileName) const
+    {
+        HelperPvsWriter myWriter;
+        if (!myWriter.open(aPvsFileName, mRows.size(), mScene->getOccluderCount()))
+            return false;
+        for (size_t i = 0; i < mRows.size(); i++)
+        {
+            myWriter.writeRow(i, mRows[i]);
+        }
+        return myWriter.close();
+    }
+
+    inline void HelperPvsBake::updateShaft(size_t aRow, const std::vector<MathVector3d>& aSource, size_t aColumn)
+    {
+        if (mScene->hasOccluder(aColumn))
+        {
+            mShaftIndex.setShaft(aRow, aColumn, aSource, mScene->getOccluderBoundingBox(aColumn));
+        }
+        else
+        {
+            mShaftIndex.removeShaft(aRow, aColumn);
+        }
+    }
+
+    inline bool HelperPvsBake::run(const std::vector<std::vector<float>>& aCells, const std::string& aJournalFileName, const std::string& aPvsFileName)
+    {
+        size_t myRowCount = aCells.size();
+        std::vector<std::vector<uint32_t>> myRows(myRowCount);
+        std::vector<bool> isCompleted(myRowCount, false);
+
+        mComputedRowCount = 0;
+        mRows.clear();
+        mShaftIndex.clear();
+        uint64_t myValidSize = readJournal(aJournalFileName, aCells, myRows, isCompleted);
+        mResumedRowCount = std::count(isCompleted.begin(), isCompleted.end(), true);
+
+        // The journal is truncated after its last valid record, or restarted if it does not belong to this bake
+        std::error_code myError;
+        if (myValidSize > 0)
+        {
+            std::filesystem::resize_file(aJournalFileName, myValidSize, myError);
+        }
+        if (myValidSize == 0 || myError)
+        {
+            std::ofstream myOutput(aJournalFileName.c_str(), std::ios::binary | std::ios::trunc);
+            if (!writeJournalHeader(myOutput, aCells))
+                return false;
+
+            std::fill(isCompleted.begin(), isCompleted.end(), false);
+            mResumedRowCount = 0;
+        }
+
+        std::ofstream myJournal(aJournalFileName.c_str(), std::ios::binary | std::ios::app);
+        if (!myJournal.good())
+            return false;
+
+        std::vector<VisibilityResult> myResults;
+        for (size_t i = 0; i < myRowCount; i++)
+        {
+            if (isCompleted[i])
+                continue;
+
+            if (mComputedRowCount == mRowBudget)
+            {
+                myJournal.flush();
+                return false;
+            }
+
+            // The cells that are not proven hidden are visible, so that the PVS remains conservative
+            areOccludersVisible(mScene, aCells[i].data(), aCells[i].size() / 3, myResults, mConfiguration);
+            std::vector<uint32_t>& myVisibleColumns = myRows[i];
+            myVisibleColumns.clear();
+            for (size_t j = 0; j < myResults.size(); j++)
+            {
+                if (myResults[j] != HIDDEN)
+                {
+                    myVisibleColumns.push_back((uint32_t)j);
+                }
+            }
+
+            if (!writeJournalRecord(myJournal, i, myVisibleColumns))
+                return false;
+
+            isCompleted[i] = true;
+            mComputedRowCount++;
+            if (mComputedRowCount % mFlushInterval == 0)
+            {
+                myJournal.flush();
+            }
+        }
+        myJournal.close();
+
+        mRows.swap(myRows);
+        for (size_t i = 0; i < myRowCount; i++)
+        {
+            std::vector<MathVector3d> mySource = GeometryConvexPolygon(aCells[i].data(), aCells[i].size() / 3).getVertices();
+            for (size_t j = 0; j < mScene->getOccluderCount(); j++)
+            {
+                updateShaft(i, mySource, j);
+            }
+        }
+        return writePvs(aPvsFileName);
+    }
+
+    inline bool HelperPvsBake::update(const std::vector<std::vector<float>>& aCells, const std::vector<GeometryOccluderChange>& aChanges,
+        const std::string& aJournalFileName, const std::string& aPvsFileName)
+    {
+        mUpdatedEntryCount = 0;
+        if (mRows.empty() || aCells.size() != mRows.size())
+            return false;
+
+        std::vector<std::pair<size_t, size_t>> myEntries;
+        mShaftIndex.getAffectedEntries(aChanges, myEntries);
+
+        size_t myBegin = 0;
+        while (myBegin < myEntries.size())
+        {
+            size_t myRow = myEntries[myBegin].first;
+            size_t myEnd = myBegin;
+            while (myEnd < myEntries.size() && myEntries[myEnd].first == myRow)
+            {
+                myEnd++;
+            }
+
+            // The entries of a row are sorted by column, as the visible columns: both are merged in a single pass
+            const std::vector<float>& myCell = aCells[myRow];
+            std::vector<uint32_t>& myVisibleColumns = mRows[myRow];
+            std::vector<uint32_t> myUpdatedColumns;
+            size_t k = 0;
+            for (size_t i = myBegin; i < myEnd; i++)
+            {
+                uint32_t myColumn = (uint32_t)myEntries[i].second;
+                while (k < myVisibleColumns.size() && myVisibleColumns[k] < myColumn)
+                {
+                    myUpdatedColumns.push_back(myVisibleColumns[k++]);
+                }
+                if (k < myVisibleColumns.size() && myVisibleColumns[k] == myColumn)
+                {
+                    k++;
+                }
+
+                if (mScene->hasOccluder(myColumn)
+                    && isBoxVisible(mScene, myCell.data(), myCell.size() / 3, mScene->getOccluderBoundingBox(myColumn), mConfiguration) != HIDDEN)
+                {
+                    myUpdatedColumns.push_back(myColumn);
+                }
+                mUpdatedEntryCount++;
+            }
+            myUpdatedColumns.insert(myUpdatedColumns.end(), myVisibleColumns.begin() + k, myVisibleColumns.end());
+            myVisibleColumns.swap(myUpdatedColumns);
+
+            myBegin = myEnd;
+        }
+
+        // Only the shafts of the changed occluders depend on the changes
+        for (size_t i = 0; i < aCells.size(); i++)
+        {
+            std::vector<MathVector3d> mySource = GeometryConvexPolygon(aCells[i].data(), aCells[i].size() / 3).getVertices();
+            for (const GeometryOccluderChange& myChange : aChanges)
+            {
+                updateShaft(i, mySource, myChange.mGeometryId);
+            }
+        }
+
+        // The journal is rewritten, such that a later run resumes the updated rows
+        std::ofstream myJournal(aJournalFileName.c_str(), std::ios::binary | std::ios::trunc);
+        if (!writeJournalHeader(myJournal, aCells))
+            return false;
+        for (size_t i = 0; i < mRows.size(); i++)
+        {
+            if (!writeJournalRecord(myJournal, i, mRows[i]))
+                return false;
+        }
+        myJournal.close();
+
+        return writePvs(aPvsFileName);
+    }
+}
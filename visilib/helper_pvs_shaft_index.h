@@ -0,0 +1,291 @@
+/*
+Visilib, an open source library for exact visibility computation.
+Copyright(C) 2021 by Denis Haumont
+
+This file is part of Visilib.
+
+Visilib is free software : you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Visilib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Visilib. If not, see <http://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include "geometry_aabbox.h"
+#include "math_geometry.h"
+#include "geometry_convex_hull.h"
+#include "geometry_occluder_set.h"
+
+namespace visilib
+{
+    /** @brief An invalidation index of the entries of a PVS
+
+    The index records, for each computed entry (row, column), the shaft containing all the line segments joining the source polygon of the row to
+    the bounding box of the column. The result of an entry can only change if an occluder enters or leaves its shaft: when occluders change,
+    only the entries whose shaft overlaps the bounding box of a changed occluder, before or after the change, have to be computed again.
+
+    The shaft is the union of the box and of the convex hulls (GeometryConvexHullBuilder) of the source polygon with each face of the box facing
+    the source. When the convex shafts are disabled, only the bounding box of the shaft is recorded, which is more conservative but smaller.
+    */
+
+    class HelperPvsShaftIndex
+    {
+    public:
+        HelperPvsShaftIndex();
+
+        /** @brief Record the convex shafts in addition to their bounding boxes (default true)*/
+        void setConvexShafts(bool isEnabled)
+        {
+            mConvexShafts = isEnabled;
+        }
+
+        void clear()
+        {
+            mShafts.clear();
+        }
+
+        /** @brief Record the shaft of an entry, replacing the shaft previously recorded for that entry
+
+        @param aRow: the row of the entry
+        @param aColumn: the column of the entry
+        @param aSource: the vertices of the source polygon of the row
+        @param aTarget: the bounding box of the column
+        */
+        void setShaft(size_t aRow, size_t aColumn, const std::vector<MathVector3d>& aSource, const GeometryAABB& aTarget);
+
+        /** @brief Forget the shaft of an entry*/
+        void removeShaft(size_t aRow, size_t aColumn);
+
+        /** @brief Return true if a shaft is recorded for the entry*/
+        bool hasShaft(size_t aRow, size_t aColumn) const
+        {
+            return aRow < mShafts.size() && aColumn < mShafts[aRow].size() && mShafts[aRow][aColumn].mIsValid;
+        }
+
+        /** @brief Return true if the shaft of an entry overlaps a box (touching is considered as overlapping)*/
+        bool isOverlapping(size_t aRow, size_t aColumn, const GeometryAABB& aBox) const;
+
+        /** @brief Return the entries that may be affected by changes of the occluders
+
+        An entry is affected if its shaft overlaps the bounding box of a changed occluder, or if its column is a changed occluder without any recorded shaft.
+        @param aChanges: the changes of the occluders (GeometryOccluderSet::getChanges())
+        @param anEntries: the affected entries, as pairs (row, column), sorted by row then by column
+        */
+        void getAffectedEntries(const std::vector<GeometryOccluderChange>& aChanges, std::vector<std::pair<size_t, size_t>>& anEntries) const;
+
+    private:
+        struct Shaft
+        {
+            GeometryAABB mBox;                              /**< @brief The bounding box of the shaft*/
+            GeometryAABB mTarget;                           /**< @brief The bounding box of the column*/
+            std::vector<GeometryAABB> mHullBoxes;           /**< @brief The bounding box of each convex hull*/
+            std::vector<std::vector<MathPlane3d>> mHulls;   /**< @brief The planes of the convex hull of the source with each face of the target facing the source*/
+            bool mIsValid = false;
+        };
+
+        /** @brief Return true if a box lies entirely on the negative side of one of the planes*/
+        static bool isSeparated(const std::vector<MathPlane3d>& aPlanes, const GeometryAABB& aBox);
+
+        std::vector<std::vector<Shaft>> mShafts;            /**< @brief The shaft of each entry, indexed by row then by column*/
+        bool mConvexShafts;
+    };
+
+    inline HelperPvsShaftIndex::HelperPvsShaftIndex()
+        : mConvexShafts(true)
+    {
+    }
+
+    inline void HelperPvsShaftIndex::setShaft(size_t aRow, size_t aColumn, const std::vector<MathVector3d>& aSource, const GeometryAABB& aTarget)
+    {
+        if (aRow >= mShafts.size())
+        {
+            mShafts.resize(aRow + 1);
+        }
+        if (aColumn >= mShafts[aRow].size())
+        {
+            mShafts[aRow].resize(aColumn + 1);
+        }
+
+        Shaft& myShaft = mShafts[aRow][aColumn];
+        myShaft.mHullBoxes.clear();
+        myShaft.mHulls.clear();
+        myShaft.mTarget = aTarget;
+        myShaft.mIsValid = true;
+
+        MathVector3d mySourceMin, mySourceMax;
+        MathArithmetic<double>::getMinMax(aSource, mySourceMin, mySourceMax);
+        GeometryAABB mySourceBox(convert<MathVector3f>(mySourceMin), convert<MathVector3f>(mySourceMax));
+        myShaft.mBox = mySourceBox;
+        myShaft.mBox.add(aTarget);
+
+        if (!mConvexShafts)
+        {
+            return;
+        }
+
+        MathVector3d myMin = convert<MathVector3d>(aTarget.getMin());
+        MathVector3d myMax = convert<MathVector3d>(aTarget.getMax());
+        double myTolerance = 1e-6 * sqrt((myShaft.mBox.getMax() - myShaft.mBox.getMin()).getSquaredNorm());
+
+        for (int myAxis = 0; myAxis < 3; myAxis++)
+        {
+            int u = (myAxis + 1) % 3;
+            int w = (myAxis + 2) % 3;
+
+            for (int mySide = 0; mySide < 2; mySide++)
+            {
+                // As in isBoxVisible(), the segments reaching the inside of the box cross one of the faces facing the source
+                double mySign = mySide == 0 ? -1.0 : 1.0;
+                double myBound = mySide == 0 ? myMin[myAxis] : myMax[myAxis];
+
+                bool isFrontFacing = false;
+                for (size_t i = 0; i < aSource.size() && !isFrontFacing; i++)
+                {
+                    isFrontFacing = mySign * (aSource[i][myAxis] - myBound) > 0;
+                }
+                if (!isFrontFacing)
+                {
+                    continue;
+                }
+
+                std::vector<MathVector3d> myFace(4);
+                for (size_t i = 0; i < 4; i++)
+                {
+                    double myVertex[3];
+                    myVertex[myAxis] = myBound;
+                    myVertex[u] = (i == 1 || i == 2) ? myMax[u] : myMin[u];
+                    myVertex[w] = (i == 2 || i == 3) ? myMax[w] : myMin[w];
+                    myFace[i] = MathVector3d(myVertex[0], myVertex[1], myVertex[2]);
+                }
+
+                GeometryAABB myHullBox(mySourceBox);
+                myHullBox.add(GeometryAABB(convert<MathVector3f>(myFace[0]), convert<MathVector3f>(myFace[2])));
+
+                // Only the planes supporting both polygons bound the hull: the others are discarded, which keeps the shaft conservative
+                std::vector<MathPlane3d> myPlanes;
+                GeometryConvexHull* myHull = GeometryConvexHullBuilder::build(aSource, myFace);
+                if (myHull != nullptr)
+                {
+                    for (const MathPlane3d& myPlane : myHull->getFaces())
+                    {
+                        bool isSupporting = true;
+                        for (size_t i = 0; i < aSource.size() && isSupporting; i++)
+                        {
+                            isSupporting = myPlane.dot(aSource[i]) >= -myTolerance;
+                        }
+                        for (size_t i = 0; i < myFace.size() && isSupporting; i++)
+                        {
+                            isSupporting = myPlane.dot(myFace[i]) >= -myTolerance;
+                        }
+                        if (isSupporting)
+                        {
+                            myPlanes.push_back(myPlane);
+                        }
+                    }
+                    delete myHull;
+                }
+
+                myShaft.mHullBoxes.push_back(myHullBox);
+                myShaft.mHulls.push_back(myPlanes);
+            }
+        }
+    }
+
+    inline void HelperPvsShaftIndex::removeShaft(size_t aRow, size_t aColumn)
+    {
+        if (hasShaft(aRow, aColumn))
+        {
+            mShafts[aRow][aColumn] = Shaft();
+        }
+    }
+
+    inline bool HelperPvsShaftIndex::isSeparated(const std::vector<MathPlane3d>& aPlanes, const GeometryAABB& aBox)
+    {
+        for (const MathPlane3d& myPlane : aPlanes)
+        {
+            // The corner of the box the furthest along the normal of the plane
+            MathVector3d myCorner(myPlane.mNormal.x > 0 ? aBox.getMax().x : aBox.getMin().x,
+                                  myPlane.mNormal.y > 0 ? aBox.getMax().y : aBox.getMin().y,
+                                  myPlane.mNormal.z > 0 ? aBox.getMax().z : aBox.getMin().z);
+            if (myPlane.dot(myCorner) < 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    inline bool HelperPvsShaftIndex::isOverlapping(size_t aRow, size_t aColumn, const GeometryAABB& aBox) const
+    {
+        if (!hasShaft(aRow, aColumn))
+        {
+            return false;
+        }
+
+        const Shaft& myShaft = mShafts[aRow][aColumn];
+        if (!myShaft.mBox.intersects(aBox))
+        {
+            return false;
+        }
+        if (!mConvexShafts || myShaft.mTarget.intersects(aBox))
+        {
+            return true;
+        }
+
+        for (size_t i = 0; i < myShaft.mHulls.size(); i++)
+        {
+            if (myShaft.mHullBoxes[i].intersects(aBox) && !isSeparated(myShaft.mHulls[i], aBox))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    inline void HelperPvsShaftIndex::getAffectedEntries(const std::vector<GeometryOccluderChange>& aChanges, std::vector<std::pair<size_t, size_t>>& anEntries) const
+    {
+        anEntries.clear();
+
+        for (size_t myRow = 0; myRow < mShafts.size(); myRow++)
+        {
+            size_t myColumnCount = mShafts[myRow].size();
+            for (const GeometryOccluderChange& myChange : aChanges)
+            {
+                myColumnCount = std::max(myColumnCount, myChange.mGeometryId + 1);
+            }
+
+            for (size_t myColumn = 0; myColumn < myColumnCount; myColumn++)
+            {
+                bool isAffected = false;
+                for (size_t i = 0; i < aChanges.size() && !isAffected; i++)
+                {
+                    const GeometryOccluderChange& myChange = aChanges[i];
+                    if (!hasShaft(myRow, myColumn))
+                    {
+                        isAffected = myChange.mGeometryId == myColumn;
+                    }
+                    else
+                    {
+                        isAffected = isOverlapping(myRow, myColumn, myChange.mOldBox) || isOverlapping(myRow, myColumn, myChange.mNewBox);
+                    }
+                }
+                if (isAffected)
+                {
+                    anEntries.push_back(std::make_pair(myRow, myColumn));
+                }
+            }
+        }
+    }
+}
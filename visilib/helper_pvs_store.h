@@ -0,0 +1,436 @@
+/*
+Visilib, an open source library for exact visibility computation.
+Copyright(C) 2021 by Denis Haumont
+
+This file is part of Visilib.
+
+Visilib is free software : you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Visilib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Visilib. If not, see <http://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "visilib.h"
+#include "helper_mapped_file.h"
+
+namespace visilib
+{
+    /** @brief Layout of a PVS (potentially visible set) file, storing a bit matrix: the bit (row, column) is set if the cell "column" is visible from the cell "row".
+
+    Each row is compressed independently, with the smallest of the following encodings:
+    - EMPTY: no visible cell
+    - ARRAY: the sorted list of the visible cells (sparse rows)
+    - RUNS: the sorted list of the runs [begin, end[ of visible cells (rows made of large visible regions)
+    - BITMAP: the raw bits of the row (dense rows)
+
+    Layout of the file, in the byte order of the machine that wrote it:
+    - Header
+    - the encoded rows, each one aligned on 8 bytes, in the order in which they have been written
+    - the RowEntry table at mIndexOffset, one entry per row, giving the encoding and the location of each row
+    */
+
+    struct HelperPvsFormat
+    {
+        /** @brief The version of the format, incremented at each incompatible change*/
+        static constexpr uint32_t VERSION = 1;
+        static constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+        enum RowEncoding
+        {
+            EMPTY = 0,
+            ARRAY = 1,
+            RUNS = 2,
+            BITMAP = 3
+        };
+
+        struct Header
+        {
+            char mMagic[4];                 /**< @brief The identifier of the format: "VSLP"*/
+            uint32_t mVersion;              /**< @brief The version of the format*/
+            uint32_t mByteOrder;            /**< @brief The value BYTE_ORDER_MARK written in the byte order of the machine that wrote the file*/
+            uint32_t mReserved;
+            uint64_t mRowCount;             /**< @brief The number of rows of the matrix*/
+            uint64_t mColumnCount;          /**< @brief The number of columns of the matrix*/
+            uint64_t mIndexOffset;          /**< @brief The offset of the RowEntry table, 0 if the file has not been closed properly*/
+        };
+
+        struct RowEntry
+        {
+            uint64_t mOffset;               /**< @brief The offset of the encoded row in the file*/
+            uint32_t mEncoding;             /**< @brief The RowEncoding of the row*/
+            uint32_t mCount;                /**< @brief The number of elements of the encoded row: visible cells, runs or 64 bits words*/
+        };
+    };
+
+    /** @brief Streaming writer of a PVS file
+
+    The rows are appended to the file as soon as they are written, in any order, so that the rows computed by concurrent queries
+    can be stored as they complete. Only the table of the row locations is kept in memory, and written when the file is closed.
+    */
+
+    class HelperPvsWriter
+    {
+    public:
+        HelperPvsWriter();
+
+        ~HelperPvsWriter();
+
+        /** @brief Create a PVS file
+
+        @param aFileName: the name of the file
+        @param aRowCount: the number of source cells
+        @param aColumnCount: the number of target cells
+        @return: true if the file has been created
+        */
+        bool open(const std::string& aFileName, size_t aRowCount, size_t aColumnCount);
+
+        /** @brief Append a row to the file. Can be called concurrently by several threads
+
+        @param aRow: the index of the row, a row written twice is replaced
+        @param aVisibleColumns: the sorted indices of the visible cells
+        */
+        void writeRow(size_t aRow, const std::vector<uint32_t>& aVisibleColumns);
+
+        /** @brief Append a row to the file from the results of the visibility queries of the row (e.g. computed by areOccludersVisible).
+
+        The cells that are not proven HIDDEN are stored as visible, so that the PVS remains conservative.
+        */
+        void writeRow(size_t aRow, const std::vector<VisibilityResult>& aResults);
+
+        /** @brief Write the row table and close the file
+
+        @return: true if the file has been written completely
+        */
+        bool close();
+
+    private:
+        std::ofstream mOutput;                                  /**< @brief The stream of the file*/
+        uint64_t mOffset;                                       /**< @brief The current size of the file*/
+        uint64_t mColumnCount;                                  /**< @brief The number of columns of the matrix*/
+        std::vector<HelperPvsFormat::RowEntry> mRows;           /**< @brief The location of each row written*/
+        std::vector<uint32_t> mBuffer;                          /**< @brief A buffer used to encode the rows*/
+        std::mutex mMutex;                                      /**< @brief Serializes the writes to the file*/
+    };
+
+    /** @brief Reader of a PVS file mapped in memory
+
+    The rows are decoded on demand: testing the visibility of a pair of cells reads only the row of the source cell,
+    in constant time for the BITMAP rows and in logarithmic time of the size of the row for the ARRAY and RUNS rows.
+    */
+
+    class HelperPvsReader
+    {
+    public:
+        HelperPvsReader();
+
+        /** @brief Map a PVS file in memory and check its header
+
+        @return: true if the file is a valid and complete PVS file of the current version
+        */
+        bool open(const std::string& aFileName);
+
+        size_t getRowCount() const
+        {
+            return mHeader == nullptr ? 0 : (size_t)mHeader->mRowCount;
+        }
+
+        size_t getColumnCount() const
+        {
+            return mHeader == nullptr ? 0 : (size_t)mHeader->mColumnCount;
+        }
+
+        /** @brief Return true if the cell aColumn is potentially visible from the cell aRow*/
+        bool isVisible(size_t aRow, size_t aColumn) const;
+
+        /** @brief Return the sorted indices of the cells potentially visible from the cell aRow*/
+        void getVisibleColumns(size_t aRow, std::vector<uint32_t>& aVisibleColumns) const;
+
+        /** @brief Return the encoding of a row*/
+        HelperPvsFormat::RowEncoding getRowEncoding(size_t aRow) const
+        {
+            return (HelperPvsFormat::RowEncoding)mRows[aRow].mEncoding;
+        }
+
+    private:
+        const uint32_t* getWords(size_t aRow) const
+        {
+            return reinterpret_cast<const uint32_t*>(mFile.getData() + mRows[aRow].mOffset);
+        }
+
+        HelperMappedFile mFile;                                 /**< @brief The mapping of the file*/
+        const HelperPvsFormat::Header* mHeader;                 /**< @brief The header of the file, nullptr if no valid file is opened*/
+        const HelperPvsFormat::RowEntry* mRows;                 /**< @brief The row table of the file*/
+    };
+
+    inline HelperPvsWriter::HelperPvsWriter()
+        : mOffset(0),
+        mColumnCount(0)
+    {
+    }
+
+    inline HelperPvsWriter::~HelperPvsWriter()
+    {
+        close();
+    }
+
+    inline bool HelperPvsWriter::open(const std::string& aFileName, size_t aRowCount, size_t aColumnCount)
+    {
+        close();
+
+        mOutput.open(aFileName.c_str(), std::ios::binary | std::ios::trunc);
+        if (!mOutput.good())
+            return false;
+
+        HelperPvsFormat::RowEntry myEmptyRow = { 0, HelperPvsFormat::EMPTY, 0 };
+        mRows.assign(aRowCount, myEmptyRow);
+        mColumnCount = aColumnCount;
+
+        // The index offset is written when the file is closed
+        HelperPvsFormat::Header myHeader;
+        memset(&myHeader, 0, sizeof(HelperPvsFormat::Header));
+        memcpy(myHeader.mMagic, "VSLP", 4);
+        myHeader.mVersion = HelperPvsFormat::VERSION;
+        myHeader.mByteOrder = HelperPvsFormat::BYTE_ORDER_MARK;
+        myHeader.mRowCount = aRowCount;
+        myHeader.mColumnCount = aColumnCount;
+
+        mOutput.write(reinterpret_cast<const char*>(&myHeader), sizeof(HelperPvsFormat::Header));
+        mOffset = sizeof(HelperPvsFormat::Header);
+        return mOutput.good();
+    }
+
+    inline void HelperPvsWriter::writeRow(size_t aRow, const std::vector<VisibilityResult>& aResults)
+    {
+        std::vector<uint32_t> myVisibleColumns;
+        for (size_t i = 0; i < aResults.size(); i++)
+        {
+            if (aResults[i] != HIDDEN)
+            {
+                myVisibleColumns.push_back((uint32_t)i);
+            }
+        }
+        writeRow(aRow, myVisibleColumns);
+    }
+
+    inline void HelperPvsWriter::writeRow(size_t aRow, const std::vector<uint32_t>& aVisibleColumns)
+    {
+        std::lock_guard<std::mutex> myLock(mMutex);
+
+        V_ASSERT(mOutput.is_open());
+        V_ASSERT(aRow < mRows.size());
+        V_ASSERT(std::is_sorted(aVisibleColumns.begin(), aVisibleColumns.end()));
+
+        HelperPvsFormat::RowEntry& myRow = mRows[aRow];
+        if (aVisibleColumns.empty())
+        {
+            myRow.mEncoding = HelperPvsFormat::EMPTY;
+            myRow.mCount = 0;
+            myRow.mOffset = 0;
+            return;
+        }
+
+        size_t myRunCount = 1;
+        for (size_t i = 1; i < aVisibleColumns.size(); i++)
+        {
+            if (aVisibleColumns[i] != aVisibleColumns[i - 1] + 1)
+            {
+                myRunCount++;
+            }
+        }
+
+        // Choose the smallest encoding, the sizes being expressed in 32 bits words
+        size_t myWordCount = (size_t)(mColumnCount + 63) / 64;
+        size_t myArraySize = aVisibleColumns.size();
+        size_t myRunsSize = myRunCount * 2;
+        size_t myBitmapSize = myWordCount * 2;
+
+        mBuffer.clear();
+        if (myArraySize <= myRunsSize && myArraySize <= myBitmapSize)
+        {
+            myRow.mEncoding = HelperPvsFormat::ARRAY;
+            myRow.mCount = (uint32_t)aVisibleColumns.size();
+            mBuffer = aVisibleColumns;
+        }
+        else if (myRunsSize <= myBitmapSize)
+        {
+            myRow.mEncoding = HelperPvsFormat::RUNS;
+            myRow.mCount = (uint32_t)myRunCount;
+            mBuffer.push_back(aVisibleColumns[0]);
+            for (size_t i = 1; i < aVisibleColumns.size(); i++)
+            {
+                if (aVisibleColumns[i] != aVisibleColumns[i - 1] + 1)
+                {
+                    mBuffer.push_back(aVisibleColumns[i - 1] + 1);
+                    mBuffer.push_back(aVisibleColumns[i]);
+                }
+            }
+            mBuffer.push_back(aVisibleColumns.back() + 1);
+        }
+        else
+        {
+            myRow.mEncoding = HelperPvsFormat::BITMAP;
+            myRow.mCount = (uint32_t)myWordCount;
+            std::vector<uint64_t> myBits(myWordCount, 0);
+            for (uint32_t myColumn : aVisibleColumns)
+            {
+                myBits[myColumn / 64] |= uint64_t(1) << (myColumn % 64);
+            }
+            mBuffer.resize(myWordCount * 2);
+            memcpy(mBuffer.data(), myBits.data(), myWordCount * sizeof(uint64_t));
+        }
+
+        // The rows are aligned on 8 bytes, such that the bitmaps can be read in place
+        if (mBuffer.size() % 2 != 0)
+        {
+            mBuffer.push_back(0);
+        }
+        myRow.mOffset = mOffset;
+        mOutput.write(reinterpret_cast<const char*>(mBuffer.data()), mBuffer.size() * sizeof(uint32_t));
+        mOffset += mBuffer.size() * sizeof(uint32_t);
+    }
+
+    inline bool HelperPvsWriter::close()
+    {
+        std::lock_guard<std::mutex> myLock(mMutex);
+
+        if (!mOutput.is_open())
+            return false;
+
+        uint64_t myIndexOffset = mOffset;
+        mOutput.write(reinterpret_cast<const char*>(mRows.data()), mRows.size() * sizeof(HelperPvsFormat::RowEntry));
+        mOutput.seekp(offsetof(HelperPvsFormat::Header, mIndexOffset));
+        mOutput.write(reinterpret_cast<const char*>(&myIndexOffset), sizeof(uint64_t));
+
+        bool isValid = mOutput.good();
+        mOutput.close();
+        mRows.clear();
+        mOffset = 0;
+        return isValid;
+    }
+
+    inline HelperPvsReader::HelperPvsReader()
+        : mHeader(nullptr),
+        mRows(nullptr)
+    {
+    }
+
+    inline bool HelperPvsReader::open(const std::string& aFileName)
+    {
+        mHeader = nullptr;
+        mRows = nullptr;
+
+        if (!mFile.open(aFileName) || mFile.getSize() < sizeof(HelperPvsFormat::Header))
+            return false;
+
+        const HelperPvsFormat::Header* myHeader = reinterpret_cast<const HelperPvsFormat::Header*>(mFile.getData());
+        if (memcmp(myHeader->mMagic, "VSLP", 4) != 0 || myHeader->mVersion != HelperPvsFormat::VERSION || myHeader->mByteOrder != HelperPvsFormat::BYTE_ORDER_MARK)
+            return false;
+
+        // A file whose writer has not been closed has no row table
+        uint64_t myIndexOffset = myHeader->mIndexOffset;
+        if (myIndexOffset < sizeof(HelperPvsFormat::Header) || myIndexOffset % 8 != 0 || myIndexOffset > mFile.getSize()
+            || myHeader->mRowCount > (mFile.getSize() - myIndexOffset) / sizeof(HelperPvsFormat::RowEntry))
+            return false;
+
+        const HelperPvsFormat::RowEntry* myRows = reinterpret_cast<const HelperPvsFormat::RowEntry*>(mFile.getData() + myIndexOffset);
+        for (size_t i = 0; i < myHeader->mRowCount; i++)
+        {
+            const HelperPvsFormat::RowEntry& myRow = myRows[i];
+            uint64_t myWordCount = (uint64_t)myRow.mCount * (myRow.mEncoding == HelperPvsFormat::ARRAY ? 1 : 2);
+            if (myRow.mEncoding > HelperPvsFormat::BITMAP)
+                return false;
+            if (myRow.mEncoding != HelperPvsFormat::EMPTY && (myRow.mOffset % 8 != 0 || myRow.mOffset > myIndexOffset || myWordCount > (myIndexOffset - myRow.mOffset) / sizeof(uint32_t)))
+                return false;
+        }
+
+        mHeader = myHeader;
+        mRows = myRows;
+        return true;
+    }
+
+    inline bool HelperPvsReader::isVisible(size_t aRow, size_t aColumn) const
+    {
+        V_ASSERT(aRow < getRowCount() && aColumn < getColumnCount());
+
+        const HelperPvsFormat::RowEntry& myRow = mRows[aRow];
+        const uint32_t* myWords = getWords(aRow);
+        switch (myRow.mEncoding)
+        {
+        case HelperPvsFormat::ARRAY:
+            return std::binary_search(myWords, myWords + myRow.mCount, (uint32_t)aColumn);
+        case HelperPvsFormat::RUNS:
+        {
+            // The runs are stored as [begin, end[ pairs: the column is visible if it lies after an odd number of bounds
+            const uint32_t* myBound = std::upper_bound(myWords, myWords + 2 * myRow.mCount, (uint32_t)aColumn);
+            return (myBound - myWords) % 2 == 1;
+        }
+        case HelperPvsFormat::BITMAP:
+        {
+            const uint64_t* myBits = reinterpret_cast<const uint64_t*>(myWords);
+            return (myBits[aColumn / 64] >> (aColumn % 64)) & 1;
+        }
+        default:
+            return false;
+        }
+    }
+
+    inline void HelperPvsReader::getVisibleColumns(size_t aRow, std::vector<uint32_t>& aVisibleColumns) const
+    {
+        V_ASSERT(aRow < getRowCount());
+
+        aVisibleColumns.clear();
+        const HelperPvsFormat::RowEntry& myRow = mRows[aRow];
+        const uint32_t* myWords = getWords(aRow);
+        switch (myRow.mEncoding)
+        {
+        case HelperPvsFormat::ARRAY:
+            aVisibleColumns.assign(myWords, myWords + myRow.mCount);
+            break;
+        case HelperPvsFormat::RUNS:
+            for (size_t i = 0; i < myRow.mCount; i++)
+            {
+                for (uint32_t myColumn = myWords[2 * i]; myColumn < myWords[2 * i + 1]; myColumn++)
+                {
+                    aVisibleColumns.push_back(myColumn);
+                }
+            }
+            break;
+        case HelperPvsFormat::BITMAP:
+        {
+            const uint64_t* myBits = reinterpret_cast<const uint64_t*>(myWords);
+            for (size_t i = 0; i < myRow.mCount; i++)
+            {
+                for (size_t myBit = 0; myBit < 64; myBit++)
+                {
+                    if ((myBits[i] >> myBit) & 1)
+                    {
+                        aVisibleColumns.push_back((uint32_t)(i * 64 + myBit));
+                    }
+                }
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+}
@@ -20,16 +20,13 @@ along with Visilib. If not, see <http://www.gnu.org/licenses/>
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <vector>
 #include <iomanip>
 #include "visilib_core.h"
 
-#ifdef WIN32
-#include "windows.h"
-#else
-#include <time.h>
-#endif
-
 namespace visilib
 {
     enum TimerType
@@ -49,10 +46,94 @@ namespace visilib
         RAY_COUNT,
         POLYTOPE_SPLIT_COUNT,
         OCCLUDER_TRIANGLE_COUNT,
+        NO_SPLIT_NEGATIVE_COUNT,          /**< @brief Splits leaving the polytope entirely on the negative side of the hyperplane*/
+        NO_SPLIT_POSITIVE_COUNT,          /**< @brief Splits leaving the polytope entirely on the positive side of the hyperplane*/
+        EDGE_OUTSIDE_POLYTOPE_COUNT,      /**< @brief Candidate edges rejected because their lines do not cross the polytope*/
+        NO_REAL_LINE_COUNT,               /**< @brief Early outs: the polytope does not contain any real line*/
+        OCCLUDED_POLYTOPE_COUNT,          /**< @brief Early outs: the polytope is entirely occluded (isOccluded)*/
+        APERTURE_FOUND_COUNT,             /**< @brief Early outs: a sampling ray found an aperture*/
+        NO_CANDIDATE_EDGE_COUNT,          /**< @brief Leaves of the occlusion tree without any remaining candidate edge*/
+        SILHOUETTE_CACHE_HIT,             /**< @brief Silhouette found in the face to silhouette cache*/
+        SILHOUETTE_CACHE_MISS,
+        SILHOUETTE_EDGE_CACHE_HIT,        /**< @brief Potential silhouette edge test found in the cache*/
+        SILHOUETTE_EDGE_CACHE_MISS,
+        SOURCE_PLANES_CACHE_HIT,          /**< @brief Face to source planes position found in the cache*/
+        SOURCE_PLANES_CACHE_MISS,
+        DEGENERATE_PREDICATE_COUNT,       /**< @brief Vertices classified on the splitting hyperplane within the tolerance, i.e. the predicates whose sign is not certified by the arithmetic*/
         COUNTER_LAST
     };
 
-    /** @brief Container for statistic and timing information collected during visibility determination operations   */
+    /** @brief The statistics measured as a histogram with logarithmic buckets*/
+    enum HistogramType
+    {
+        TREE_DEPTH_HISTOGRAM,             /**< @brief The depth of each node of the occlusion tree*/
+        POLYTOPE_VERTEX_HISTOGRAM,        /**< @brief The number of vertices of each polytope processed*/
+        POLYTOPE_EDGE_HISTOGRAM,          /**< @brief The number of edges of each polytope processed*/
+        HISTOGRAM_LAST
+    };
+
+    /** @brief The number of buckets of a histogram: the bucket 0 counts the zero values, the bucket i > 0 counts the values in [2^(i-1), 2^i[*/
+    const size_t HISTOGRAM_BUCKET_COUNT = 32;
+
+    /** @brief The statistics measured as a maximum over the query instead of a sum*/
+    enum MaximumType
+    {
+        OCCLUSION_TREE_DEPTH,     /**< @brief The depth of the occlusion tree*/
+        POLYHEDRON_SIZE,          /**< @brief The number of Plucker points and hyperplanes stored in the polyhedron*/
+        MAXIMUM_LAST
+    };
+
+    /** @brief Return the name of a timer, as used in the exported statistics*/
+    inline const char* getStatisticName(TimerType aTimer)
+    {
+        static const char* myNames[] = { "query", "rayIntersection", "silhouetteProcessing", "polytopeSplit", "polytopeBuild", "stabbingLineExtraction", "occluderTreatment" };
+        return myNames[aTimer];
+    }
+
+    /** @brief Return the name of a counter, as used in the exported statistics*/
+    inline const char* getStatisticName(CounterType aCounter)
+    {
+        static const char* myNames[] = { "rays", "splits", "occluderTriangles", "noSplitNegative", "noSplitPositive", "edgeOutsidePolytope",
+                                         "noRealLine", "occludedPolytope", "apertureFound", "noCandidateEdge",
+                                         "silhouetteCacheHit", "silhouetteCacheMiss", "silhouetteEdgeCacheHit", "silhouetteEdgeCacheMiss",
+                                         "sourcePlanesCacheHit", "sourcePlanesCacheMiss", "degeneratePredicates" };
+        return myNames[aCounter];
+    }
+
+    /** @brief Return the name of a histogram, as used in the exported statistics*/
+    inline const char* getStatisticName(HistogramType aHistogram)
+    {
+        static const char* myNames[] = { "treeDepth", "polytopeVertices", "polytopeEdges" };
+        return myNames[aHistogram];
+    }
+
+    /** @brief Return the bucket of a histogram counting a value*/
+    inline size_t getHistogramBucket(long long aValue)
+    {
+        size_t myBucket = 0;
+        while (aValue > 0 && myBucket + 1 < HISTOGRAM_BUCKET_COUNT)
+        {
+            aValue >>= 1;
+            myBucket++;
+        }
+        return myBucket;
+    }
+
+    /** @brief Return the name of a maximum, as used in the exported statistics*/
+    inline const char* getStatisticName(MaximumType aMaximum)
+    {
+        static const char* myNames[] = { "treeDepth", "polyhedronSize" };
+        return myNames[aMaximum];
+    }
+
+    /** @brief The clock used by the timers: a monotonic wall clock, independent of the CPU time consumed by the other threads of the process*/
+    typedef std::chrono::steady_clock HelperClock;
+
+    /** @brief Container for statistic and timing information collected during visibility determination operations
+
+    A collector is owned by a single query, and is therefore only accessed by the thread executing the query: it does not require any synchronization.
+    The statistics of the queries executed by several threads are summed in a HelperStatisticAggregator.
+    */
 
     class HelperStatisticCollector
     {
@@ -61,13 +142,6 @@ namespace visilib
         HelperStatisticCollector()
         {
             clear();
-#ifdef WIN32
-            unsigned long frequency[2];
-            QueryPerformanceFrequency((LARGE_INTEGER*)frequency);
-            mTimerFrequency = (double)frequency[0];
-#else
-            mTimerFrequency = 1000000.0;
-#endif
         }
 
         ~HelperStatisticCollector()
@@ -76,9 +150,26 @@ namespace visilib
 
         void clear()
         {
-            mCounts.resize(COUNTER_LAST, 0);
-            mTimers.resize(TIMER_LAST, 0);
-            mTimerIsRunning.resize(TIMER_LAST, false);
+            for (size_t i = 0; i < COUNTER_LAST; i++)
+            {
+                mCounts[i] = 0;
+            }
+            for (size_t i = 0; i < TIMER_LAST; i++)
+            {
+                mTimers[i] = 0;
+                mTimerIsRunning[i] = false;
+            }
+            for (size_t i = 0; i < MAXIMUM_LAST; i++)
+            {
+                mMaxima[i] = 0;
+            }
+            for (size_t i = 0; i < HISTOGRAM_LAST; i++)
+            {
+                for (size_t j = 0; j < HISTOGRAM_BUCKET_COUNT; j++)
+                {
+                    mHistograms[i][j] = 0;
+                }
+            }
         }
 
         void inc(CounterType counter)
@@ -86,14 +177,65 @@ namespace visilib
             mCounts[counter]++;
         }
 
-        int get(CounterType counter) const
+        void add(CounterType counter, long long count)
+        {
+            mCounts[counter] += count;
+        }
+
+        long long get(CounterType counter) const
         {
             return mCounts[counter];
         }
 
-        void incrementTime(TimerType counter, double time)
+        void updateMax(MaximumType maximum, long long value)
         {
-            mTimers[counter] += time / mTimerFrequency;
+            mMaxima[maximum] = std::max(mMaxima[maximum], value);
+        }
+
+        long long getMax(MaximumType maximum) const
+        {
+            return mMaxima[maximum];
+        }
+
+        /** @brief Count a value in the logarithmic bucket of a histogram*/
+        void addToHistogram(HistogramType histogram, long long value)
+        {
+            mHistograms[histogram][getHistogramBucket(value)]++;
+        }
+
+        void addToHistogram(HistogramType histogram, size_t bucket, long long count)
+        {
+            mHistograms[histogram][bucket] += count;
+        }
+
+        long long getHistogram(HistogramType histogram, size_t bucket) const
+        {
+            return mHistograms[histogram][bucket];
+        }
+
+        /** @brief Return the ratio of hits of a cache, given the counters of its hits and misses*/
+        double getHitRate(CounterType hit, CounterType miss) const
+        {
+            long long myTotal = mCounts[hit] + mCounts[miss];
+            return myTotal == 0 ? 0.0 : (double)mCounts[hit] / (double)myTotal;
+        }
+
+        /** @brief Add a duration, in ticks of the HelperClock, to a timer*/
+        void incrementTime(TimerType counter, long long ticks)
+        {
+            mTimers[counter] += ticks;
+        }
+
+        /** @brief Return the time accumulated by a timer, in seconds*/
+        double getTime(TimerType timer) const
+        {
+            return toSeconds(mTimers[timer]);
+        }
+
+        /** @brief Return the time accumulated by a timer, in ticks of the HelperClock*/
+        long long getTicks(TimerType timer) const
+        {
+            return mTimers[timer];
         }
 
         void setTimerIsRunning(TimerType timer, bool isRunning)
@@ -103,17 +245,46 @@ namespace visilib
             mTimerIsRunning[timer] = isRunning;
         }
 
+        /** @brief Add the statistics of another collector to this collector*/
+        void merge(const HelperStatisticCollector& aCollector)
+        {
+            for (size_t i = 0; i < COUNTER_LAST; i++)
+            {
+                mCounts[i] += aCollector.mCounts[i];
+            }
+            for (size_t i = 0; i < TIMER_LAST; i++)
+            {
+                mTimers[i] += aCollector.mTimers[i];
+            }
+            for (size_t i = 0; i < MAXIMUM_LAST; i++)
+            {
+                updateMax((MaximumType)i, aCollector.mMaxima[i]);
+            }
+            for (size_t i = 0; i < HISTOGRAM_LAST; i++)
+            {
+                for (size_t j = 0; j < HISTOGRAM_BUCKET_COUNT; j++)
+                {
+                    mHistograms[i][j] += aCollector.mHistograms[i][j];
+                }
+            }
+        }
+
+        static double toSeconds(long long ticks)
+        {
+            return std::chrono::duration<double>(HelperClock::duration(ticks)).count();
+        }
+
         double getUnkownTime()
         {
             double known = 0;
-            known += mTimers[RAY_INTERSECTION];
-            known += mTimers[SILHOUETTE_PROCESSING];
-            known += mTimers[POLYTOPE_SPLIT];
-            known += mTimers[POLYTOPE_BUILD];
-            known += mTimers[STABBING_LINE_EXTRACTION];
-            known += mTimers[OCCLUDER_TREATMENT];
-
-            return mTimers[VISIBILITY_QUERY] - known;
+            known += getTime(RAY_INTERSECTION);
+            known += getTime(SILHOUETTE_PROCESSING);
+            known += getTime(POLYTOPE_SPLIT);
+            known += getTime(POLYTOPE_BUILD);
+            known += getTime(STABBING_LINE_EXTRACTION);
+            known += getTime(OCCLUDER_TREATMENT);
+
+            return getTime(VISIBILITY_QUERY) - known;
         }
 
         double percent(double time, double total)
@@ -129,16 +300,21 @@ namespace visilib
 
         void display()
         {
-            std::cout << "Query : " << mTimers[VISIBILITY_QUERY] << "sec. (" << 1.0 / mTimers[VISIBILITY_QUERY] << " queries/sec.)" << std::endl;
+            double myTotal = getTime(VISIBILITY_QUERY);
+#ifdef DISABLE_TIMERS
+            std::cout << "Query : timers disabled" << std::endl;
             displayCounts();
-            display("Ray tracing:    ", mTimers[RAY_INTERSECTION], mTimers[VISIBILITY_QUERY]); std::cout << std::endl;
-            display("Silhouette:     ", mTimers[SILHOUETTE_PROCESSING], mTimers[VISIBILITY_QUERY]); std::cout << std::endl;
-            display("Build Polytope: ", mTimers[POLYTOPE_BUILD], mTimers[VISIBILITY_QUERY]); std::cout << std::endl;
-            display("Split Polytope: ", mTimers[POLYTOPE_SPLIT], mTimers[VISIBILITY_QUERY]); std::cout << std::endl;
-            display("Stabbing line:  ", mTimers[STABBING_LINE_EXTRACTION], mTimers[VISIBILITY_QUERY]); std::cout << std::endl;
-            display("Occluders:      ", mTimers[OCCLUDER_TREATMENT], mTimers[VISIBILITY_QUERY]); std::cout << std::endl;
-            display("Unknown:        ", getUnkownTime(), mTimers[VISIBILITY_QUERY]); std::cout << std::endl;
-
+#else
+            std::cout << "Query : " << myTotal << "sec. (" << 1.0 / myTotal << " queries/sec.)" << std::endl;
+            displayCounts();
+            display("Ray tracing:    ", getTime(RAY_INTERSECTION), myTotal); std::cout << std::endl;
+            display("Silhouette:     ", getTime(SILHOUETTE_PROCESSING), myTotal); std::cout << std::endl;
+            display("Build Polytope: ", getTime(POLYTOPE_BUILD), myTotal); std::cout << std::endl;
+            display("Split Polytope: ", getTime(POLYTOPE_SPLIT), myTotal); std::cout << std::endl;
+            display("Stabbing line:  ", getTime(STABBING_LINE_EXTRACTION), myTotal); std::cout << std::endl;
+            display("Occluders:      ", getTime(OCCLUDER_TREATMENT), myTotal); std::cout << std::endl;
+            display("Unknown:        ", getUnkownTime(), myTotal); std::cout << std::endl;
+#endif
             std::cout << std::endl;
           }
 
@@ -146,20 +322,168 @@ namespace visilib
         {
             std::cout << "  [Rays:           " << mCounts[RAY_COUNT] << "]"<< std::endl
                       << "  [Splits:         " << mCounts[POLYTOPE_SPLIT_COUNT] << "]" << std::endl
-                      << "  [Occluder:       " << mCounts[OCCLUDER_TRIANGLE_COUNT] << "]" << std::endl;
+                      << "  [Occluder:       " << mCounts[OCCLUDER_TRIANGLE_COUNT] << "]" << std::endl
+                      << "  [Tree depth:     " << mMaxima[OCCLUSION_TREE_DEPTH] << "]" << std::endl
+                      << "  [Polyhedron:     " << mMaxima[POLYHEDRON_SIZE] << "]" << std::endl
+                      << "  [No split:       " << mCounts[NO_SPLIT_NEGATIVE_COUNT] + mCounts[NO_SPLIT_POSITIVE_COUNT] + mCounts[EDGE_OUTSIDE_POLYTOPE_COUNT] << "]" << std::endl
+                      << "  [Early outs:     " << mCounts[NO_REAL_LINE_COUNT] << " no real line, " << mCounts[OCCLUDED_POLYTOPE_COUNT] << " occluded, " << mCounts[APERTURE_FOUND_COUNT] << " aperture]" << std::endl
+                      << "  [Cache hits:     " << 100 * getHitRate(SILHOUETTE_CACHE_HIT, SILHOUETTE_CACHE_MISS) << "% silhouettes, "
+                                               << 100 * getHitRate(SILHOUETTE_EDGE_CACHE_HIT, SILHOUETTE_EDGE_CACHE_MISS) << "% edges, "
+                                               << 100 * getHitRate(SOURCE_PLANES_CACHE_HIT, SOURCE_PLANES_CACHE_MISS) << "% source planes]" << std::endl
+                      << "  [Degenerate:     " << mCounts[DEGENERATE_PREDICATE_COUNT] << "]" << std::endl;
         }
 
     private:
-        std::vector<int> mCounts;
-        std::vector<double> mTimers;
-        std::vector<bool> mTimerIsRunning;
+        long long mCounts[COUNTER_LAST];
+        long long mTimers[TIMER_LAST];          /**< @brief The accumulated time of each timer, in ticks of the HelperClock*/
+        bool mTimerIsRunning[TIMER_LAST];
+        long long mMaxima[MAXIMUM_LAST];
+        long long mHistograms[HISTOGRAM_LAST][HISTOGRAM_BUCKET_COUNT];
+    };
+
+    /** @brief Thread-safe sum of the statistics of several queries
+
+    Each query collects its statistics in its own HelperStatisticCollector without any synchronization, and adds them to the aggregator
+    once it is completed. The aggregation is lock-free: each counter and timer is an atomic integer.
+    */
+
+    class HelperStatisticAggregator
+    {
+    public:
+        HelperStatisticAggregator()
+        {
+            clear();
+        }
+
+        void clear()
+        {
+            for (size_t i = 0; i < COUNTER_LAST; i++)
+            {
+                mCounts[i] = 0;
+            }
+            for (size_t i = 0; i < TIMER_LAST; i++)
+            {
+                mTimers[i] = 0;
+            }
+            for (size_t i = 0; i < MAXIMUM_LAST; i++)
+            {
+                mMaxima[i] = 0;
+            }
+            for (size_t i = 0; i < HISTOGRAM_LAST; i++)
+            {
+                for (size_t j = 0; j < HISTOGRAM_BUCKET_COUNT; j++)
+                {
+                    mHistograms[i][j] = 0;
+                }
+            }
+            mQueryCount = 0;
+        }
+
+        /** @brief Add the statistics of a completed query. Can be called concurrently by several threads*/
+        void add(const HelperStatisticCollector& aCollector)
+        {
+            for (size_t i = 0; i < COUNTER_LAST; i++)
+            {
+                mCounts[i].fetch_add(aCollector.get((CounterType)i), std::memory_order_relaxed);
+            }
+            for (size_t i = 0; i < TIMER_LAST; i++)
+            {
+                mTimers[i].fetch_add(aCollector.getTicks((TimerType)i), std::memory_order_relaxed);
+            }
+            for (size_t i = 0; i < MAXIMUM_LAST; i++)
+            {
+                long long myValue = aCollector.getMax((MaximumType)i);
+                long long myMax = mMaxima[i].load(std::memory_order_relaxed);
+                while (myValue > myMax && !mMaxima[i].compare_exchange_weak(myMax, myValue, std::memory_order_relaxed))
+                {
+                }
+            }
+            for (size_t i = 0; i < HISTOGRAM_LAST; i++)
+            {
+                for (size_t j = 0; j < HISTOGRAM_BUCKET_COUNT; j++)
+                {
+                    long long myCount = aCollector.getHistogram((HistogramType)i, j);
+                    if (myCount > 0)
+                    {
+                        mHistograms[i][j].fetch_add(myCount, std::memory_order_relaxed);
+                    }
+                }
+            }
+            mQueryCount.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        long long get(CounterType counter) const
+        {
+            return mCounts[counter].load(std::memory_order_relaxed);
+        }
+
+        double getTime(TimerType timer) const
+        {
+            return HelperStatisticCollector::toSeconds(mTimers[timer].load(std::memory_order_relaxed));
+        }
 
-        double mTimerFrequency;
+        long long getMax(MaximumType maximum) const
+        {
+            return mMaxima[maximum].load(std::memory_order_relaxed);
+        }
+
+        long long getHistogram(HistogramType histogram, size_t bucket) const
+        {
+            return mHistograms[histogram][bucket].load(std::memory_order_relaxed);
+        }
+
+        long long getQueryCount() const
+        {
+            return mQueryCount.load(std::memory_order_relaxed);
+        }
+
+        /** @brief Copy the current sums into a collector, e.g. to display them*/
+        void getSnapshot(HelperStatisticCollector& aCollector) const
+        {
+            aCollector.clear();
+            for (size_t i = 0; i < COUNTER_LAST; i++)
+            {
+                aCollector.add((CounterType)i, get((CounterType)i));
+            }
+            for (size_t i = 0; i < TIMER_LAST; i++)
+            {
+                aCollector.incrementTime((TimerType)i, mTimers[i].load(std::memory_order_relaxed));
+            }
+            for (size_t i = 0; i < MAXIMUM_LAST; i++)
+            {
+                aCollector.updateMax((MaximumType)i, getMax((MaximumType)i));
+            }
+            for (size_t i = 0; i < HISTOGRAM_LAST; i++)
+            {
+                for (size_t j = 0; j < HISTOGRAM_BUCKET_COUNT; j++)
+                {
+                    aCollector.addToHistogram((HistogramType)i, j, mHistograms[i][j].load(std::memory_order_relaxed));
+                }
+            }
+        }
+
+    private:
+        std::atomic<long long> mCounts[COUNTER_LAST];
+        std::atomic<long long> mTimers[TIMER_LAST];
+        std::atomic<long long> mMaxima[MAXIMUM_LAST];
+        std::atomic<long long> mHistograms[HISTOGRAM_LAST][HISTOGRAM_BUCKET_COUNT];
+        std::atomic<long long> mQueryCount;
     };
 
+#ifdef DISABLE_TIMERS
+    /** @brief Empty timer, used when the timers are removed at compile time: the compiler discards it entirely*/
+    class HelperScopedTimer
+    {
+    public:
+        HelperScopedTimer(HelperStatisticCollector*, TimerType)
+        {
+        }
+    };
+#else
     /** @brief A high precision timer, that measures the time ellapsed during the execution of the function inside the scope of the time.
 
     The timer measurement is started at the creation of the timer and stopped at desctruction of the timer.
+    It measures the wall-clock time of the calling thread with a monotonic clock.
     */
     class HelperScopedTimer
     {
@@ -168,35 +492,20 @@ namespace visilib
             : mTimer(aTimer),
             mCollector(aCollector)
         {
-#ifdef WIN32
-            QueryPerformanceCounter((LARGE_INTEGER*)mStartTime);
-#else
-           mStartTime = clock();
-#endif
+           mStartTime = HelperClock::now();
            mCollector->setTimerIsRunning(mTimer, true);
         }
 
         ~HelperScopedTimer()
         {
-#ifdef WIN32
-            unsigned long ellapsedTime[2];
-            QueryPerformanceCounter((LARGE_INTEGER*)ellapsedTime);
-            ellapsedTime[0] -= mStartTime[0];
-            mCollector->incrementTime(mTimer, ellapsedTime[0]);
-#else
-            mCollector->incrementTime(mTimer, (double) (clock()- mStartTime));
-#endif
-
+            mCollector->incrementTime(mTimer, (HelperClock::now() - mStartTime).count());
             mCollector->setTimerIsRunning(mTimer, false);
         }
 
     private:
-#ifdef WIN32
-        unsigned long mStartTime[2];
-#else
-        clock_t mStartTime;
-#endif
+        HelperClock::time_point mStartTime;
         TimerType mTimer;
         HelperStatisticCollector* mCollector;
     };
+#endif
 }
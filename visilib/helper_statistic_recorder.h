@@ -0,0 +1,203 @@
+/*
+Visilib, an open source library for exact visibility computation.
+Copyright(C) 2021 by Denis Haumont
+
+This file is part of Visilib.
+
+Visilib is free software : you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Visilib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Visilib. If not, see <http://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <unordered_map>
+#include "helper_statistic_collector.h"
+#include "math_vector_3.h"
+
+namespace visilib
+{
+    /** @brief Description of a completed visibility query, as recorded by a HelperStatisticRecorder*/
+
+    struct HelperQueryRecord
+    {
+        HelperClock::time_point mStartTime;   /**< @brief The time at which the query started*/
+        HelperClock::time_point mEndTime;     /**< @brief The time at which the query ended*/
+        int mResult;                          /**< @brief The VisibilityResult of the query*/
+        size_t mVertexCount[2];               /**< @brief The number of vertices of each source*/
+        MathVector3d mCenter[2];              /**< @brief The gravity center of each source, identifying the pair of sources*/
+    };
+
+    /** @brief Thread-safe recorder of the statistics of each visibility query
+
+    The record of a query is written once the query is completed, so that no output is performed during the computation itself.
+    The records can be written as JSON lines (one JSON object per query) and as events of the Chrome trace format,
+    which can be opened in chrome://tracing or Perfetto to inspect the timeline of the queries executed by each thread.
+    */
+
+    class HelperStatisticRecorder
+    {
+    public:
+        /** @brief Create a recorder writing to the given streams
+
+        @param aJsonLines: the stream receiving the JSON lines records (optional)
+        @param aTrace: the stream receiving the Chrome trace events (optional)
+        */
+        HelperStatisticRecorder(std::ostream* aJsonLines, std::ostream* aTrace)
+            : mJsonLines(aJsonLines),
+            mTrace(aTrace),
+            mQueryCount(0),
+            mOrigin(HelperClock::now()),
+            mTraceStarted(false)
+        {
+        }
+
+        ~HelperStatisticRecorder()
+        {
+            close();
+        }
+
+        /** @brief Write the record of a completed query. Can be called concurrently by several threads*/
+        void record(const HelperQueryRecord& aRecord, const HelperStatisticCollector& aStatistic);
+
+        /** @brief Terminate the trace and flush the streams*/
+        void close();
+
+        size_t getQueryCount() const
+        {
+            return mQueryCount;
+        }
+
+    private:
+        /** @brief Return a small index identifying the calling thread*/
+        size_t getThreadIndex();
+
+        double toMicroseconds(HelperClock::duration aDuration) const
+        {
+            return std::chrono::duration<double, std::micro>(aDuration).count();
+        }
+
+        void writeArguments(std::ostream& anOutput, size_t aQueryId, const HelperQueryRecord& aRecord, const HelperStatisticCollector& aStatistic) const;
+
+        std::ostream* mJsonLines;                                   /**< @brief The stream receiving the JSON lines records*/
+        std::ostream* mTrace;                                       /**< @brief The stream receiving the Chrome trace events*/
+        std::atomic<size_t> mQueryCount;                            /**< @brief The number of queries recorded*/
+        HelperClock::time_point mOrigin;                            /**< @brief The origin of the times of the records*/
+        bool mTraceStarted;                                         /**< @brief True if the opening bracket of the trace has been written*/
+        std::mutex mMutex;                                          /**< @brief Serializes the writes to the streams*/
+        std::unordered_map<std::thread::id, size_t> mThreadIndices; /**< @brief The index of each thread that recorded a query*/
+    };
+
+    inline size_t HelperStatisticRecorder::getThreadIndex()
+    {
+        auto myThread = std::this_thread::get_id();
+        auto iter = mThreadIndices.find(myThread);
+        if (iter == mThreadIndices.end())
+        {
+            iter = mThreadIndices.insert(std::make_pair(myThread, mThreadIndices.size())).first;
+        }
+        return iter->second;
+    }
+
+    inline void HelperStatisticRecorder::writeArguments(std::ostream& anOutput, size_t aQueryId, const HelperQueryRecord& aRecord, const HelperStatisticCollector& aStatistic) const
+    {
+        static const char* myResults[] = { "VISIBLE", "HIDDEN", "UNKNOWN", "FAILURE" };
+
+        anOutput << "\"query\": " << aQueryId
+            << ", \"result\": \"" << (aRecord.mResult >= 0 && aRecord.mResult < 4 ? myResults[aRecord.mResult] : "UNKNOWN") << "\""
+            << ", \"vertices\": [" << aRecord.mVertexCount[0] << ", " << aRecord.mVertexCount[1] << "]"
+            << ", \"centers\": [[" << aRecord.mCenter[0].x << ", " << aRecord.mCenter[0].y << ", " << aRecord.mCenter[0].z << "], ["
+            << aRecord.mCenter[1].x << ", " << aRecord.mCenter[1].y << ", " << aRecord.mCenter[1].z << "]]";
+
+        for (size_t i = 0; i < MAXIMUM_LAST; i++)
+        {
+            anOutput << ", \"" << getStatisticName((MaximumType)i) << "\": " << aStatistic.getMax((MaximumType)i);
+        }
+
+        anOutput << ", \"counters\": {";
+        for (size_t i = 0; i < COUNTER_LAST; i++)
+        {
+            anOutput << (i > 0 ? ", " : "") << "\"" << getStatisticName((CounterType)i) << "\": " << aStatistic.get((CounterType)i);
+        }
+        anOutput << "}, \"histograms\": {";
+        for (size_t i = 0; i < HISTOGRAM_LAST; i++)
+        {
+            // The trailing empty buckets are omitted
+            size_t myBucketCount = HISTOGRAM_BUCKET_COUNT;
+            while (myBucketCount > 0 && aStatistic.getHistogram((HistogramType)i, myBucketCount - 1) == 0)
+            {
+                myBucketCount--;
+            }
+            anOutput << (i > 0 ? ", " : "") << "\"" << getStatisticName((HistogramType)i) << "\": [";
+            for (size_t j = 0; j < myBucketCount; j++)
+            {
+                anOutput << (j > 0 ? ", " : "") << aStatistic.getHistogram((HistogramType)i, j);
+            }
+            anOutput << "]";
+        }
+        anOutput << "}, \"timersUs\": {";
+        for (size_t i = 0; i < TIMER_LAST; i++)
+        {
+            anOutput << (i > 0 ? ", " : "") << "\"" << getStatisticName((TimerType)i) << "\": " << aStatistic.getTime((TimerType)i) * 1e6;
+        }
+        anOutput << "}";
+    }
+
+    inline void HelperStatisticRecorder::record(const HelperQueryRecord& aRecord, const HelperStatisticCollector& aStatistic)
+    {
+        size_t myQueryId = mQueryCount++;
+        double myStart = toMicroseconds(aRecord.mStartTime - mOrigin);
+        double myDuration = toMicroseconds(aRecord.mEndTime - aRecord.mStartTime);
+
+        std::lock_guard<std::mutex> myLock(mMutex);
+        size_t myThread = getThreadIndex();
+
+        if (mJsonLines != nullptr)
+        {
+            *mJsonLines << "{\"thread\": " << myThread << ", \"startUs\": " << myStart << ", \"durationUs\": " << myDuration << ", ";
+            writeArguments(*mJsonLines, myQueryId, aRecord, aStatistic);
+            *mJsonLines << "}\n";
+        }
+
+        if (mTrace != nullptr)
+        {
+            // Complete event ("ph": "X"), the times are expressed in microseconds
+            *mTrace << (mTraceStarted ? ",\n" : "[\n");
+            mTraceStarted = true;
+            *mTrace << "{\"name\": \"query " << myQueryId << "\", \"cat\": \"visibility\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << myThread
+                << ", \"ts\": " << myStart << ", \"dur\": " << myDuration << ", \"args\": {";
+            writeArguments(*mTrace, myQueryId, aRecord, aStatistic);
+            *mTrace << "}}";
+        }
+    }
+
+    inline void HelperStatisticRecorder::close()
+    {
+        std::lock_guard<std::mutex> myLock(mMutex);
+
+        if (mTrace != nullptr)
+        {
+            *mTrace << (mTraceStarted ? "\n]\n" : "[]\n");
+            mTrace->flush();
+            mTrace = nullptr;
+        }
+        if (mJsonLines != nullptr)
+        {
+            mJsonLines->flush();
+            mJsonLines = nullptr;
+        }
+    }
+}
@@ -0,0 +1,176 @@
+/*
+Visilib, an open source library for exact visibility computation.
+Copyright(C) 2021 by Denis Haumont
+
+This file is part of Visilib.
+
+Visilib is free software : you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Visilib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Visilib. If not, see <http://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "visilib_core.h"
+
+namespace visilib
+{
+    /** @brief Pool of threads executing tasks with work stealing.
+
+    Each worker owns a queue of tasks. A worker executes the last task pushed in its own queue (depth-first execution of the forked tasks),
+    and when its queue is empty, it steals the oldest task of the queue of another worker (usually the largest remaining piece of work).
+    A running task can fork new tasks by pushing them in the queue of its worker. The pool runs until all the tasks have been executed.
+    A worker finding no task to execute sleeps until a task is pushed or all the tasks are completed.
+    */
+
+    class HelperWorkStealingPool
+    {
+    public:
+        /** @brief A task, receiving the index of the worker executing it*/
+        typedef std::function<void(size_t)> Task;
+
+        HelperWorkStealingPool(size_t aThreadCount)
+            : mQueues(aThreadCount > 0 ? aThreadCount : 1),
+            mPendingCount(0),
+            mQueuedCount(0)
+        {
+        }
+
+        size_t getThreadCount() const
+        {
+            return mQueues.size();
+        }
+
+        /** @brief Push a task in the queue of a worker. Can be called by a running task to fork work*/
+        void push(const Task& aTask, size_t aWorker)
+        {
+            V_ASSERT(aWorker < mQueues.size());
+
+            mPendingCount++;
+            {
+                std::lock_guard<std::mutex> myLock(mQueues[aWorker].mMutex);
+                mQueues[aWorker].mTasks.push_back(aTask);
+            }
+            mQueuedCount++;
+            wakeWorkers(false);
+        }
+
+        /** @brief Execute all the tasks, the calling thread being the worker 0*/
+        void run();
+
+    private:
+        /** @brief The queue of tasks of a worker*/
+        struct Queue
+        {
+            std::mutex mMutex;
+            std::deque<Task> mTasks;
+        };
+
+        /** @brief Pop the next task of a worker, stealing it from another worker if required*/
+        bool pop(size_t aWorker, Task& aTask);
+
+        void work(size_t aWorker);
+
+        /** @brief Wake one sleeping worker, or all of them*/
+        void wakeWorkers(bool anAll)
+        {
+            // The lock orders the notification after the test of the condition by a worker about to sleep
+            {
+                std::lock_guard<std::mutex> myLock(mIdleMutex);
+            }
+            if (anAll)
+                mIdleCondition.notify_all();
+            else
+                mIdleCondition.notify_one();
+        }
+
+        std::vector<Queue> mQueues;              /**< @brief The queue of tasks of each worker*/
+        std::atomic<size_t> mPendingCount;       /**< @brief The number of tasks pushed and not yet completed*/
+        std::atomic<size_t> mQueuedCount;        /**< @brief The number of tasks waiting in the queues*/
+        std::mutex mIdleMutex;
+        std::condition_variable mIdleCondition;  /**< @brief Signaled when a task is pushed or when all the tasks are completed*/
+    };
+
+    inline void HelperWorkStealingPool::run()
+    {
+        std::vector<std::thread> myThreads;
+        for (size_t i = 1; i < mQueues.size(); i++)
+        {
+            myThreads.push_back(std::thread(&HelperWorkStealingPool::work, this, i));
+        }
+
+        work(0);
+
+        for (auto& myThread : myThreads)
+        {
+            myThread.join();
+        }
+    }
+
+    inline bool HelperWorkStealingPool::pop(size_t aWorker, Task& aTask)
+    {
+        {
+            Queue& myQueue = mQueues[aWorker];
+            std::lock_guard<std::mutex> myLock(myQueue.mMutex);
+            if (!myQueue.mTasks.empty())
+            {
+                aTask = std::move(myQueue.mTasks.back());
+                myQueue.mTasks.pop_back();
+                mQueuedCount--;
+                return true;
+            }
+        }
+
+        for (size_t i = 1; i < mQueues.size(); i++)
+        {
+            Queue& myQueue = mQueues[(aWorker + i) % mQueues.size()];
+            std::lock_guard<std::mutex> myLock(myQueue.mMutex);
+            if (!myQueue.mTasks.empty())
+            {
+                aTask = std::move(myQueue.mTasks.front());
+                myQueue.mTasks.pop_front();
+                mQueuedCount--;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    inline void HelperWorkStealingPool::work(size_t aWorker)
+    {
+        // A task may still fork new tasks while it is running: the workers stop when all the tasks are completed
+        while (mPendingCount > 0)
+        {
+            Task myTask;
+            if (pop(aWorker, myTask))
+            {
+                myTask(aWorker);
+                if (--mPendingCount == 0)
+                {
+                    wakeWorkers(true);
+                }
+            }
+            else
+            {
+                std::unique_lock<std::mutex> myLock(mIdleMutex);
+                mIdleCondition.wait(myLock, [this]() { return mPendingCount == 0 || mQueuedCount > 0; });
+            }
+        }
+    }
+}
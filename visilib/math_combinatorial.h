@@ -32,6 +32,7 @@ namespace visilib
     {
     public:
         static bool haveAtLeastNCommonFacets(const std::vector<size_t>& aFacetsDescription1, const std::vector<size_t>& aFacetsDescription2, size_t n = 3);
+        static bool haveAtLeastNCommonFacets(const size_t* aBegin1, const size_t* anEnd1, const size_t* aBegin2, const size_t* anEnd2, size_t n = 3);
         static void getCommonFacets(const std::vector<size_t>& aFacetsDescription1, const std::vector<size_t>& aFacetsDescription2, std::vector<size_t>& aCommonFactes);
         static void initFacets(const std::vector<size_t>& aFacetsDescription1, const std::vector<size_t>& aFacetsDescription2, size_t anHyperplane, std::vector<size_t>& aResultFacetsDescription);
         static void initFacets(const std::vector<size_t>& aFacetsDescription1, const std::vector<size_t>& aFacetsDescription2, std::vector<size_t>& result);
@@ -45,10 +46,36 @@ namespace visilib
 
     inline bool MathCombinatorial::haveAtLeastNCommonFacets(const std::vector<size_t>& aFacetsDescription1, const std::vector<size_t>& aFacetsDescription2, size_t n)
     {
-        std::vector<size_t> result;
-        getCommonFacets(aFacetsDescription1, aFacetsDescription2, result);
-        size_t size = result.size();
-        return size >= n;
+        return haveAtLeastNCommonFacets(aFacetsDescription1.data(), aFacetsDescription1.data() + aFacetsDescription1.size(),
+                                        aFacetsDescription2.data(), aFacetsDescription2.data() + aFacetsDescription2.size(), n);
+    }
+
+    /** @brief Determine if two sorted ranges of facets have at least n common elements, without building their intersection*/
+
+    inline bool MathCombinatorial::haveAtLeastNCommonFacets(const size_t* aBegin1, const size_t* anEnd1, const size_t* aBegin2, const size_t* anEnd2, size_t n)
+    {
+        V_ASSERT(std::is_sorted(aBegin1, anEnd1));
+        V_ASSERT(std::is_sorted(aBegin2, anEnd2));
+
+        size_t myCount = 0;
+        while (aBegin1 != anEnd1 && aBegin2 != anEnd2 && myCount < n)
+        {
+            if (*aBegin1 < *aBegin2)
+            {
+                aBegin1++;
+            }
+            else if (*aBegin2 < *aBegin1)
+            {
+                aBegin2++;
+            }
+            else
+            {
+                myCount++;
+                aBegin1++;
+                aBegin2++;
+            }
+        }
+        return myCount >= n;
     }
 
     inline void MathCombinatorial::getCommonFacets(const std::vector<size_t>& aFacetsDescription1, const std::vector<size_t>& aFacetsDescription2, std::vector<size_t>& aResultFacetsDescription)
@@ -20,6 +20,8 @@ along with Visilib. If not, see <http://www.gnu.org/licenses/>
 
 #pragma once
 
+#include <algorithm>
+#include <vector>
 #include "math_plucker_2.h"
 #include "math_plucker_6.h"
 #include "math_predicates.h"
@@ -94,7 +96,7 @@ namespace visilib
         @param v2: first vertex of the edge
         @param p1: position of v1 with respect to the Plucker Quadric (ie the sign of v1.dot(v1))
         @param p2: position of v2 with respect to the Plucker Quadric (ie the sign of v2.dot(v2))
-        @param result: the set of intersection points (0, 1 or 2) with the Plucker Quadric
+        @param result: the intersection points (0, 1 or 2) with the Plucker Quadric are appended to result, such that a caller can accumulate the points of several edges in a single buffer
         @param newtonRaphson: use an iterative Newton Raphson optimisation to increase the precision of the results
         */
         template<class P, class S> static bool findPluckerEdgeWithQuadricIntersection(const P& v1, const P& v2, GeometryPositionType p1, GeometryPositionType p2, std::vector<P>& result, bool newtonRaphson, const S & tolerance);
@@ -105,6 +107,16 @@ namespace visilib
         /** @brief Test if an edge has an intersection with the Plucker Quadric  */
         template<class P, class S> static bool hasPluckerEdgeWithQuadricIntersection(const P& v1, const P& v2, GeometryPositionType p1, GeometryPositionType p2, const S & tolerance);
 
+        /** @brief Test if the polynomial a.t^2 + 2b.t + c has a root in [0,1], where the polynomial describes the position of the points of an edge with respect to the Plucker Quadric
+
+        @param a: the coefficient F.dot(F), where F is the direction of the edge
+        @param b: the coefficient F.dot(v1), where v1 is the first vertex of the edge
+        @param c: the coefficient v1.dot(v1)
+        @param p1: position of the first vertex with respect to the Plucker Quadric
+        @param p2: position of the second vertex with respect to the Plucker Quadric
+        */
+        template<class S> static bool hasQuadricRootInEdge(const S& a, const S& b, const S& c, GeometryPositionType p1, GeometryPositionType p2, const S& tolerance);
+
         /** @brief Compute the supporting plane of a convex polygon */
         static MathPlane3d computePlane(const GeometryConvexPolygon& polygon);
 
@@ -155,7 +167,7 @@ namespace visilib
         This procedure is not formally correct from a mathematical point of view: the gravity center in Pluker space do not correspond to a real line in 3D since the gravity center
          does not belongs to the Plucker quadric. However, it works well in practice to find an average polytope representative line
         */
-        template<class P, class S> static P computeRepresentativeLine(PluckerPolytope<P>* polytope, PluckerPolyhedron<P>* polyhedron, const S & tolerance);
+        template<class P, class S> static P computeRepresentativeLine(PluckerPolytope<P>* polytope, const S & tolerance);
 
         /** @brief  Compute the intersection of an edge with a plane */
         static MathVector3_<double> getPlaneIntersectionWithEdge(const MathVector3_<double>& myV1, const MathVector3_<double>& myV2, const MathPlane3_<double>& aPlane);
@@ -421,7 +433,7 @@ namespace visilib
     template<class P, class S>
     inline bool MathGeometry::findPluckerEdgeWithQuadricIntersection(const P & v1, const P & v2, GeometryPositionType p1, GeometryPositionType p2, std::vector<P> & result, bool newtonRaphson, const S & tolerance)
     {
-        result.clear();
+        const size_t myInitialSize = result.size();
 
         if (p1 == ON_BOUNDARY)
         {
@@ -431,7 +443,7 @@ namespace visilib
         {
             result.push_back(v2);
         }
-        if (result.size() > 0)
+        if (result.size() > myInitialSize)
         {
             return true;
         }
@@ -441,7 +453,9 @@ namespace visilib
         S b = F.dot(v1);
         S c = v1.dot(v1);
 
-        std::vector<S> ts;
+        // At most two roots: no allocation is required
+        S ts[2];
+        size_t myRootCount = 0;
 
         if (a <= tolerance && a >= -tolerance)
         {//a==0
@@ -450,7 +464,7 @@ namespace visilib
                 return false;
             }
 
-            ts.push_back(-c / (2 * b));
+            ts[myRootCount++] = -c / (2 * b);
         }
         else
         {
@@ -467,7 +481,7 @@ namespace visilib
             if (delta <= tolerance)
             {
                 // delta is 0, single root
-                ts.push_back(-b / a);
+                ts[myRootCount++] = -b / a;
             }
             else
             {
@@ -475,11 +489,11 @@ namespace visilib
                 S sqrt_delta = MathArithmetic<S>::getSqrt(delta);
                 V_ASSERT(MathArithmetic<S>::getAbs(a) >= tolerance);
 
-                ts.push_back((-b + sqrt_delta) / a);
-                ts.push_back((-b - sqrt_delta) / a);
+                ts[myRootCount++] = (-b + sqrt_delta) / a;
+                ts[myRootCount++] = (-b - sqrt_delta) / a;
             }
         }
-        for (size_t i = 0; i < ts.size(); i++)
+        for (size_t i = 0; i < myRootCount; i++)
         {
             S t = ts[i];
 
@@ -514,12 +528,12 @@ namespace visilib
         }
 
 #if _DEBUG
-        for (size_t i = 0; i < result.size(); i++)
+        for (size_t i = myInitialSize; i < result.size(); i++)
         {
             V_ASSERT(result[i].dot(result[i]) < tolerance);
         }
 #endif
-        return result.size() > 0;
+        return result.size() > myInitialSize;
     }
 
     template<class P, class S>
@@ -532,11 +546,22 @@ namespace visilib
 
         P  F = v2 - v1;
 
-        S a = F.dot(F);
-        S b = F.dot(v1);
-        S c = v1.dot(v1);
+        return hasQuadricRootInEdge<S>(F.dot(F), F.dot(v1), v1.dot(v1), p1, p2, tolerance);
+    }
 
-        std::vector<S> ts;
+    template<class S>
+    inline bool MathGeometry::hasQuadricRootInEdge(const S& a, const S& b, const S& c, GeometryPositionType p1, GeometryPositionType p2, const S& tolerance)
+    {
+        if (p1 == ON_BOUNDARY || p2 == ON_BOUNDARY)
+        {
+            return true;
+        }
+
+        // A concave polynomial positive at both ends, or a convex polynomial negative at both ends, keeps its sign on the whole edge
+        if ((p1 == ON_POSITIVE_SIDE && p2 == ON_POSITIVE_SIDE && a <= 0) || (p1 == ON_NEGATIVE_SIDE && p2 == ON_NEGATIVE_SIDE && a >= 0))
+        {
+            return false;
+        }
 
         if (a <= tolerance && a >= -tolerance)
         {
@@ -677,6 +702,114 @@ namespace visilib
         return (aPolygon.getVertexCount() > 1);
     }
 
+    /** @brief A batch of edges in Plucker space, stored as a structure of arrays
+
+    Each coordinate of the vertices of the edges is stored in its own array, such that the coefficients of the quadratic polynomials of all the edges
+    are computed by a single loop, vectorized by the compiler for the float and double precisions. The buffers are kept from one batch to the next.
+    */
+    template<class S>
+    class MathPluckerEdgeBatch
+    {
+    public:
+        MathPluckerEdgeBatch()
+            : mSize(0)
+        {
+        }
+
+        void clear()
+        {
+            mSize = 0;
+        }
+
+        size_t getSize() const
+        {
+            return mSize;
+        }
+
+        /** @brief Add an edge to the batch*/
+        void add(const MathPlucker6<S>& v1, const MathPlucker6<S>& v2, GeometryPositionType p1, GeometryPositionType p2);
+
+        /** @brief Compute for each edge if it intersects the Plucker Quadric, as MathGeometry::hasPluckerEdgeWithQuadricIntersection()*/
+        void computeQuadricIntersections(const S& tolerance);
+
+        bool hasQuadricIntersection(size_t i) const
+        {
+            return mResults[i] != 0;
+        }
+
+    private:
+        std::vector<S> mVertices[12];                       /**< @brief The 6 coordinates of the first vertices, then of the second vertices*/
+        std::vector<S> mA;                                  /**< @brief The coefficients of the polynomials, as in MathGeometry::hasQuadricRootInEdge()*/
+        std::vector<S> mB;
+        std::vector<S> mC;
+        std::vector<GeometryPositionType> mPositions[2];    /**< @brief The positions of the vertices with respect to the Plucker Quadric*/
+        std::vector<unsigned char> mResults;
+        size_t mSize;
+    };
+
+    template<class S>
+    inline void MathPluckerEdgeBatch<S>::add(const MathPlucker6<S>& v1, const MathPlucker6<S>& v2, GeometryPositionType p1, GeometryPositionType p2)
+    {
+        if (mSize == mA.size())
+        {
+            size_t myCapacity = std::max<size_t>(16, 2 * mSize);
+            for (size_t j = 0; j < 12; j++)
+            {
+                mVertices[j].resize(myCapacity);
+            }
+            mA.resize(myCapacity);
+            mB.resize(myCapacity);
+            mC.resize(myCapacity);
+            mPositions[0].resize(myCapacity);
+            mPositions[1].resize(myCapacity);
+            mResults.resize(myCapacity);
+        }
+
+        const MathPlucker6<S>* myVertices[2] = { &v1, &v2 };
+        for (size_t k = 0; k < 2; k++)
+        {
+            const MathVector3_<S>& myDirection = myVertices[k]->getDirection();
+            const MathVector3_<S>& myLocation = myVertices[k]->getLocation();
+            mVertices[k * 6 + 0][mSize] = myDirection.x;
+            mVertices[k * 6 + 1][mSize] = myDirection.y;
+            mVertices[k * 6 + 2][mSize] = myDirection.z;
+            mVertices[k * 6 + 3][mSize] = myLocation.x;
+            mVertices[k * 6 + 4][mSize] = myLocation.y;
+            mVertices[k * 6 + 5][mSize] = myLocation.z;
+        }
+        mPositions[0][mSize] = p1;
+        mPositions[1][mSize] = p2;
+        mSize++;
+    }
+
+    template<class S>
+    inline void MathPluckerEdgeBatch<S>::computeQuadricIntersections(const S& tolerance)
+    {
+        const S* v1dx = mVertices[0].data(); const S* v1dy = mVertices[1].data(); const S* v1dz = mVertices[2].data();
+        const S* v1lx = mVertices[3].data(); const S* v1ly = mVertices[4].data(); const S* v1lz = mVertices[5].data();
+        const S* v2dx = mVertices[6].data(); const S* v2dy = mVertices[7].data(); const S* v2dz = mVertices[8].data();
+        const S* v2lx = mVertices[9].data(); const S* v2ly = mVertices[10].data(); const S* v2lz = mVertices[11].data();
+        S* a = mA.data();
+        S* b = mB.data();
+        S* c = mC.data();
+
+        // Branch free loop, with the same operations as MathPlucker6::dot() applied to F = v2 - v1
+        for (size_t i = 0; i < mSize; i++)
+        {
+            S fdx = v2dx[i] - v1dx[i]; S fdy = v2dy[i] - v1dy[i]; S fdz = v2dz[i] - v1dz[i];
+            S flx = v2lx[i] - v1lx[i]; S fly = v2ly[i] - v1ly[i]; S flz = v2lz[i] - v1lz[i];
+
+            a[i] = (flx * fdx + fly * fdy + flz * fdz) + (fdx * flx + fdy * fly + fdz * flz);
+            b[i] = (v1lx[i] * fdx + v1ly[i] * fdy + v1lz[i] * fdz) + (v1dx[i] * flx + v1dy[i] * fly + v1dz[i] * flz);
+            c[i] = (v1lx[i] * v1dx[i] + v1ly[i] * v1dy[i] + v1lz[i] * v1dz[i]) + (v1dx[i] * v1lx[i] + v1dy[i] * v1ly[i] + v1dz[i] * v1lz[i]);
+        }
+
+        for (size_t i = 0; i < mSize; i++)
+        {
+            mResults[i] = MathGeometry::hasQuadricRootInEdge<S>(a[i], b[i], c[i], mPositions[0][i], mPositions[1][i], tolerance) ? 1 : 0;
+        }
+    }
+
     inline MathPlane3d MathGeometry::computePlane(const GeometryConvexPolygon & polygon)
     {
         bool edgeNotFound = true;
@@ -940,16 +1073,10 @@ namespace visilib
     }
 
     template<class P, class S>
-    inline P MathGeometry::computeRepresentativeLine(PluckerPolytope<P> * polytope, PluckerPolyhedron<P> * polyhedron, const S & tolerance)
+    inline P MathGeometry::computeRepresentativeLine(PluckerPolytope<P> * polytope, const S & tolerance)
     {
-        P  myGravityCenterImaginary = P::Zero();
-        auto myVertices = polytope->getVertices();
-
-        for (auto iter = myVertices.begin(); iter != myVertices.end(); iter++)
-        {
-            size_t v = *iter;
-            myGravityCenterImaginary += polyhedron->get(v);
-        }
+        // The sum of the vertices is proportional to their gravity center, and has the same projection on the quadric
+        const P& myGravityCenterImaginary = polytope->getVertexSum();
 
         P myGravityCenterReal = getProjectionOnQuadric<P,S>(myGravityCenterImaginary);
 //        P myGravityCenterReal = getClosestQuadricPoint<P,S>(myGravityCenterImaginary);
@@ -97,7 +97,7 @@ namespace visilib
         bool hasPointOnTheLeft = false;
         bool hasPointOnTheRight = false;
 
-        auto myVertices = polytope->getVertices();
+        const auto& myVertices = polytope->getVertices();
 
         for (auto iter = myVertices.begin(); iter != myVertices.end(); iter++)
         {
@@ -213,7 +213,7 @@ namespace visilib
         bool hasPointOnTheLeft = false;
         bool hasPointOnTheRight = false;
 
-        auto myVertices = polytope->getVertices();
+        const auto& myVertices = polytope->getVertices();
 
         for (auto iter = myVertices.begin(); iter != myVertices.end(); iter++)
         {
@@ -21,6 +21,7 @@ along with Visilib. If not, see <http://www.gnu.org/licenses/>
 #pragma once
 
 #include <set>
+#include <type_traits>
 #include <unordered_set>
 #include "math_plucker_6.h"
 #include "math_geometry.h"
@@ -88,6 +89,12 @@ namespace visilib
             return mVertices;
         }
 
+        /** @brief Return the sum of the vertices of the polytope, maintained as the edges are added */
+        inline const P& getVertexSum() const
+        {
+            return mVertexSum;
+        }
+
         /** @brief Return the subset of edges of the polytope that have an intersection with the Plucker Quadric (ie reprsents real line)
        @return: a set containing all the edges <i,j> joining the vertices i and j with an intersection with the Plucker Quadric
        */
@@ -119,7 +126,7 @@ namespace visilib
 
         template<class S> bool hasSomeEdgesCollapsed(PluckerPolyhedron<P>* polyhedron, S Tolerance);
 
-        /** @brief Remove the collasped edge (the length of all edges are below the given tolerance).
+        /** @brief Remove the collasped edge (the length of all edges are below the given tolerance, or their vertices have the same facets description as in hasSomeEdgesCollapsed).
 
         @param polyhedron: the polyhedron containing all the vertices definition
         @param S: the tolerance against which the length of the edges is tested
@@ -199,14 +206,17 @@ namespace visilib
         std::set<std::pair<size_t, size_t> > mEdgesIntersectingQuadric;   /** < @brief The edges containing an intersection with the Plucker Quadric.*/
         std::unordered_set<Silhouette*> mSilhouettes;          /** < @brief The set of silhouettes associated to the polytope*/
         std::unordered_set<size_t> mVertices;                            /** < @brief The indices of the vertices of the polytope*/
-        std::vector<std::vector<size_t> > mExtremalStabbingLinesFacets;
+        std::vector<size_t> mExtremalStabbingLinesFacets;                /** < @brief The facets of the edge supporting each ESL, stored contiguously*/
+        std::vector<size_t> mExtremalStabbingLinesFacetsOffsets;         /** < @brief The offset of the facets of each ESL in mExtremalStabbingLinesFacets, followed by the total size*/
         double mRadius;
         P mRepresentativeLine;
+        P mVertexSum;                                                    /** < @brief The sum of the vertices of the polytope*/
     };
 
     template<class P>
     PluckerPolytope<P>::PluckerPolytope()
-        :    mRadius(0)
+        :    mRadius(0),
+        mVertexSum(P::Zero())
     {
     }
 
@@ -232,13 +242,13 @@ namespace visilib
             mEdges.insert(std::pair<size_t, size_t>(min, max));
         }
 
-        if (mVertices.find(aVertex0) == mVertices.end())
+        if (mVertices.insert(aVertex0).second)
         {
-            mVertices.insert(aVertex0);
+            mVertexSum += aPolyhedron->get(aVertex0);
         }
-        if (mVertices.find(aVertex1) == mVertices.end())
+        if (mVertices.insert(aVertex1).second)
         {
-            mVertices.insert(aVertex1);
+            mVertexSum += aPolyhedron->get(aVertex1);
         }
     }
 
@@ -255,13 +265,15 @@ namespace visilib
 
 #if 1
 
-        if (mExtremalStabbingLinesFacets.size() == 0)
+        if (mExtremalStabbingLinesFacetsOffsets.size() != mExtremalStabbingLines.size() + 1)
             return;
+        const size_t* myFacets = mExtremalStabbingLinesFacets.data();
+        const std::vector<size_t>& myOffsets = mExtremalStabbingLinesFacetsOffsets;
         for (size_t i = 0; i < mExtremalStabbingLines.size(); i++)
         {
             for (size_t j = i + 1; j < mExtremalStabbingLines.size(); j++)
             {
-                if (MathCombinatorial::haveAtLeastNCommonFacets(mExtremalStabbingLinesFacets[i], mExtremalStabbingLinesFacets[j], 3))
+                if (MathCombinatorial::haveAtLeastNCommonFacets(myFacets + myOffsets[i], myFacets + myOffsets[i + 1], myFacets + myOffsets[j], myFacets + myOffsets[j + 1], 3))
                 {
                     aStabbingLines.push_back(std::pair<MathVector3d, MathVector3d>( aStabbingLines[i].first,  aStabbingLines[j].first));
                     aStabbingLines.push_back(std::pair<MathVector3d, MathVector3d>( aStabbingLines[i].second, aStabbingLines[j].second));
@@ -335,7 +347,10 @@ namespace visilib
             const P& v2 = polyhedron->get(i2);
 
 
-            if (MathPredicates::isEdgeCollapsed(v1, v2, tolerance))
+            const std::vector<size_t>& facets1 = polyhedron->getFacetsDescription(i1);
+            const std::vector<size_t>& facets2 = polyhedron->getFacetsDescription(i2);
+
+            if (MathPredicates::isEdgeCollapsed(v1, v2, tolerance) || (facets1.size() == facets2.size() && std::equal(facets1.begin(), facets1.end(), facets2.begin())))
             {
                 std::cout << "collapsed edge dected: " << v1-v2 << "; tolerance: "<< 0.5 *tolerance<<std::endl;
                 myMergeTable.push_back(i1);
@@ -453,6 +468,12 @@ namespace visilib
         V_ASSERT(mExtremalStabbingLines.empty());
         V_ASSERT(!mEdgesIntersectingQuadric.empty());
 
+        // The ESL are appended directly to the polytope, and the facets of the edges are built in a buffer reused by the next polytopes of the thread
+        static thread_local std::vector<size_t> edgeFacets;
+        mExtremalStabbingLines.reserve(2 * mEdgesIntersectingQuadric.size());
+        mExtremalStabbingLinesFacetsOffsets.reserve(2 * mEdgesIntersectingQuadric.size() + 1);
+        mExtremalStabbingLinesFacetsOffsets.assign(1, 0);
+
         for (auto iter = mEdgesIntersectingQuadric.begin(); iter != mEdgesIntersectingQuadric.end(); iter++)
         {
             const P& v1 = polyhedron->get(iter->first);
@@ -460,22 +481,19 @@ namespace visilib
             GeometryPositionType p1 = polyhedron->getQuadricRelativePosition(iter->first);
             GeometryPositionType p2 = polyhedron->getQuadricRelativePosition(iter->second);
 
-            std::vector<P> p;
-
             const std::vector<size_t>& facets1 = polyhedron->getFacetsDescription(iter->first);
             const std::vector<size_t>& facets2 = polyhedron->getFacetsDescription(iter->second);
-            std::vector<size_t> edgeFacets;
             MathCombinatorial::initFacets(facets1, facets2, polyhedron->getLinesCount(), edgeFacets);
             edgeFacets.pop_back();
 
-            if (MathGeometry::findPluckerEdgeWithQuadricIntersection<P, S>(v1, v2, p1, p2, p, tolerance))
+            size_t myFirst = mExtremalStabbingLines.size();
+            if (MathGeometry::findPluckerEdgeWithQuadricIntersection<P, S>(v1, v2, p1, p2, mExtremalStabbingLines, tolerance))
             {
-                for (size_t index = 0; index < p.size(); index++)
+                for (size_t index = myFirst; index < mExtremalStabbingLines.size(); index++)
                 {
-                    //	V_ASSERT(MathPredicates<P>::isNormalized(p[index]));
-                    addExtremalStabbingLine(p[index]);
-
-                    mExtremalStabbingLinesFacets.push_back(edgeFacets);
+                    //	V_ASSERT(MathPredicates<P>::isNormalized(mExtremalStabbingLines[index]));
+                    mExtremalStabbingLinesFacets.insert(mExtremalStabbingLinesFacets.end(), edgeFacets.begin(), edgeFacets.end());
+                    mExtremalStabbingLinesFacetsOffsets.push_back(mExtremalStabbingLinesFacets.size());
                 }
             }
             else
@@ -594,15 +612,39 @@ namespace visilib
             {
                 V_ASSERT(mEdgesIntersectingQuadric.empty());
 
-                for (auto iter = mEdges.begin(); iter != mEdges.end(); iter++)
+                if constexpr (std::is_floating_point<S>::value)
+                {
+                    // The edges are tested in a single batch, whose buffers are reused by the next polytopes of the thread
+                    static thread_local MathPluckerEdgeBatch<S> myBatch;
+                    myBatch.clear();
+                    for (auto iter = mEdges.begin(); iter != mEdges.end(); iter++)
+                    {
+                        myBatch.add(polyhedron->get(iter->first), polyhedron->get(iter->second),
+                                    polyhedron->getQuadricRelativePosition(iter->first), polyhedron->getQuadricRelativePosition(iter->second));
+                    }
+                    myBatch.computeQuadricIntersections(tolerance);
+
+                    size_t i = 0;
+                    for (auto iter = mEdges.begin(); iter != mEdges.end(); iter++, i++)
+                    {
+                        if (myBatch.hasQuadricIntersection(i))
+                        {
+                            mEdgesIntersectingQuadric.insert(mEdgesIntersectingQuadric.end(), *iter);
+                        }
+                    }
+                }
+                else
                 {
-                    const P& v1 = polyhedron->get(iter->first);
-                    const P& v2 = polyhedron->get(iter->second);
-                    GeometryPositionType p1 = polyhedron->getQuadricRelativePosition(iter->first);
-                    GeometryPositionType p2 = polyhedron->getQuadricRelativePosition(iter->second);
-                    if (MathGeometry::hasPluckerEdgeWithQuadricIntersection(v1, v2, p1, p2, tolerance))
+                    for (auto iter = mEdges.begin(); iter != mEdges.end(); iter++)
                     {
-                        mEdgesIntersectingQuadric.insert(*iter);
+                        const P& v1 = polyhedron->get(iter->first);
+                        const P& v2 = polyhedron->get(iter->second);
+                        GeometryPositionType p1 = polyhedron->getQuadricRelativePosition(iter->first);
+                        GeometryPositionType p2 = polyhedron->getQuadricRelativePosition(iter->second);
+                        if (MathGeometry::hasPluckerEdgeWithQuadricIntersection(v1, v2, p1, p2, tolerance))
+                        {
+                            mEdgesIntersectingQuadric.insert(*iter);
+                        }
                     }
                 }
             }
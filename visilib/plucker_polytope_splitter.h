@@ -22,6 +22,7 @@ along with Visilib. If not, see <http://www.gnu.org/licenses/>
 
 #include <unordered_map>
 #include "geometry_position_type.h"
+#include "helper_statistic_collector.h"
 #include "math_predicates.h"
 #include "math_geometry.h"
 #include "math_combinatorial.h"
@@ -47,12 +48,13 @@ namespace visilib
         @param tolerance: a tolerance to determine  wheter a point lies on the splitting hyperplane or not
         @param aLeft: the resulting splitted polytope at the negative side of the hyperplane (must be instanciated before calling the function)
         @param aRight: the resulting splitted polytope at the positive side of the hyperplane  (must be instanciated before calling the function)
+        @param aStatistic: a statistic collector counting the vertices classified on the hyperplane by the tolerance only (optional)
        */
-        static GeometryPositionType split(PluckerPolyhedron<P>* polyhedron, const P& aPlane, PluckerPolytope<P>* aPolytope, PluckerPolytope<P>* aLeft, PluckerPolytope<P>* aRight, size_t aPlaneId, bool anormalization, S tolerance);
+        static GeometryPositionType split(PluckerPolyhedron<P>* polyhedron, const P& aPlane, PluckerPolytope<P>* aPolytope, PluckerPolytope<P>* aLeft, PluckerPolytope<P>* aRight, size_t aPlaneId, bool anormalization, S tolerance, HelperStatisticCollector* aStatistic = nullptr);
     };
 
     template<class P, class S>
-    inline GeometryPositionType PluckerPolytopeSplitter<P, S>::split(PluckerPolyhedron<P>* aPolyhedron, const P& aPlane, PluckerPolytope<P>* aPolytope, PluckerPolytope<P>* aLeft, PluckerPolytope<P>* aRight, size_t aPlaneID, bool normalization, S tolerance)
+    inline GeometryPositionType PluckerPolytopeSplitter<P, S>::split(PluckerPolyhedron<P>* aPolyhedron, const P& aPlane, PluckerPolytope<P>* aPolytope, PluckerPolytope<P>* aLeft, PluckerPolytope<P>* aRight, size_t aPlaneID, bool normalization, S tolerance, HelperStatisticCollector* aStatistic)
     {
         bool hasPointOnTheLeft = false;
         bool hasPointOnTheRight = false;
@@ -104,6 +106,11 @@ namespace visilib
                     else
                     {
                         V_ASSERT(position == ON_BOUNDARY);
+                        // A vertex not built on the hyperplane is classified on it by the tolerance only: its sign is not certified
+                        if (aStatistic != nullptr && !MathCombinatorial::hasFacet(aPolyhedron->getFacetsDescription(a), aPlaneID))
+                        {
+                            aStatistic->inc(DEGENERATE_PREDICATE_COUNT);
+                        }
                         myStatus.insert(std::pair<size_t, int>(a, 0));
                         myWait.push_back(a);
                         myQueryList.push_back(a);
@@ -255,7 +262,8 @@ namespace visilib
         // Step 4 - Creation of the edges of the polytope skeleton
 
         // We iterate through all the new extremal stabbing lines, and creates and edge for the myVertices that share at least three common facets and if the edge will not be
-        // degenerated (length 0)
+        // degenerated (length 0). Two vertices classified on the hyperplane by the tolerance can share the same facets description: their edge is created anyway,
+        // and is merged by removeCollapsedEdges
         for (size_t m = 0; m < myQueryList.size(); m++)
         {
             for (size_t n = m + 1; n < myQueryList.size(); n++)
@@ -271,15 +279,8 @@ namespace visilib
                     V_ASSERT(Qm != Qn);
                     if (!MathPredicates::isEdgeCollapsed(aPolyhedron->get(Qn), aPolyhedron->get(Qm), tolerance))
                     {
-                        if (facetsQm.size() != facetsQn.size() || !std::equal(facetsQm.begin(), facetsQm.end(), facetsQn.begin()))
-                        {
                         aLeft->addEdge(Qm, Qn, aPolyhedron);
                         aRight->addEdge(Qm, Qn, aPolyhedron);
-                        }
-                        else
-                        {
-                            V_ASSERT(0);
-                        }
                     }
                 }
             }
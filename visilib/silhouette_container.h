@@ -20,13 +20,26 @@ along with Visilib. If not, see <http://www.gnu.org/licenses/>
 
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <limits>
 #include <vector>
 #include "visilib.h"
+#include "geometry_stabbing_line_hull.h"
+#include "geometry_triangle_packet.h"
 #include "math_vector_2.h"
 #include "math_vector_3.h"
 namespace visilib
 {
 
+/** @brief A silhouette hit by a ray, with the nearest of its faces hit by the ray*/
+struct SilhouetteHit
+{
+    Silhouette* mSilhouette;
+    size_t mFaceIndex;
+    float mDistance;
+};
+
  /** @brief
    Store a set of silhouettes, representing occluder surfaces as seen from the sources. The silhouettes are used to compute ray intersection during visibility computation.
 */
@@ -35,10 +48,11 @@ class SilhouetteContainer
 {
 public:
     SilhouetteContainer()
+        : mIsPrepared(false)
     {
     }
 
-    ~SilhouetteContainer()
+    virtual ~SilhouetteContainer()
     {
         for (auto s : mSilhouettes)
             delete s;
@@ -52,7 +66,10 @@ public:
     void addSilhouette(Silhouette* aSilhouette)
     {
         if (mSilhouettes.find(aSilhouette) == mSilhouettes.end())
+        {
             mSilhouettes.insert(aSilhouette);
+            mIsPrepared = false;
+        }
     }
 
     virtual bool intersect(VisibilityRay* aRay, double aDistance = 0)
@@ -60,6 +77,29 @@ public:
         GeometryRay myGeometryRay(*aRay);
 
         bool hasIntersection = false;
+        if (aDistance == 0.0 && mIsPrepared)
+        {
+            // As below, only the first face hit in each silhouette is reported: the faces of a silhouette are contiguous in the packets
+            size_t myLastSilhouette = mPacketSilhouettes.size();
+            float myDistances[GeometryTrianglePacket::WIDTH];
+            for (size_t i = 0; i < mPackets.size(); i++)
+            {
+                const GeometryTrianglePacket& myPacket = mPackets[i];
+                uint32_t myMask = myPacket.intersect(myGeometryRay, aRay->tnear, aRay->tfar, myDistances);
+                for (size_t j = 0; myMask != 0; j++, myMask >>= 1)
+                {
+                    size_t mySilhouette = mPacketSilhouettes[i * GeometryTrianglePacket::WIDTH + j];
+                    if ((myMask & 1) && mySilhouette != myLastSilhouette)
+                    {
+                        aRay->addIntersection(myPacket.getGeometryId(j), myPacket.getFaceIndex(j), myDistances[j]);
+                        myLastSilhouette = mySilhouette;
+                        hasIntersection = true;
+                    }
+                }
+            }
+            return hasIntersection;
+        }
+
         for (auto s : mSilhouettes)
         {
             const auto& myMeshFaces = s->getMeshFaces();
@@ -92,12 +132,159 @@ public:
         return hasIntersection;
     }
 
+    /** @brief Find the distinct silhouettes hit by a ray segment
+
+    Each silhouette is reported once, with the nearest of its faces hit by the ray, and the hits are sorted front to back.
+    The silhouettes are deduplicated during the traversal by marking them with the epoch of the ray, such that no set of faces is built.
+    @param aRay: the ray
+    @param aTnear, aTfar: the distances along the ray bounding the segment
+    @param aHits: receives the silhouettes hit by the ray
+    @return: true if at least one silhouette is hit
+    */
+    virtual bool intersectSilhouettes(const GeometryRay& aRay, float aTnear, float aTfar, std::vector<SilhouetteHit>& aHits)
+    {
+        aHits.clear();
+        if (mIsPrepared)
+        {
+            SilhouetteHitMarks& myMarks = beginSilhouetteHits();
+            float myDistances[GeometryTrianglePacket::WIDTH];
+            for (size_t i = 0; i < mPackets.size(); i++)
+            {
+                const GeometryTrianglePacket& myPacket = mPackets[i];
+                uint32_t myMask = myPacket.intersect(aRay, aTnear, aTfar, myDistances);
+                for (size_t j = 0; myMask != 0; j++, myMask >>= 1)
+                {
+                    if (myMask & 1)
+                    {
+                        addSilhouetteHit(myMarks, mPacketSilhouettes[i * GeometryTrianglePacket::WIDTH + j], myPacket.getFaceIndex(j), myDistances[j], aHits);
+                    }
+                }
+            }
+        }
+        else
+        {
+            for (auto s : mSilhouettes)
+            {
+                SilhouetteHit myHit = { s, 0, std::numeric_limits<float>::infinity() };
+                const auto& myMeshFaces = s->getMeshFaces();
+                for (auto faceIndex : s->getSilhouetteFaces())
+                {
+                    const SilhouetteMeshFace& face = myMeshFaces[faceIndex];
+                    GeometryTrianglePacket_<1> myFace;
+                    myFace.add(face.getVertex(0), face.getVertex(1), face.getVertex(2), s->getGeometryId(), faceIndex);
+
+                    float myDistance;
+                    if (myFace.intersect(aRay, aTnear, aTfar, &myDistance) != 0 && myDistance < myHit.mDistance)
+                    {
+                        myHit.mFaceIndex = faceIndex;
+                        myHit.mDistance = myDistance;
+                    }
+                }
+                if (myHit.mDistance != std::numeric_limits<float>::infinity())
+                {
+                    aHits.push_back(myHit);
+                }
+            }
+        }
+
+        std::sort(aHits.begin(), aHits.end(), [](const SilhouetteHit& a, const SilhouetteHit& b)
+            {
+                return a.mDistance < b.mDistance;
+            });
+        return !aHits.empty();
+    }
+
+    /** @brief Collect the faces of the silhouettes that may intersect the hull of the lines of a polytope
+
+    @param aHull: the hull of the extremal stabbing lines of the polytope
+    @param aResult: the ray collecting the intersected faces
+    @return: true if at least one face may intersect the hull
+    */
+    virtual bool intersectHull(const GeometryStabbingLineHull& aHull, VisibilityRay* aResult)
+    {
+        bool hasIntersection = false;
+        for (auto s : mSilhouettes)
+        {
+            const auto& myMeshFaces = s->getMeshFaces();
+            for (auto faceIndex : s->getSilhouetteFaces())
+            {
+                const SilhouetteMeshFace& face = myMeshFaces[faceIndex];
+                if (aHull.intersects(face.getVertex(0), face.getVertex(1), face.getVertex(2)))
+                {
+                    aResult->addIntersection(s->getGeometryId(), faceIndex, 0.0);
+                    hasIntersection = true;
+                }
+            }
+        }
+        return hasIntersection;
+    }
+
+    /** @brief Intersect a packet of rays with the silhouettes in a single traversal
+
+    Each face of the silhouettes is loaded once and tested against all the rays of the packet. A face hit by at least one ray is reported once in aResult.
+    @param aRays: the rays of the packet
+    @param aResult: the ray collecting the intersected faces
+    @return: true if at least one face is hit by one of the rays
+    */
+    virtual bool intersectPacket(const std::vector<GeometryRay>& aRays, VisibilityRay* aResult)
+    {
+        bool hasIntersection = false;
+        if (mIsPrepared)
+        {
+            const float myInfinity = std::numeric_limits<float>::infinity();
+            for (const GeometryTrianglePacket& myPacket : mPackets)
+            {
+                uint32_t myMask = 0;
+                for (size_t i = 0; i < aRays.size() && myMask != (1u << myPacket.getCount()) - 1; i++)
+                {
+                    myMask |= myPacket.intersect(aRays[i], -myInfinity, myInfinity);
+                }
+                for (size_t j = 0; myMask != 0; j++, myMask >>= 1)
+                {
+                    if (myMask & 1)
+                    {
+                        aResult->addIntersection(myPacket.getGeometryId(j), myPacket.getFaceIndex(j), 0.0);
+                        hasIntersection = true;
+                    }
+                }
+            }
+            return hasIntersection;
+        }
+
+        for (auto s : mSilhouettes)
+        {
+            const auto& myMeshFaces = s->getMeshFaces();
+            for (auto faceIndex : s->getSilhouetteFaces())
+            {
+                const SilhouetteMeshFace& face = myMeshFaces[faceIndex];
+                const MathVector3f& v0 = face.getVertex(0);
+                const MathVector3f& v1 = face.getVertex(1);
+                const MathVector3f& v2 = face.getVertex(2);
+
+                for (const GeometryRay& myRay : aRays)
+                {
+                    if (MathGeometry::hitsTriangle<float>(myRay, v0, v1, v2))
+                    {
+                        aResult->addIntersection(s->getGeometryId(), faceIndex, 0.0);
+                        hasIntersection = true;
+                        break;
+                    }
+                }
+            }
+        }
+        return hasIntersection;
+    }
+
+    /** @brief Return true if all the lines of a polytope are blocked by one of the silhouettes, tested against the representative lines of the polytope
+
+    The silhouettes and the lines are given as slices, such that they can be shared between the nodes of the occlusion tree without copy.
+    */
     template<class P, class S>
-    static bool isOccluded(PluckerPolytope<P>* polytope, PluckerPolyhedron<P>* polyhedron, const std::vector <Silhouette*>& aSilhouettes, const std::vector<P>& polytopeLines, S myTolerance)
+    static bool isOccluded(PluckerPolytope<P>* polytope, PluckerPolyhedron<P>* polyhedron, Silhouette* const* aSilhouettes, size_t aSilhouetteCount, const P* aPolytopeLines, size_t aLineCount, S myTolerance)
     {
-        for (auto iter = aSilhouettes.begin(); iter != aSilhouettes.end(); iter++)
+        for (size_t i = 0; i < aSilhouetteCount; i++)
         {
-            Silhouette* s = (*iter);
+            Silhouette* s = aSilhouettes[i];
             const auto& edgesProcessed = s->getEdgesProcessed();
 
             if (s->getAvailableEdgeCount() == 0)
@@ -106,15 +293,15 @@ public:
 
                 for (size_t edgeIndex : edgesProcessed)
                 {
-                    SilhouetteEdge silhouetteEdge = s->getEdge(edgeIndex);
+                    const SilhouetteEdge& silhouetteEdge = s->getEdge(edgeIndex);
                     size_t hyperplaneIndex = silhouetteEdge.mHyperPlaneIndex;
                     V_ASSERT(hyperplaneIndex > 0);
 
                     const P& myHyperplane = polyhedron->get(hyperplaneIndex);
 
-                    for (auto line : polytopeLines)
+                    for (size_t j = 0; j < aLineCount; j++)
                     {
-                        GeometryPositionType position = MathPredicates::getVertexPlaneRelativePosition(myHyperplane, line, myTolerance);
+                        GeometryPositionType position = MathPredicates::getVertexPlaneRelativePosition(myHyperplane, aPolytopeLines[j], myTolerance);
                         if (position != ON_NEGATIVE_SIDE)
                         {
                             allAreBlocked = false;
@@ -132,9 +319,91 @@ public:
         return false;
     }
 
-    virtual void prepare() {};
+    /** @brief Prepare the silhouettes before ray tracing
+
+    The faces of the silhouettes are copied in packets of triangles, the faces of a silhouette being contiguous
+    */
+    virtual void prepare()
+    {
+        mPackets.clear();
+        mPacketSilhouettes.clear();
+
+        size_t mySilhouetteIndex = 0;
+        for (auto s : indexSilhouettes())
+        {
+            const auto& myMeshFaces = s->getMeshFaces();
+            for (auto faceIndex : s->getSilhouetteFaces())
+            {
+                if (mPackets.empty() || mPackets.back().isFull())
+                {
+                    mPackets.push_back(GeometryTrianglePacket());
+                    mPacketSilhouettes.resize(mPackets.size() * GeometryTrianglePacket::WIDTH, 0);
+                }
+                const SilhouetteMeshFace& face = myMeshFaces[faceIndex];
+                mPacketSilhouettes[(mPackets.size() - 1) * GeometryTrianglePacket::WIDTH + mPackets.back().getCount()] = mySilhouetteIndex;
+                mPackets.back().add(face.getVertex(0), face.getVertex(1), face.getVertex(2), s->getGeometryId(), faceIndex);
+            }
+            mySilhouetteIndex++;
+        }
+        mIsPrepared = true;
+    }
+protected:
+    /** @brief The silhouettes already hit by a ray: a silhouette is hit if its epoch is the epoch of the ray*/
+    struct SilhouetteHitMarks
+    {
+        std::vector<uint32_t> mEpochs;      /**< @brief The epoch of the last ray that hit each silhouette*/
+        std::vector<uint32_t> mSlots;       /**< @brief The position of the hit of each silhouette in the hits of the ray*/
+        uint32_t mEpoch = 0;
+    };
+
+    /** @brief Store the silhouettes in an array, whose indices identify the silhouettes in the hits of the rays*/
+    const std::vector<Silhouette*>& indexSilhouettes()
+    {
+        mSilhouetteArray.assign(mSilhouettes.begin(), mSilhouettes.end());
+        return mSilhouetteArray;
+    }
+
+    /** @brief Start the hits of a ray, returning the marks of the current thread*/
+    SilhouetteHitMarks& beginSilhouetteHits() const
+    {
+        static thread_local SilhouetteHitMarks myMarks;
+
+        if (myMarks.mEpochs.size() < mSilhouetteArray.size())
+        {
+            myMarks.mEpochs.resize(mSilhouetteArray.size(), 0);
+            myMarks.mSlots.resize(mSilhouetteArray.size(), 0);
+        }
+        if (++myMarks.mEpoch == 0)
+        {
+            std::fill(myMarks.mEpochs.begin(), myMarks.mEpochs.end(), 0);
+            myMarks.mEpoch = 1;
+        }
+        return myMarks;
+    }
+
+    /** @brief Add the hit of a face of a silhouette (index in indexSilhouettes()), keeping only the nearest face of each silhouette*/
+    void addSilhouetteHit(SilhouetteHitMarks& aMarks, size_t aSilhouette, size_t aFaceIndex, float aDistance, std::vector<SilhouetteHit>& aHits) const
+    {
+        if (aMarks.mEpochs[aSilhouette] != aMarks.mEpoch)
+        {
+            aMarks.mEpochs[aSilhouette] = aMarks.mEpoch;
+            aMarks.mSlots[aSilhouette] = (uint32_t)aHits.size();
+            SilhouetteHit myHit = { mSilhouetteArray[aSilhouette], aFaceIndex, aDistance };
+            aHits.push_back(myHit);
+        }
+        else if (aDistance < aHits[aMarks.mSlots[aSilhouette]].mDistance)
+        {
+            aHits[aMarks.mSlots[aSilhouette]].mFaceIndex = aFaceIndex;
+            aHits[aMarks.mSlots[aSilhouette]].mDistance = aDistance;
+        }
+    }
+
 private:
     std::unordered_set<Silhouette*> mSilhouettes;
+    std::vector<Silhouette*> mSilhouetteArray;     /**< @brief The silhouettes indexed by the last prepare()*/
+    std::vector<GeometryTrianglePacket> mPackets;   /**< @brief The faces of the silhouettes, filled by prepare()*/
+    std::vector<size_t> mPacketSilhouettes;         /**< @brief The index of the silhouette of each lane of the packets*/
+    bool mIsPrepared;
 };
 }
 
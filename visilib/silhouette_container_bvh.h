@@ -0,0 +1,312 @@
+/*
+Visilib, an open source library for exact visibility computation.
+Copyright(C) 2021 by Denis Haumont
+
+This file is part of Visilib.
+
+Visilib is free software : you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Visilib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Visilib. If not, see <http://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "geometry_occluder_set.h"
+#include "geometry_triangle_bvh.h"
+#include "silhouette_container.h"
+
+namespace visilib
+{
+    /** @brief Represents a set of silhouettes, using a built-in bounding volume hierarchy to perform ray-tracing against those silhouettes.
+
+    When the container is given the occluder set of the query, the rays traverse the BVH of all the faces of the scene (GeometryOccluderSet::getBvh()),
+    built once for all the queries: prepare() only marks the face ids of the faces of the silhouettes, and the faces that are not marked are ignored.
+    Otherwise, or if the BVH of the scene is not up to date (GeometryOccluderSet::updateBvh()), prepare() builds a GeometryTriangleBvh of the faces of the silhouettes.
+    The BVH of the scene is only read, such that the queries of several threads can share it.
+    As the container of Embree, the rays report at most one face per silhouette. The class has no dependency on an external library.
+    */
+
+    class SilhouetteContainerBvh : public SilhouetteContainer
+    {
+    public:
+        /** @brief Create the container
+
+        @param aScene: the occluder set whose BVH is shared by the queries, or nullptr to build a BVH of the silhouettes in prepare()
+        */
+        SilhouetteContainerBvh(const GeometryOccluderSet* aScene = nullptr);
+
+        /** @brief Intersect the ray with the silhouettes, reporting the first face found in each silhouette hit by the ray*/
+        virtual bool intersect(VisibilityRay* aRay, double aDistance = 0) override;
+
+        virtual bool intersectSilhouettes(const GeometryRay& aRay, float aTnear, float aTfar, std::vector<SilhouetteHit>& aHits) override;
+
+        virtual bool intersectHull(const GeometryStabbingLineHull& aHull, VisibilityRay* aResult) override;
+
+        virtual bool intersectPacket(const std::vector<GeometryRay>& aRays, VisibilityRay* aResult) override;
+
+        /** @brief Mark the faces of the silhouettes in the BVH of the scene, or build the BVH of the faces of the silhouettes*/
+        virtual void prepare() override;
+
+        size_t getNodeCount() const
+        {
+            return mBvh == nullptr ? 0 : mBvh->getNodeCount();
+        }
+
+    private:
+        bool isSceneBvh() const
+        {
+            return mBvh != &mSilhouetteBvh;
+        }
+
+        /** @brief Return the mask of the lanes of a packet of the BVH containing a face of a silhouette*/
+        uint32_t getActiveLanes(size_t aPacket) const
+        {
+            const GeometryTrianglePacket& myPacket = mBvh->getPacket(aPacket);
+            if (!isSceneBvh())
+            {
+                return (uint32_t)((1ull << myPacket.getCount()) - 1);
+            }
+
+            uint32_t myMask = 0;
+            for (size_t j = 0; j < myPacket.getCount(); j++)
+            {
+                size_t myFaceId = mBvh->getKey(aPacket, j);
+                myMask |= (uint32_t)((mActiveFaces[myFaceId >> 6] >> (myFaceId & 63)) & 1) << j;
+            }
+            return myMask;
+        }
+
+        /** @brief Return the index of the silhouette containing the face of an active lane of a packet of the BVH*/
+        size_t getSilhouetteIndex(size_t aPacket, size_t aLane) const
+        {
+            size_t myKey = mBvh->getKey(aPacket, aLane);
+            if (!isSceneBvh())
+            {
+                return myKey;
+            }
+            V_ASSERT((mActiveFaces[myKey >> 6] >> (myKey & 63)) & 1);
+            return mFaceSilhouettes[myKey];
+        }
+
+        const GeometryOccluderSet* mScene;
+        const GeometryTriangleBvh* mBvh;                            /**< @brief The BVH traversed by the rays, either the one of the scene or mSilhouetteBvh*/
+        GeometryTriangleBvh mSilhouetteBvh;                         /**< @brief The BVH of the faces of the silhouettes, keyed by the index of their silhouette*/
+        std::vector<uint64_t> mActiveFaces;                         /**< @brief The bitset of the face ids of the scene belonging to a silhouette*/
+        std::vector<uint32_t> mFaceSilhouettes;                     /**< @brief The index of the silhouette of each face id, only valid for the active face ids*/
+        std::vector<size_t> mActiveFaceIds;                         /**< @brief The face ids marked in mActiveFaces*/
+    };
+
+    inline SilhouetteContainerBvh::SilhouetteContainerBvh(const GeometryOccluderSet* aScene)
+        : SilhouetteContainer(),
+        mScene(aScene),
+        mBvh(nullptr)
+    {
+    }
+
+    inline void SilhouetteContainerBvh::prepare()
+    {
+        if (mScene != nullptr && mScene->isBvhUpToDate())
+        {
+            mBvh = &mScene->getBvh();
+
+            // Only the face ids marked by the last call are cleared, such that the cost does not depend on the size of the scene
+            if (mFaceSilhouettes.size() != mScene->getFaceIdCount())
+            {
+                mActiveFaces.assign((mScene->getFaceIdCount() + 63) / 64, 0);
+                mFaceSilhouettes.resize(mScene->getFaceIdCount());
+            }
+            else
+            {
+                for (size_t myFaceId : mActiveFaceIds)
+                {
+                    mActiveFaces[myFaceId >> 6] = 0;
+                }
+            }
+            mActiveFaceIds.clear();
+
+            size_t mySilhouetteIndex = 0;
+            for (auto s : indexSilhouettes())
+            {
+                for (auto faceIndex : s->getSilhouetteFaces())
+                {
+                    size_t myFaceId = mScene->getFaceId(s->getGeometryId(), faceIndex);
+                    mActiveFaces[myFaceId >> 6] |= 1ull << (myFaceId & 63);
+                    mFaceSilhouettes[myFaceId] = (uint32_t)mySilhouetteIndex;
+                    mActiveFaceIds.push_back(myFaceId);
+                }
+                mySilhouetteIndex++;
+            }
+            return;
+        }
+
+        mSilhouetteBvh.clear();
+        size_t mySilhouetteIndex = 0;
+        for (auto s : indexSilhouettes())
+        {
+            const auto& myMeshFaces = s->getMeshFaces();
+            for (auto faceIndex : s->getSilhouetteFaces())
+            {
+                const SilhouetteMeshFace& face = myMeshFaces[faceIndex];
+                mSilhouetteBvh.addTriangle(face.getVertex(0), face.getVertex(1), face.getVertex(2), s->getGeometryId(), faceIndex, mySilhouetteIndex);
+            }
+            mySilhouetteIndex++;
+        }
+        mSilhouetteBvh.build();
+        mBvh = &mSilhouetteBvh;
+    }
+
+    inline bool SilhouetteContainerBvh::intersect(VisibilityRay* aRay, double aDistance)
+    {
+        if (aDistance != 0.0 || mBvh == nullptr)
+        {
+            return SilhouetteContainer::intersect(aRay, aDistance);
+        }
+
+        GeometryRay myRay(*aRay);
+
+        // The silhouettes already reported by the ray are marked, as the hit list of Embree
+        SilhouetteHitMarks& myMarks = beginSilhouetteHits();
+        bool hasIntersection = false;
+        float myDistances[GeometryTrianglePacket::WIDTH];
+
+        mBvh->traverse(myRay, aRay->tnear, aRay->tfar, [&](size_t aPacket)
+            {
+                uint32_t myActive = getActiveLanes(aPacket);
+                if (myActive == 0)
+                {
+                    return true;
+                }
+                const GeometryTrianglePacket& myPacket = mBvh->getPacket(aPacket);
+                uint32_t myMask = myPacket.intersect(myRay, aRay->tnear, aRay->tfar, myDistances) & myActive;
+                for (size_t j = 0; myMask != 0; j++, myMask >>= 1)
+                {
+                    if ((myMask & 1) == 0)
+                    {
+                        continue;
+                    }
+                    size_t mySilhouette = getSilhouetteIndex(aPacket, j);
+                    if (myMarks.mEpochs[mySilhouette] != myMarks.mEpoch)
+                    {
+                        myMarks.mEpochs[mySilhouette] = myMarks.mEpoch;
+                        aRay->addIntersection(myPacket.getGeometryId(j), myPacket.getFaceIndex(j), myDistances[j]);
+                        hasIntersection = true;
+                    }
+                }
+                return true;
+            });
+
+        return hasIntersection;
+    }
+
+    inline bool SilhouetteContainerBvh::intersectSilhouettes(const GeometryRay& aRay, float aTnear, float aTfar, std::vector<SilhouetteHit>& aHits)
+    {
+        if (mBvh == nullptr)
+        {
+            return SilhouetteContainer::intersectSilhouettes(aRay, aTnear, aTfar, aHits);
+        }
+
+        aHits.clear();
+        SilhouetteHitMarks& myMarks = beginSilhouetteHits();
+        float myDistances[GeometryTrianglePacket::WIDTH];
+
+        mBvh->traverse(aRay, aTnear, aTfar, [&](size_t aPacket)
+            {
+                uint32_t myActive = getActiveLanes(aPacket);
+                if (myActive == 0)
+                {
+                    return true;
+                }
+                const GeometryTrianglePacket& myPacket = mBvh->getPacket(aPacket);
+                uint32_t myMask = myPacket.intersect(aRay, aTnear, aTfar, myDistances) & myActive;
+                for (size_t j = 0; myMask != 0; j++, myMask >>= 1)
+                {
+                    if (myMask & 1)
+                    {
+                        addSilhouetteHit(myMarks, getSilhouetteIndex(aPacket, j), myPacket.getFaceIndex(j), myDistances[j], aHits);
+                    }
+                }
+                return true;
+            });
+
+        std::sort(aHits.begin(), aHits.end(), [](const SilhouetteHit& a, const SilhouetteHit& b)
+            {
+                return a.mDistance < b.mDistance;
+            });
+        return !aHits.empty();
+    }
+
+    inline bool SilhouetteContainerBvh::intersectPacket(const std::vector<GeometryRay>& aRays, VisibilityRay* aResult)
+    {
+        if (mBvh == nullptr)
+        {
+            return SilhouetteContainer::intersectPacket(aRays, aResult);
+        }
+
+        const float myInfinity = std::numeric_limits<float>::infinity();
+
+        // A single traversal visits once each leaf hit by a ray of the packet: its lanes hit by at least one ray are reported once
+        bool hasIntersection = false;
+        mBvh->traverse(aRays, -myInfinity, myInfinity, [&](size_t aPacket)
+            {
+                uint32_t myActive = getActiveLanes(aPacket);
+                const GeometryTrianglePacket& myPacket = mBvh->getPacket(aPacket);
+                uint32_t myMask = 0;
+                for (size_t i = 0; i < aRays.size() && myMask != myActive; i++)
+                {
+                    myMask |= myPacket.intersect(aRays[i], -myInfinity, myInfinity) & myActive;
+                }
+                for (size_t j = 0; myMask != 0; j++, myMask >>= 1)
+                {
+                    if (myMask & 1)
+                    {
+                        aResult->addIntersection(myPacket.getGeometryId(j), myPacket.getFaceIndex(j), 0.0);
+                        hasIntersection = true;
+                    }
+                }
+                return true;
+            });
+        return hasIntersection;
+    }
+
+    inline bool SilhouetteContainerBvh::intersectHull(const GeometryStabbingLineHull& aHull, VisibilityRay* aResult)
+    {
+        if (mBvh == nullptr)
+        {
+            return SilhouetteContainer::intersectHull(aHull, aResult);
+        }
+
+        bool hasIntersection = false;
+        mBvh->traverse([&](const MathVector3f& aMin, const MathVector3f& aMax)
+            {
+                return aHull.intersects(aMin, aMax);
+            },
+            [&](size_t aPacket)
+            {
+                const GeometryTrianglePacket& myPacket = mBvh->getPacket(aPacket);
+                uint32_t myActive = getActiveLanes(aPacket);
+                for (size_t j = 0; j < myPacket.getCount(); j++)
+                {
+                    if (((myActive >> j) & 1) && aHull.intersects(myPacket.getVertex(j, 0), myPacket.getVertex(j, 1), myPacket.getVertex(j, 2)))
+                    {
+                        aResult->addIntersection(myPacket.getGeometryId(j), myPacket.getFaceIndex(j), 0.0);
+                        hasIntersection = true;
+                    }
+                }
+            });
+        return hasIntersection;
+    }
+}
@@ -22,6 +22,10 @@ along with Visilib. If not, see <http://www.gnu.org/licenses/>
 
 #ifdef EMBREE
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
 #include "embree3/rtcore.h"
 #include "embree3/rtcore_ray.h"
 #include "helper_triangle_mesh_container.h"
@@ -45,19 +49,25 @@ namespace visilib
 
         The function calls embree to perform the intersection
         */
-        virtual bool intersect(VisibilityRay* aRay) override;
+        virtual bool intersect(VisibilityRay* aRay, double aDistance = 0) override;
+
+        /** @brief Intersect the ray segment with the silhouettes, reporting the nearest face hit in each silhouette
 
+        The filter function of the faces records every hit along the segment and rejects it, such that Embree reports all the hits
+        */
+        virtual bool intersectSilhouettes(const GeometryRay& aRay, float aTnear, float aTfar, std::vector<SilhouetteHit>& aHits) override;
 
         /** @brief Prepare the scene before ray tracing
 
         The function commits the scene geometry to embree
         */
-        virtual void prepare();
+        virtual void prepare() override;
     private:
 
         RTCScene mScene;            /**< @brief The Embree scene*/
         static RTCDevice mDevice;   /**< @brief The Embree device*/
         std::unordered_map<unsigned int, std::pair<size_t, size_t>> ids;
+        std::unordered_map<unsigned int, size_t> mSilhouetteIndices;    /**< @brief The index of the silhouette of each Embree geometry (indexSilhouettes())*/
     };
 
     inline SilhouetteContainerEmbree::SilhouetteContainerEmbree()
@@ -101,6 +111,7 @@ namespace visilib
     {
         RTCIntersectContext context;
         GeometryRayMultiHit* ray;
+        std::vector<std::pair<unsigned int, float>>* hits;     /**< @brief If not nullptr, receives the geometry and the distance of all the hits*/
     };
 
     inline RTCRayHit* RTCRayHit_(GeometryRayMultiHit& ray)
@@ -131,6 +142,14 @@ namespace visilib
         GeometryIntersectContextMultiHit* context = (GeometryIntersectContextMultiHit*)args->context;
         GeometryRayMultiHit* ray = context->ray;
 
+        if (context->hits != nullptr)
+        {
+            /* store all the hits with their distance, the duplicates being merged by the caller */
+            context->hits->push_back(std::make_pair(hit->geomID, RTCRayN_tfar(args->ray, args->N, 0)));
+            valid[0] = 0;
+            return;
+        }
+
         for (unsigned int i = ray->firstHit; i < ray->lastHit; i++)
         {
             unsigned slot = i % HIT_LIST_LENGTH;
@@ -147,8 +166,13 @@ namespace visilib
 
         valid[0] = 0;
   }
-    inline bool SilhouetteContainerEmbree::intersect(VisibilityRay* aRay)
+    inline bool SilhouetteContainerEmbree::intersect(VisibilityRay* aRay, double aDistance)
     {
+        if (aDistance != 0.0)
+        {
+            return SilhouetteContainer::intersect(aRay, aDistance);
+        }
+
         GeometryRayMultiHit ray;
         ray.firstHit = 0;
         ray.lastHit = 0;
@@ -164,6 +188,8 @@ namespace visilib
         GeometryIntersectContextMultiHit context;
         rtcInitIntersectContext(&context.context);
 
+        context.hits = nullptr;
+
         while (true)
         {
             context.ray = &ray;
@@ -179,9 +205,58 @@ namespace visilib
         return ray.lastHit > ray.firstHit;
      }
 
+    inline bool SilhouetteContainerEmbree::intersectSilhouettes(const GeometryRay& aRay, float aTnear, float aTfar, std::vector<SilhouetteHit>& aHits)
+    {
+        aHits.clear();
+
+        const MathVector3f& myStart = aRay.getStart();
+        const MathVector3f& myDirection = aRay.getDirection();
+
+        GeometryRayMultiHit ray;
+        ray.firstHit = 0;
+        ray.lastHit = 0;
+        ray.rayHit.ray.org_x = myStart.x;  ray.rayHit.ray.org_y = myStart.y; ray.rayHit.ray.org_z = myStart.z;
+        ray.rayHit.ray.dir_x = myDirection.x;  ray.rayHit.ray.dir_y = myDirection.y; ray.rayHit.ray.dir_z = myDirection.z;
+        ray.rayHit.ray.tnear = aTnear;
+        ray.rayHit.ray.tfar = aTfar;
+        ray.rayHit.ray.mask = -1;
+        ray.rayHit.ray.time = 0;
+        ray.rayHit.ray.id = 0;
+
+        ray.rayHit.hit.geomID = RTC_INVALID_GEOMETRY_ID;
+        GeometryIntersectContextMultiHit context;
+        rtcInitIntersectContext(&context.context);
+
+        static thread_local std::vector<std::pair<unsigned int, float>> myHits;
+        myHits.clear();
+        context.hits = &myHits;
+
+        // The filter rejects all the hits: the loop ends after the first call, once Embree has reported all of them
+        while (true)
+        {
+            context.ray = &ray;
+            rtcIntersect1(mScene, &context.context, RTCRayHit_(ray));
+            if (ray.rayHit.hit.geomID == RTC_INVALID_GEOMETRY_ID)
+                break;
+        }
+
+        SilhouetteHitMarks& myMarks = beginSilhouetteHits();
+        for (const auto& myHit : myHits)
+        {
+            addSilhouetteHit(myMarks, mSilhouetteIndices[myHit.first], ids[myHit.first].second, myHit.second, aHits);
+        }
+
+        std::sort(aHits.begin(), aHits.end(), [](const SilhouetteHit& a, const SilhouetteHit& b)
+            {
+                return a.mDistance < b.mDistance;
+            });
+        return !aHits.empty();
+    }
+
     inline void SilhouetteContainerEmbree::prepare()
     {
-        for (auto s:getSilhouettes())
+        size_t mySilhouetteIndex = 0;
+        for (auto s : indexSilhouettes())
         {
             size_t id = s->getGeometryId();
             const auto& myMeshFaces = s->getMeshFaces();
@@ -218,8 +293,10 @@ namespace visilib
                 rtcCommitGeometry(mesh);
                 unsigned int geomID = rtcAttachGeometry(mScene, mesh);
                 ids[geomID] = std::pair<size_t, size_t>(id, faceIndex);
+                mSilhouetteIndices[geomID] = mySilhouetteIndex;
                 rtcReleaseGeometry(mesh);
             }
+            mySilhouetteIndex++;
         }
 
         rtcCommitScene(mScene);
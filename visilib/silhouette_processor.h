@@ -73,8 +73,13 @@ namespace visilib
         Silhouette* findSilhouette(SilhouetteMeshFace* face)
         {
             auto iter = mSilhouetteCache.find(face);
-
-            return iter == mSilhouetteCache.end() ? nullptr : iter->second;
+            if (iter == mSilhouetteCache.end())
+            {
+                mHelperStatisticCollector->inc(SILHOUETTE_CACHE_MISS);
+                return nullptr;
+            }
+            mHelperStatisticCollector->inc(SILHOUETTE_CACHE_HIT);
+            return iter->second;
         }
 
     private:
@@ -139,7 +144,11 @@ namespace visilib
     {
         auto iter = mPolygonBetweenSourcePlanesCache.find(face);
         if (iter != mPolygonBetweenSourcePlanesCache.end())
+        {
+            mHelperStatisticCollector->inc(SOURCE_PLANES_CACHE_HIT);
             return iter->second;
+        }
+        mHelperStatisticCollector->inc(SOURCE_PLANES_CACHE_MISS);
 
         bool inside = true;
 
@@ -166,7 +175,11 @@ namespace visilib
         size_t key = getKey(face0, face1);
         auto iter = mPotentialSilhouetteEdgeCache.find(key);
         if (iter != mPotentialSilhouetteEdgeCache.end())
+        {
+            mHelperStatisticCollector->inc(SILHOUETTE_EDGE_CACHE_HIT);
             return iter->second;
+        }
+        mHelperStatisticCollector->inc(SILHOUETTE_EDGE_CACHE_MISS);
 
         bool result = isPotentialSilhouetteEdgeInternal(face0, face1);
         mPotentialSilhouetteEdgeCache.insert(std::pair<size_t, bool>(key, result));
@@ -242,7 +255,7 @@ namespace visilib
                 V_ASSERT(!processed[myIndex]);
                 processed[myIndex] = true;
                 SilhouetteMeshFace* face = const_cast<SilhouetteMeshFace*>(&meshFaces[myIndex]);
-                V_ASSERT(findSilhouette(face) == nullptr);
+                V_ASSERT(mSilhouetteCache.find(face) == mSilhouetteCache.end());
 
                 if (mConvexHull != nullptr)
                 {
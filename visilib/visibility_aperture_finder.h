@@ -58,7 +58,44 @@ namespace visilib
 
         VisibilityResult resolve();
     private:
-        VisibilityResult resolveInternal(VisibilityResult& aGlobalResult, PluckerPolytope<P>* aPolytope, const std::string& occlusionTreeNodeSymbol, const std::vector<Silhouette*>& anOccluders, const std::vector<P>& aPolytopeLines, int depth);
+        /** @brief A node of the occlusion tree stored in the explicit traversal stack.
+
+        The occluders and the representative lines of a node are slices of the occluder and line stacks of the solver: a node either references
+        the slice of its parent, or owns the slice appended on top of the stacks by collectAllOccluders. The slices are popped with the node.
+        */
+        struct OcclusionTreeNode
+        {
+            PluckerPolytope<P>* mPolytope;                  /**< @brief The polytope of the node*/
+            size_t mOccluderBegin;                          /**< @brief The first occluder inherited from the parent node*/
+            size_t mOccluderEnd;                            /**< @brief The end of the occluders inherited from the parent node*/
+            size_t mLineBegin;                              /**< @brief The first representative line inherited from the parent node*/
+            size_t mLineEnd;                                /**< @brief The end of the representative lines inherited from the parent node*/
+            size_t mOccluderTop;                            /**< @brief The size of the occluder stack when the node has been pushed*/
+            size_t mLineTop;                                /**< @brief The size of the line stack when the node has been pushed*/
+            bool mIsProcessed;                              /**< @brief The polytope of the node has been processed, only its children remain to be traversed*/
+            Silhouette* mSilhouette;                        /**< @brief The silhouette of the edge deactivated by the node, null if no edge was found*/
+            size_t mSilhouetteEdgeIndex;                    /**< @brief The index of the deactivated edge in its silhouette*/
+            PluckerPolytope<P>* mChildren[2];               /**< @brief The polytopes of the children nodes*/
+            bool mReuseOccluders[2];                        /**< @brief The children nodes inherit the occluders of the node*/
+            bool mPushEdgeProcessed[2];                     /**< @brief The deactivated edge is a processed edge of its silhouette in the children nodes*/
+            size_t mChildOccluderBegin;                     /**< @brief The slice of occluders inherited by the children nodes*/
+            size_t mChildOccluderEnd;
+            size_t mChildLineBegin;                         /**< @brief The slice of representative lines inherited by the children nodes*/
+            size_t mChildLineEnd;
+            size_t mChildCount;                             /**< @brief The number of children nodes*/
+            size_t mNextChild;                              /**< @brief The index of the next child node to be traversed*/
+            bool mOwnsChildren;                             /**< @brief The children polytopes have been created by a split, and are deleted with the node*/
+            bool mHasEdgeProcessed;                         /**< @brief The deactivated edge has been pushed as a processed edge for the current child*/
+#ifdef OUTPUT_DEBUG_FILE
+            std::string mSymbol;                            /**< @brief The symbol of the node in the occlusion tree*/
+            std::string mPostFix[2];                        /**< @brief The postfix of the symbols of the children nodes*/
+#endif
+        };
+
+        VisibilityResult processNode(VisibilityResult& aGlobalResult, OcclusionTreeNode& aNode);
+        void pushNode(PluckerPolytope<P>* aPolytope, size_t anOccluderBegin, size_t anOccluderEnd, size_t aLineBegin, size_t aLineEnd);
+        void popNode();
+        void clearNodes();
         void resize(size_t myInitiaLineCount, PluckerPolyhedron<P>* myPolyhedron, PluckerPolytope<P>* aPolytope);
         void extractStabbingLines(PluckerPolyhedron<P>* myPolyhedron, PluckerPolytope<P>* aPolytope);
 
@@ -66,6 +103,9 @@ namespace visilib
         bool mNormalization;
         bool mDetectApertureOnly;
         S mTolerance;
+        std::vector<OcclusionTreeNode> mNodes;              /**< @brief The traversal stack of the occlusion tree*/
+        std::vector<Silhouette*> mOccluders;                /**< @brief The stack of occluders referenced by the nodes of the traversal stack*/
+        std::vector<P> mLines;                              /**< @brief The stack of representative lines referenced by the nodes of the traversal stack*/
     };
 
     template<class P, class S>
@@ -75,6 +115,9 @@ namespace visilib
         mTolerance(tolerance),
         mDetectApertureOnly(detectApertureOnly)
     {
+        mNodes.reserve(256);
+        mOccluders.reserve(1024);
+        mLines.reserve(256);
     }
 
     template <class P, class S>
@@ -82,37 +125,167 @@ namespace visilib
     {
         VisibilityResult myGlobalResult = HIDDEN;
 
-        resolveInternal(myGlobalResult, reinterpret_cast<PluckerPolytope<P>*>(VisibilitySolver<P, S>::mQuery->getComplex()->getRoot()), "*", std::vector<Silhouette*>(), std::vector<P>(), 0);
+        pushNode(reinterpret_cast<PluckerPolytope<P>*>(VisibilitySolver<P, S>::mQuery->getComplex()->getRoot()), 0, 0, 0, 0);
+#ifdef OUTPUT_DEBUG_FILE
+        mNodes.back().mSymbol = "*";
+#endif
+
+        while (!mNodes.empty())
+        {
+            if (VisibilitySolver<P, S>::mQuery->isCancelled())
+            {
+                clearNodes();
+                return UNKNOWN;
+            }
+
+            OcclusionTreeNode& myNode = mNodes.back();
+
+            if (!myNode.mIsProcessed)
+            {
+                if (processNode(myGlobalResult, myNode) == VISIBLE && mDetectApertureOnly)
+                {
+                    // Early stop - an aperture has been found
+#ifdef OUTPUT_DEBUG_FILE
+                    V_LOG(VisibilitySolver<P, S>::mDebugger->getDebugOutput(), "EARLY STOP - aperture found");
+#endif
+                    clearNodes();
+                    return VISIBLE;
+                }
+            }
+
+            if (myNode.mHasEdgeProcessed)
+            {
+                myNode.mSilhouette->popEdgeProcessed(myNode.mSilhouetteEdgeIndex);
+                myNode.mHasEdgeProcessed = false;
+            }
+
+            if (myNode.mNextChild < myNode.mChildCount)
+            {
+                size_t i = myNode.mNextChild++;
+
+                if (myNode.mPushEdgeProcessed[i])
+                {
+                    myNode.mSilhouette->pushEdgeProcessed(myNode.mSilhouetteEdgeIndex);
+                    myNode.mHasEdgeProcessed = true;
+                }
+
+#ifdef OUTPUT_DEBUG_FILE
+                SilhouetteEdge& myEdge = myNode.mSilhouette->getEdge(myNode.mSilhouetteEdgeIndex);
+                std::stringstream ss;
+                ss << myNode.mSymbol << "|" << myEdge.mFace->getFaceIndex() << "-" << myEdge.mEdgeIndex << myNode.mPostFix[i];
+#endif
+                // The node reference is invalidated by the push
+                if (myNode.mReuseOccluders[i])
+                {
+                    pushNode(myNode.mChildren[i], myNode.mChildOccluderBegin, myNode.mChildOccluderEnd, myNode.mChildLineBegin, myNode.mChildLineEnd);
+                }
+                else
+                {
+                    pushNode(myNode.mChildren[i], 0, 0, 0, 0);
+                }
+#ifdef OUTPUT_DEBUG_FILE
+                mNodes.back().mSymbol = ss.str();
+#endif
+            }
+            else
+            {
+                popNode();
+            }
+        }
 
         return myGlobalResult;
     }
 
     template<class P, class S>
-    VisibilityResult VisibilityApertureFinder<P, S>::resolveInternal(VisibilityResult& aGlobalResult, PluckerPolytope<P>* aPolytope, const std::string& occlusionTreeNodeSymbol, const std::vector<Silhouette*>& anOccluders, const std::vector<P>& aPolytopeLines, int aDepth)
+    void VisibilityApertureFinder<P, S>::pushNode(PluckerPolytope<P>* aPolytope, size_t anOccluderBegin, size_t anOccluderEnd, size_t aLineBegin, size_t aLineEnd)
+    {
+        mNodes.push_back(OcclusionTreeNode());
+        // The traversal stack holds the path from the root: its size is the depth of the node
+        VisibilitySolver<P, S>::mQuery->getStatistic()->updateMax(OCCLUSION_TREE_DEPTH, mNodes.size());
+        VisibilitySolver<P, S>::mQuery->getStatistic()->addToHistogram(TREE_DEPTH_HISTOGRAM, mNodes.size());
+
+        OcclusionTreeNode& myNode = mNodes.back();
+        myNode.mPolytope = aPolytope;
+        myNode.mOccluderBegin = anOccluderBegin;
+        myNode.mOccluderEnd = anOccluderEnd;
+        myNode.mLineBegin = aLineBegin;
+        myNode.mLineEnd = aLineEnd;
+        myNode.mOccluderTop = mOccluders.size();
+        myNode.mLineTop = mLines.size();
+        myNode.mIsProcessed = false;
+        myNode.mSilhouette = nullptr;
+        myNode.mSilhouetteEdgeIndex = 0;
+        myNode.mChildCount = 0;
+        myNode.mNextChild = 0;
+        myNode.mOwnsChildren = false;
+        myNode.mHasEdgeProcessed = false;
+    }
+
+    template<class P, class S>
+    void VisibilityApertureFinder<P, S>::popNode()
+    {
+        OcclusionTreeNode& myNode = mNodes.back();
+
+        if (myNode.mOwnsChildren)
+        {
+            delete myNode.mChildren[0];
+            delete myNode.mChildren[1];
+        }
+
+        // reactivate the edge
+        if (myNode.mSilhouette != nullptr)
+        {
+            VisibilitySolver<P, S>::mQuery->restoreEdge(myNode.mSilhouette, myNode.mSilhouetteEdgeIndex);
+        }
+
+        mOccluders.erase(mOccluders.begin() + myNode.mOccluderTop, mOccluders.end());
+        mLines.erase(mLines.begin() + myNode.mLineTop, mLines.end());
+        mNodes.pop_back();
+    }
+
+    template<class P, class S>
+    void VisibilityApertureFinder<P, S>::clearNodes()
+    {
+        for (auto& myNode : mNodes)
+        {
+            if (myNode.mOwnsChildren)
+            {
+                delete myNode.mChildren[0];
+                delete myNode.mChildren[1];
+            }
+        }
+        mNodes.clear();
+        mOccluders.clear();
+        mLines.clear();
+    }
+
+    template<class P, class S>
+    VisibilityResult VisibilityApertureFinder<P, S>::processNode(VisibilityResult& aGlobalResult, OcclusionTreeNode& aNode)
     {
         PluckerPolyhedron<P>* myPolyhedron = reinterpret_cast<PluckerPolyhedron<P>*> (VisibilitySolver<P, S>::mQuery->getComplex()->getPolyhedron());
-        size_t myInitiaLineCount = myPolyhedron->getLinesCount();
+        PluckerPolytope<P>* aPolytope = aNode.mPolytope;
+        HelperStatisticCollector* myStatistic = VisibilitySolver<P, S>::mQuery->getStatistic();
+
+        aNode.mIsProcessed = true;
 
 #ifdef OUTPUT_DEBUG_FILE
+        const std::string& occlusionTreeNodeSymbol = aNode.mSymbol;
         std::ofstream& debugOutput = VisibilitySolver<P, S>::mDebugger->getDebugOutput();
         V_LOG(debugOutput, "Resolve internal ", occlusionTreeNodeSymbol);
         aPolytope->outputProperties(debugOutput, myPolyhedron);
+#else
+        static const std::string occlusionTreeNodeSymbol;
 #endif
-        if (aDepth > 2000)
-        {
-            std::cerr << "Overflow detected: more than 200 recursive calls...." << std::endl;
-#ifdef OUTPUT_DEBUG_FILE
-            V_LOG(debugOutput, "RESULT FAILURE: Overflow detected : more than 2000 recursive calls....", occlusionTreeNodeSymbol);
-#endif
-            aGlobalResult = FAILURE;
-            return FAILURE;
-        }
         {
             HelperScopedTimer timer(VisibilitySolver<P, S>::mQuery->getStatistic(), STABBING_LINE_EXTRACTION);
             aPolytope->computeEdgesIntersectingQuadric(myPolyhedron, mTolerance);
         }
+        myStatistic->addToHistogram(POLYTOPE_VERTEX_HISTOGRAM, aPolytope->getVertices().size());
+        myStatistic->addToHistogram(POLYTOPE_EDGE_HISTOGRAM, aPolytope->getEdgeCount());
+
         if (!aPolytope->containsRealLines())
         {
+            myStatistic->inc(NO_REAL_LINE_COUNT);
 #ifdef OUTPUT_DEBUG_FILE
             V_LOG(debugOutput, "RESULT HIDDEN: polytope does not contains real line", occlusionTreeNodeSymbol);
 #endif
@@ -121,18 +294,29 @@ namespace visilib
 
         V_ASSERT(aPolytope->isValid(myPolyhedron, mNormalization, mTolerance));
 
-        bool hasRay = false;
-        std::vector<Silhouette*> myOccluders = anOccluders;
-        std::vector<P> polytopeLines = aPolytopeLines;
-        if (myOccluders.empty())
+        size_t myOccluderBegin = aNode.mOccluderBegin;
+        size_t myOccluderEnd = aNode.mOccluderEnd;
+        size_t myLineBegin = aNode.mLineBegin;
+        size_t myLineEnd = aNode.mLineEnd;
+
+        if (myOccluderBegin == myOccluderEnd)
         {
-            if (!VisibilitySolver<P, S>::mQuery->collectAllOccluders(aPolytope, myPolyhedron, myOccluders, polytopeLines))
+            // The occluders and the representative line collected for the polytope are appended on top of the stacks
+            myOccluderBegin = mOccluders.size();
+            myLineBegin = mLines.size();
+
+            bool isOccluded = VisibilitySolver<P, S>::mQuery->collectAllOccluders(aPolytope, myPolyhedron, mOccluders, mLines);
+
+            myOccluderEnd = mOccluders.size();
+            myLineEnd = mLines.size();
+
+            if (!isOccluded)
             {
                 // Early stop - an aperture has been found: the source polygons are mutually visible
 #ifdef OUTPUT_DEBUG_FILE
                 V_LOG(debugOutput, "RAY: IS VISIBLE", occlusionTreeNodeSymbol);
 #endif
-                hasRay = true;
+                myStatistic->inc(APERTURE_FOUND_COUNT);
                 aGlobalResult = VISIBLE;
                 if (mDetectApertureOnly)
                 {
@@ -147,232 +331,170 @@ namespace visilib
             }
         }
 
-{
-        HelperScopedTimer timer(VisibilitySolver<P, S>::mQuery->getStatistic(), OCCLUDER_TREATMENT);
-        if (VisibilitySolver<P, S>::mQuery->isOccluded(aPolytope, myPolyhedron, myOccluders, polytopeLines))
         {
+            HelperScopedTimer timer(VisibilitySolver<P, S>::mQuery->getStatistic(), OCCLUDER_TREATMENT);
+            if (VisibilitySolver<P, S>::mQuery->isOccluded(aPolytope, myPolyhedron, mOccluders.data() + myOccluderBegin, myOccluderEnd - myOccluderBegin, mLines.data() + myLineBegin, myLineEnd - myLineBegin))
+            {
 #ifdef OUTPUT_DEBUG_FILE
-            V_LOG(debugOutput, "COUNT: IS OCCLUDED", occlusionTreeNodeSymbol);
+                V_LOG(debugOutput, "COUNT: IS OCCLUDED", occlusionTreeNodeSymbol);
 #endif
-            return HIDDEN;
-        }
-        else
-        {
+                myStatistic->inc(OCCLUDED_POLYTOPE_COUNT);
+                return HIDDEN;
+            }
+            else
+            {
 #ifdef OUTPUT_DEBUG_FILE
-            V_LOG(debugOutput, "COUNT: maybe VISIBLE", occlusionTreeNodeSymbol);
+                V_LOG(debugOutput, "COUNT: maybe VISIBLE", occlusionTreeNodeSymbol);
 #endif
-
+            }
         }
-}
+
         Silhouette* mySilhouette = nullptr;
         size_t mySilhouetteEdgeIndex = 0;
 
-        bool hasEdge = false;
-        bool isVisible = false;
-        hasEdge = VisibilitySolver<P, S>::mQuery->findNextEdge(mySilhouetteEdgeIndex, mySilhouette, aPolytope, occlusionTreeNodeSymbol);
+        bool hasEdge = VisibilitySolver<P, S>::mQuery->findNextEdge(mySilhouetteEdgeIndex, mySilhouette, aPolytope, occlusionTreeNodeSymbol);
 
-        if (hasEdge) // a candidate edge has been found. we will split the polytope with the hyperplane of this edge.
+        // No valid candidate edge has been found in the occluder set: all the set of lines represented by the polytope are blocked by at least one occluder: the traversal of this branch stops.
+        // When it is the case for all the sub-polytopes created during the traversal, the two polygons are mutually hidden.
+        if (!hasEdge)
         {
-            SilhouetteEdge& myVisibilitySilhouetteEdge = mySilhouette->getEdge(mySilhouetteEdgeIndex);
-            SilhouetteMeshFace* face = myVisibilitySilhouetteEdge.mFace;
-
-            V_ASSERT(myVisibilitySilhouetteEdge.mIsActive);
-            // deactivate the candidate edge for further recursion
-            mySilhouette->setEdgeActive(mySilhouetteEdgeIndex, false);
-
-            MathVector2i edge = face->getEdge(myVisibilitySilhouetteEdge.mEdgeIndex);
-
-            // Create the Plucker representation of the edge and add hyperplane of the edge and add it to the polyhedron
-
-            MathVector3d a = convert<MathVector3d>(face->getVertex(edge.x));
-            MathVector3d b = convert<MathVector3d>(face->getVertex(edge.y));
-
-            bool intersect = false;
-
+            myStatistic->inc(NO_CANDIDATE_EDGE_COUNT);
+            if (!mDetectApertureOnly)
             {
-                HelperScopedTimer timer(VisibilitySolver<P, S>::mQuery->getStatistic(), OCCLUDER_TREATMENT);
-                intersect = MathGeometry::isEdgeInsidePolytope(a, b, aPolytope, VisibilitySolver<P, S>::mQuery->getApproximateNormal(), myPolyhedron, mTolerance);
+                //We found a final polytope visible
+#ifdef OUTPUT_DEBUG_FILE
+                V_LOG(debugOutput, "visible polytope found: exporting stabbing lines", occlusionTreeNodeSymbol);
+#endif
+                extractStabbingLines(myPolyhedron, aPolytope);
+                aGlobalResult = VISIBLE;
             }
-            if (intersect)
-            {
-                if (VisibilitySolver<P, S>::mDebugger != nullptr)
-                {
-                    VisibilitySolver<P, S>::mDebugger->addRemovedEdge(face->getVertex(edge.x), face->getVertex(edge.y));
-                }
+            return UNKNOWN;
+        }
 
-                size_t myPolyhedronFace = myVisibilitySilhouetteEdge.mHyperPlaneIndex;
+        // a candidate edge has been found. we will split the polytope with the hyperplane of this edge.
+        SilhouetteEdge& myVisibilitySilhouetteEdge = mySilhouette->getEdge(mySilhouetteEdgeIndex);
+        SilhouetteMeshFace* face = myVisibilitySilhouetteEdge.mFace;
 
-                if (myPolyhedronFace == 0)
-                {
-                    P myHyperplane(a, b);
-                    if (mNormalization)
-                    {
-                        myHyperplane = myHyperplane.getNormalized();
-                    }
-                    myPolyhedronFace = myPolyhedron->add(myHyperplane, ON_BOUNDARY, mNormalization, mTolerance);
-                    myVisibilitySilhouetteEdge.mHyperPlaneIndex = myPolyhedronFace;
-                }
+        V_ASSERT(myVisibilitySilhouetteEdge.mIsActive);
+        // deactivate the candidate edge for the traversal of the children nodes
+        mySilhouette->setEdgeActive(mySilhouetteEdgeIndex, false);
+        aNode.mSilhouette = mySilhouette;
+        aNode.mSilhouetteEdgeIndex = mySilhouetteEdgeIndex;
 
-                P myHyperplane = myPolyhedron->get(myPolyhedronFace);
+        MathVector2i edge = face->getEdge(myVisibilitySilhouetteEdge.mEdgeIndex);
 
-                GeometryPositionType myResult = ON_NEGATIVE_SIDE;
+        // Create the Plucker representation of the edge and add hyperplane of the edge and add it to the polyhedron
 
-                PluckerPolytope<P>* myPolytopeLeft = new PluckerPolytope<P>();
-                PluckerPolytope<P>* myPolytopeRight = new PluckerPolytope<P>();
+        MathVector3d a = convert<MathVector3d>(face->getVertex(edge.x));
+        MathVector3d b = convert<MathVector3d>(face->getVertex(edge.y));
 
-                {
-                    HelperScopedTimer timer(VisibilitySolver<P, S>::mQuery->getStatistic(), POLYTOPE_SPLIT);
-                    VisibilitySolver<P, S>::mQuery->getStatistic()->inc(POLYTOPE_SPLIT_COUNT);
+        bool intersect = false;
 
+        {
+            HelperScopedTimer timer(VisibilitySolver<P, S>::mQuery->getStatistic(), OCCLUDER_TREATMENT);
+            intersect = MathGeometry::isEdgeInsidePolytope(a, b, aPolytope, VisibilitySolver<P, S>::mQuery->getApproximateNormal(), myPolyhedron, mTolerance);
+        }
+        if (!intersect)
+        {
+            myStatistic->inc(EDGE_OUTSIDE_POLYTOPE_COUNT);
+            // the edge does not split the polytope: traverse again the same polytope with the occluders of the node
+            aNode.mChildren[0] = aPolytope;
+            aNode.mReuseOccluders[0] = true;
+            aNode.mPushEdgeProcessed[0] = false;
+            aNode.mChildOccluderBegin = aNode.mOccluderBegin;
+            aNode.mChildOccluderEnd = aNode.mOccluderEnd;
+            aNode.mChildLineBegin = aNode.mLineBegin;
+            aNode.mChildLineEnd = aNode.mLineEnd;
+            aNode.mChildCount = 1;
 #ifdef OUTPUT_DEBUG_FILE
-                    V_LOG(debugOutput, "PERFORM THE SPLIT", occlusionTreeNodeSymbol);
+            aNode.mPostFix[0] = "*";
 #endif
-                    myResult = PluckerPolytopeSplitter<P, S>::split(myPolyhedron, myHyperplane, aPolytope, myPolytopeLeft, myPolytopeRight, myPolyhedronFace, mNormalization, mTolerance);
-
-                    if (VisibilitySolver<P, S>::mQuery->getStatistic()->get(POLYTOPE_SPLIT_COUNT) % 10000 == 0)
-                    {
-                        VisibilitySolver<P, S>::mQuery->getStatistic()->displayCounts();
-                        std::cout << std::endl;
-                    }
-                }
+            return UNKNOWN;
+        }
 
-                std::vector <PluckerPolytope<P>*> myPolytopes;
-                std::vector <std::string> postFix;
-                std::vector<bool> reuseOccluders;
+        if (VisibilitySolver<P, S>::mDebugger != nullptr)
+        {
+            VisibilitySolver<P, S>::mDebugger->addRemovedEdge(face->getVertex(edge.x), face->getVertex(edge.y));
+        }
 
-                if (myResult == ON_BOUNDARY)
-                {
-                    V_ASSERT(myPolytopeLeft && myPolytopeRight);
-#ifdef OUTPUT_DEBUG_FILE
-                    V_LOG(debugOutput, "SPLIT SUCCESS ->recurse on Left and right childs", occlusionTreeNodeSymbol);
-#endif
-                    auto position = MathPredicates::getVertexPlaneRelativePosition(myHyperplane, polytopeLines[0], mTolerance);
+        size_t myPolyhedronFace = myVisibilitySilhouetteEdge.mHyperPlaneIndex;
 
-                    // left split
-                    reuseOccluders.push_back(position != ON_POSITIVE_SIDE);
-                    myPolytopes.push_back(myPolytopeLeft);
-                    postFix.push_back("L");
+        if (myPolyhedronFace == 0)
+        {
+            P myHyperplane(a, b);
+            if (mNormalization)
+            {
+                myHyperplane = myHyperplane.getNormalized();
+            }
+            myPolyhedronFace = myPolyhedron->add(myHyperplane, ON_BOUNDARY, mNormalization, mTolerance);
+            myVisibilitySilhouetteEdge.mHyperPlaneIndex = myPolyhedronFace;
+        }
 
-                    // right split
-                    reuseOccluders.push_back(position != ON_NEGATIVE_SIDE);
-                    myPolytopes.push_back(myPolytopeRight);
-                    postFix.push_back("R");
-                }
-                else
-                {
-#ifdef OUTPUT_DEBUG_FILE
-                    V_LOG(debugOutput, "NO SPLIT OCCURS -> recurse again on the same polytope", occlusionTreeNodeSymbol);
-#endif
-                    reuseOccluders.push_back(true);
-                    myPolytopes.push_back(aPolytope);
-                    postFix.push_back("*");
-                    delete myPolytopeLeft;  myPolytopeLeft = nullptr;
-                    delete myPolytopeRight; myPolytopeRight = nullptr;
-                }
+        P myHyperplane = myPolyhedron->get(myPolyhedronFace);
 
-                for (size_t i = 0; i < myPolytopes.size(); i++)
-                {
-                    bool hasBeenAdded = false;
+        GeometryPositionType myResult = ON_NEGATIVE_SIDE;
 
-                    if (myResult == ON_BOUNDARY && i == 0 || myResult == ON_NEGATIVE_SIDE)
-                    {
-                        mySilhouette->pushEdgeProcessed(mySilhouetteEdgeIndex);
-                        hasBeenAdded = true;
-                    }
+        PluckerPolytope<P>* myPolytopeLeft = new PluckerPolytope<P>();
+        PluckerPolytope<P>* myPolytopeRight = new PluckerPolytope<P>();
 
+        {
+            HelperScopedTimer timer(myStatistic, POLYTOPE_SPLIT);
+            myStatistic->inc(POLYTOPE_SPLIT_COUNT);
 
-                    std::stringstream ss;
 #ifdef OUTPUT_DEBUG_FILE
-                    ss << occlusionTreeNodeSymbol << "|" << face->getFaceIndex() << "-" << myVisibilitySilhouetteEdge.mEdgeIndex << postFix[i];
+            V_LOG(debugOutput, "PERFORM THE SPLIT", occlusionTreeNodeSymbol);
 #endif
-                    VisibilityResult result;
-
-                    if (reuseOccluders[i])
-                    {
-                        result = resolveInternal(aGlobalResult, myPolytopes[i], ss.str(), myOccluders, polytopeLines, aDepth + 1);
-                    }
-                    else
-                    {
-                        result = resolveInternal(aGlobalResult, myPolytopes[i], ss.str(), std::vector<Silhouette*>(), std::vector<P>(), aDepth + 1);
-                    }
-                    if (result == FAILURE)
-                    {
-                        aGlobalResult = FAILURE;
-                        return FAILURE;
-                    }
-                    if (result == VISIBLE)
-                    {
-                        aGlobalResult = VISIBLE;
-                        if (mDetectApertureOnly) // Early stop - an aperture has been found
-                        {
+            myResult = PluckerPolytopeSplitter<P, S>::split(myPolyhedron, myHyperplane, aPolytope, myPolytopeLeft, myPolytopeRight, myPolyhedronFace, mNormalization, mTolerance, myStatistic);
+        }
+
+        aNode.mChildOccluderBegin = myOccluderBegin;
+        aNode.mChildOccluderEnd = myOccluderEnd;
+        aNode.mChildLineBegin = myLineBegin;
+        aNode.mChildLineEnd = myLineEnd;
+
+        if (myResult == ON_BOUNDARY)
+        {
+            V_ASSERT(myPolytopeLeft && myPolytopeRight);
 #ifdef OUTPUT_DEBUG_FILE
-                            V_LOG(debugOutput, "EARLY STOP - aperture found");
+            V_LOG(debugOutput, "SPLIT SUCCESS ->traverse the left and right childs", occlusionTreeNodeSymbol);
 #endif
-                            delete myPolytopeLeft;  myPolytopeLeft = nullptr;
-                            delete myPolytopeRight; myPolytopeRight = nullptr;
+            auto position = MathPredicates::getVertexPlaneRelativePosition(myHyperplane, mLines[myLineBegin], mTolerance);
 
-                            return VISIBLE;
-                        }
-                    }
-                    if (hasBeenAdded)
-                        mySilhouette->popEdgeProcessed(mySilhouetteEdgeIndex);
+            // left split
+            aNode.mChildren[0] = myPolytopeLeft;
+            aNode.mReuseOccluders[0] = position != ON_POSITIVE_SIDE;
+            aNode.mPushEdgeProcessed[0] = true;
 
-                }
-                delete myPolytopeLeft;  myPolytopeLeft = nullptr;
-                delete myPolytopeRight; myPolytopeRight = nullptr;
-
-            }
-            else
-            {
+            // right split
+            aNode.mChildren[1] = myPolytopeRight;
+            aNode.mReuseOccluders[1] = position != ON_NEGATIVE_SIDE;
+            aNode.mPushEdgeProcessed[1] = false;
 
-                std::stringstream ss;
+            aNode.mChildCount = 2;
+            aNode.mOwnsChildren = true;
 #ifdef OUTPUT_DEBUG_FILE
-                ss << occlusionTreeNodeSymbol << "|" << face->getFaceIndex() << "-" << myVisibilitySilhouetteEdge.mEdgeIndex << "*";
+            aNode.mPostFix[0] = "L";
+            aNode.mPostFix[1] = "R";
 #endif
-                VisibilityResult result = resolveInternal(aGlobalResult, aPolytope, ss.str(), anOccluders, aPolytopeLines, aDepth + 1);
-                if (result == FAILURE)
-                    return result;
-
-                if (result == VISIBLE)
-                {
-                    aGlobalResult = VISIBLE;
-                    if (mDetectApertureOnly) // Early stop - an aperture has been found
-                    {
-                        return VISIBLE;
-                    }
-                }
-            }
-            // reactivate the  edge
-
-            mySilhouette->setEdgeActive(mySilhouetteEdgeIndex, true);
         }
-
-        // No valid candidate edge has been found in the occluder set: all the set of lines represented by the polytope are blocked by at least one occluder: the recursion can stops.
-        // When it is the case for all the sub-polytopes created during the recursive traversal, the two polygons are mutually hidden.
-
-        if (!mDetectApertureOnly)
+        else
         {
-            if (!hasEdge)
-            {
-                //We found a final polytope visible
 #ifdef OUTPUT_DEBUG_FILE
-                V_LOG(debugOutput, "visible polytope found: exporting stabbing lines", occlusionTreeNodeSymbol);
+            V_LOG(debugOutput, "NO SPLIT OCCURS -> traverse again the same polytope", occlusionTreeNodeSymbol);
 #endif
-                extractStabbingLines(myPolyhedron, aPolytope);
-                aGlobalResult = VISIBLE;
-                if (mDetectApertureOnly) // Early stop - an aperture has been found
-                {
-                    return VISIBLE;
-                }
-            }
+            myStatistic->inc(myResult == ON_NEGATIVE_SIDE ? NO_SPLIT_NEGATIVE_COUNT : NO_SPLIT_POSITIVE_COUNT);
+            aNode.mChildren[0] = aPolytope;
+            aNode.mReuseOccluders[0] = true;
+            aNode.mPushEdgeProcessed[0] = myResult == ON_NEGATIVE_SIDE;
+            aNode.mChildCount = 1;
+#ifdef OUTPUT_DEBUG_FILE
+            aNode.mPostFix[0] = "*";
+#endif
+            delete myPolytopeLeft;  myPolytopeLeft = nullptr;
+            delete myPolytopeRight; myPolytopeRight = nullptr;
         }
 
-        if (myPolyhedron->getLinesCount() != myInitiaLineCount)
-        {
-       //     resize(myInitiaLineCount, myPolyhedron, aPolytope);
-        }
         return UNKNOWN;
-
     }
 
     template<class P, class S>
@@ -0,0 +1,96 @@
+/*
+Visilib, an open source library for exact visibility computation.
+Copyright(C) 2021 by Denis Haumont
+
+This file is part of Visilib.
+
+Visilib is free software : you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Visilib is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Visilib. If not, see <http://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <unordered_map>
+
+namespace visilib
+{
+    /** @brief Remembers the occluders that blocked the previous hidden queries, such that the next queries process them first
+
+    For each source cell, the cache stores the occluders that blocked the last hidden query performed from the cell: for each occluder id, the index
+    of a face hit by a sampling ray. A query from a cell without entry uses the entry stored last, which is the one of the neighbouring cell in a sweep.
+    The cache is owned by the caller and is not thread safe: each thread performing queries uses its own cache.
+    A stale entry (removed occluder, face out of range) is ignored, and a cached occluder is only processed first, such that the results are unchanged.
+    */
+
+    class VisibilityCoherenceCache
+    {
+    public:
+        VisibilityCoherenceCache()
+            : mLastCell(0),
+            mHasLastCell(false),
+            mHitCount(0)
+        {
+        }
+
+        /** @brief Return the occluders that blocked the last hidden query of a cell, or of the last cell stored if the cell has no entry
+
+        @return: the face hit in each occluder, indexed by occluder id, nullptr if the cache is empty
+        */
+        const std::unordered_map<size_t, size_t>* find(size_t aCell) const
+        {
+            auto iter = mEntries.find(aCell);
+            if (iter == mEntries.end())
+            {
+                if (!mHasLastCell)
+                {
+                    return nullptr;
+                }
+                iter = mEntries.find(mLastCell);
+            }
+            return &iter->second;
+        }
+
+        /** @brief Store the occluders that blocked a hidden query of a cell*/
+        void store(size_t aCell, const std::unordered_map<size_t, size_t>& aHits)
+        {
+            mEntries[aCell] = aHits;
+            mLastCell = aCell;
+            mHasLastCell = true;
+        }
+
+        /** @brief Record that a query has processed a cached occluder first*/
+        void addHit()
+        {
+            mHitCount++;
+        }
+
+        /** @brief Return the number of cached occluders processed first by the queries*/
+        size_t getHitCount() const
+        {
+            return mHitCount;
+        }
+
+        void clear()
+        {
+            mEntries.clear();
+            mHasLastCell = false;
+            mHitCount = 0;
+        }
+
+    private:
+        std::unordered_map<size_t, std::unordered_map<size_t, size_t>> mEntries;   /**< @brief The face hit in each blocking occluder, indexed by cell*/
+        size_t mLastCell;
+        bool mHasLastCell;
+        size_t mHitCount;
+    };
+}
@@ -20,6 +20,9 @@ along with Visilib. If not, see <http://www.gnu.org/licenses/>
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <queue>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -27,6 +30,7 @@ along with Visilib. If not, see <http://www.gnu.org/licenses/>
 #include "silhouette_mesh_face.h"
 #include "geometry_occluder_set.h"
 #include "helper_statistic_collector.h"
+#include "helper_statistic_recorder.h"
 #include "math_geometry.h"
 #include "math_predicates.h"
 #include "math_plucker_2.h"
@@ -35,7 +39,9 @@ along with Visilib. If not, see <http://www.gnu.org/licenses/>
 #include "plucker_polytope_builder.h"
 #include "plucker_polytope_complex.h"
 #include "visibility_aperture_finder.h"
+#include "visibility_coherence_cache.h"
 #include "silhouette_container.h"
+#include "silhouette_container_bvh.h"
 #include "silhouette_processor.h"
 #include "visilib.h"
 #include "visilib_core.h"
@@ -68,9 +74,50 @@ namespace visilib
         virtual void attachVisualisationDebugger(HelperVisualDebugger* aDebugger) = 0;
         virtual VisibilityResult arePolygonsVisible(const float* vertices0, size_t numVertices0, const float* vertices1, size_t numVertices1) = 0;
         virtual void displayStatistic() = 0;
+
+        /** @brief Return the statistics collected by the query (rays casted, polytope splits, timings)*/
+        virtual HelperStatisticCollector* getStatistic() = 0;
+
+        /** @brief Attach a flag that stops the query when it is raised by another thread. The query then returns UNKNOWN*/
+        virtual void setCancellationFlag(const std::atomic<bool>* aCancellation) = 0;
     };
 
 
+    /** @brief Entry of the heap of silhouettes used to select the next edge to split
+
+    The silhouettes of the occluders stored in the coherence cache come first, then the silhouettes with the highest score.
+    Ties are broken by occluder id and face index, such that the split order does not depend on the memory layout.
+    */
+
+    struct VisibilitySilhouetteCandidate
+    {
+        Silhouette* mSilhouette;
+        double mScore;
+        bool mCoherent;
+
+        bool operator<(const VisibilitySilhouetteCandidate& aCandidate) const
+        {
+            if (mCoherent != aCandidate.mCoherent)
+            {
+                return aCandidate.mCoherent;
+            }
+            if (mScore != aCandidate.mScore)
+            {
+                return mScore < aCandidate.mScore;
+            }
+            if (mSilhouette->getGeometryId() != aCandidate.mSilhouette->getGeometryId())
+            {
+                return mSilhouette->getGeometryId() > aCandidate.mSilhouette->getGeometryId();
+            }
+            return getFirstFace(mSilhouette) > getFirstFace(aCandidate.mSilhouette);
+        }
+
+        static size_t getFirstFace(Silhouette* aSilhouette)
+        {
+            return aSilhouette->getSilhouetteFaces().empty() ? 0 : aSilhouette->getSilhouetteFaces()[0];
+        }
+    };
+
     /**@brief Exact Visibility solver implementation class
 
     This class manages the computation of exact visibility query between two polygons through a set of occluders contained in a scene.
@@ -96,12 +143,23 @@ namespace visilib
             return mComplex;
         }
 
-        /**@brief Performs the intersection between a segment and the geometry of the scene.
+        /**@brief Finds the distinct silhouettes intersected by a segment, sorted front to back.
+
+        Each silhouette is reported once with the nearest of its faces hit by the segment, without building a set of faces.
+        */
+        bool findSceneSilhouettes(const MathVector3d& aBegin, const MathVector3d& anEnd, std::vector<SilhouetteHit>& aHits);
+
+        /**@brief Performs the intersection between a packet of segments and the geometry of the scene, in a single traversal of the silhouettes.
 
-        When an intersection is found, the silhouette are extracted from the intersected face and the silhouette is linked to the polytope
-        The links is used for occluder selection.
+        The faces intersected by at least one of the segments are added to intersectedFaces.
         */
-        bool findSceneIntersection(const MathVector3d& aBegin, const MathVector3d& anEnd, std::set<SilhouetteMeshFace*>& intersectedFaces, const S& aDistance = 0, PluckerPolytope<P>* aPolytope = nullptr);
+        bool findScenePacketIntersection(const std::vector<std::pair<MathVector3d, MathVector3d>>& aSegments, std::set<SilhouetteMeshFace*>& intersectedFaces);
+
+        /**@brief Collects the faces of the scene that may intersect the convex hull of a set of segments joining the planes of the query polygons.
+
+        The segments are the extremal stabbing lines of a polytope: the faces that may block a line of the polytope are added to intersectedFaces.
+        */
+        bool findSceneHullIntersection(const std::vector<std::pair<MathVector3d, MathVector3d>>& aSegments, const MathPlane3d& aPlane0, const MathPlane3d& aPlane1, std::set<SilhouetteMeshFace*>& intersectedFaces);
 
         void extractAllSilhouettes();
 
@@ -144,7 +202,27 @@ namespace visilib
         {
             return mApproximateNormal;
         }
-        bool isOccluded(PluckerPolytope<P> * polytope, PluckerPolyhedron<P>* polyhedron, const std::vector <Silhouette*> & silhouettes, const std::vector<P> & polytopeLines);
+        void setCancellationFlag(const std::atomic<bool>* aCancellation)
+        {
+            mCancellation = aCancellation;
+        }
+
+        /**@brief Return true if the query has been cancelled by another thread
+        */
+        bool isCancelled() const
+        {
+            return mCancellation != nullptr && mCancellation->load(std::memory_order_relaxed);
+        }
+
+        /**@brief Find the first active edge of a silhouette
+        */
+        bool findFirstActiveEdge(Silhouette* aSilhouette, size_t& aSilhouetteEdgeIndex);
+
+        /**@brief Reactivate an edge returned by findNextEdge, once the subtree of the occlusion tree created by its split has been processed
+        */
+        void restoreEdge(Silhouette* aSilhouette, size_t aSilhouetteEdgeIndex);
+
+        bool isOccluded(PluckerPolytope<P> * polytope, PluckerPolyhedron<P>* polyhedron, Silhouette* const* aSilhouettes, size_t aSilhouetteCount, const P* aPolytopeLines, size_t aLineCount);
 
         /**@brief Return the statistic collector */
         HelperStatisticCollector* getStatistic()
@@ -159,6 +237,9 @@ namespace visilib
         }
     private:
 
+        /**@brief Compute the visibility query, the statistic of the query being recorded by arePolygonsVisible*/
+        VisibilityResult computeVisibility(const float* vertices0, size_t numVertices0, const float* vertices1, size_t numVertices1);
+
         /**@brief Create the initial source polygons from the polygons provided as input
 
         If the suport plane of one of the input polygon intersect the other polygon, we clip the intersected polygon using the equation of the support plane.
@@ -166,6 +247,22 @@ namespace visilib
         */
         bool createInitialPolygons(const float* vertices0, size_t numVertices0, const float* vertices1, size_t numVertices1, bool normalization);
 
+        /**@brief Retrieve the silhouettes of the occluders stored in the coherence cache of the scene
+        */
+        void initCoherentSilhouettes();
+
+        /**@brief Compute the score of all the silhouettes and fill the heap of candidates used by findNextEdge
+        */
+        void initSilhouetteCandidates();
+
+        /**@brief Compute the score of a silhouette according to the split ordering of the configuration
+        */
+        double computeSilhouetteScore(Silhouette* aSilhouette);
+
+        /**@brief Insert a silhouette in the heap of candidates, with its current score
+        */
+        void pushSilhouetteCandidate(Silhouette* aSilhouette);
+
         VisibilityExactQueryConfiguration mConfiguration;                     /**< @brief The configuration parameters of the query*/
         PluckerPolytopeComplex<P>* mComplex;                   /**< @brief The polytope complex encoding the occlusion tree*/
         GeometryOccluderSet* mScene;                                         /**< @brief The scene containing the triangle mesh occluders*/
@@ -180,6 +277,11 @@ namespace visilib
  //      std::unordered_map<VisibilitySilhouette*, std::unordered_set<PluckerPolytope<P>*>> mSilhouetteToPolytopeDictionary;
 
         SilhouetteContainer* mSilhouetteContainer;
+        std::vector<Silhouette*> mCoherentSilhouettes;         /**< @brief The silhouettes of the occluders that blocked the previous hidden query, processed first*/
+        std::unordered_map<size_t, size_t> mHits;              /**< @brief The face hit by the sampling rays in each occluder, indexed by occluder id*/
+        std::priority_queue<VisibilitySilhouetteCandidate> mSilhouetteCandidates;   /**< @brief The heap of silhouettes from which findNextEdge selects the next edge to split*/
+        std::unordered_map<Silhouette*, double> mSilhouetteScores;                  /**< @brief The current score of each silhouette*/
+        const std::atomic<bool>* mCancellation;                                     /**< @brief The flag cancelling the query, if any*/
         /** @brief The links between the silhouettes and the polytopes*/
     //    std::unordered_map<PluckerPolytope<P>*, std::unordered_set<VisibilitySilhouette*>> mPolytopeToSilhouetteDictionary;
     };
@@ -188,7 +290,8 @@ namespace visilib
     VisibilityExactQuery_<P, S>::VisibilityExactQuery_(GeometryOccluderSet * aScene, const VisibilityExactQueryConfiguration & aConfiguration, S aTolerance)
         : mScene(aScene),
         mConfiguration(aConfiguration),
-        mDebugger(nullptr)
+        mDebugger(nullptr),
+        mCancellation(nullptr)
     {
         mComplex = new PluckerPolytopeComplex<P>();
 
@@ -207,6 +310,11 @@ namespace visilib
         }
         else
 #endif
+        if (aConfiguration.useBvh)
+        {
+            mSilhouetteContainer = new SilhouetteContainerBvh(mScene);
+        }
+        else
         {
             mSilhouetteContainer = new SilhouetteContainer();
         }
@@ -215,6 +323,10 @@ namespace visilib
     template<class P, class S>
     VisibilityExactQuery_<P, S>::~VisibilityExactQuery_()
     {
+        if (mConfiguration.statistics != nullptr)
+        {
+            mConfiguration.statistics->add(mStatistic);
+        }
         delete mComplex;
         delete mSilhouetteProcessor;
         delete mQueryPolygon[0];
@@ -287,6 +399,37 @@ namespace visilib
 
     template<class P, class S>
     VisibilityResult VisibilityExactQuery_<P, S>::arePolygonsVisible(const float* vertices0, size_t numVertices0, const float* vertices1, size_t numVertices1)
+    {
+        HelperQueryRecord myRecord;
+        myRecord.mStartTime = HelperClock::now();
+
+        VisibilityResult result = computeVisibility(vertices0, numVertices0, vertices1, numVertices1);
+
+        mStatistic.updateMax(POLYHEDRON_SIZE, getComplex()->getPolyhedron()->getLinesCount());
+
+        if (mConfiguration.recorder != nullptr)
+        {
+            myRecord.mEndTime = HelperClock::now();
+            myRecord.mResult = result;
+            const float* myVertices[2] = { vertices0, vertices1 };
+            size_t myVertexCount[2] = { numVertices0, numVertices1 };
+            for (size_t i = 0; i < 2; i++)
+            {
+                myRecord.mVertexCount[i] = myVertexCount[i];
+                myRecord.mCenter[i] = MathVector3d(0, 0, 0);
+                for (size_t j = 0; j < myVertexCount[i]; j++)
+                {
+                    myRecord.mCenter[i] += MathVector3d(myVertices[i][3 * j], myVertices[i][3 * j + 1], myVertices[i][3 * j + 2]);
+                }
+                myRecord.mCenter[i] = myRecord.mCenter[i] * (1.0 / std::max<size_t>(myVertexCount[i], 1));
+            }
+            mConfiguration.recorder->record(myRecord, mStatistic);
+        }
+        return result;
+    }
+
+    template<class P, class S>
+    VisibilityResult VisibilityExactQuery_<P, S>::computeVisibility(const float* vertices0, size_t numVertices0, const float* vertices1, size_t numVertices1)
     {
         VisibilityResult result = UNKNOWN;
 
@@ -309,8 +452,24 @@ namespace visilib
 
         if (mQueryPolygon[0]->getVertexCount() == 1 && mQueryPolygon[1]->getVertexCount() == 1)
         {
-            std::set<SilhouetteMeshFace*> intersectedFaces;
-            result = findSceneIntersection(mQueryPolygon[0]->getVertex(0), mQueryPolygon[1]->getVertex(0), intersectedFaces) ? HIDDEN : VISIBLE;
+            // The silhouettes are not extracted: the segment joining the points is tested against all the faces of the scene,
+            // using its BVH if it is up to date
+            const MathVector3d& myBegin = mQueryPolygon[0]->getVertex(0);
+            const MathVector3d& myEnd = mQueryPolygon[1]->getVertex(0);
+            if (mDebugger != nullptr)
+            {
+                mDebugger->addSamplingLine(convert<MathVector3f>(myBegin), convert<MathVector3f>(myEnd));
+            }
+            {
+                HelperScopedTimer timer(getStatistic(), RAY_INTERSECTION);
+                getStatistic()->inc(RAY_COUNT);
+
+                result = mScene->intersectsSegment(myBegin, myEnd) ? HIDDEN : VISIBLE;
+            }
+            if (result == VISIBLE && mDebugger != nullptr)
+            {
+                mDebugger->addStabbingLine(convert<MathVector3f>(myBegin), convert<MathVector3f>(myEnd));
+            }
         }
         else
         {
@@ -320,6 +479,8 @@ namespace visilib
 
                 mSilhouetteProcessor->init(*mQueryPolygon[0], *mQueryPolygon[1]);
                 extractAllSilhouettes();
+                initCoherentSilhouettes();
+                initSilhouetteCandidates();
             }
             {
                 HelperScopedTimer timer(getStatistic(), RAY_INTERSECTION);
@@ -354,6 +515,11 @@ namespace visilib
             result = solver->resolve();
 
             delete solver;
+
+            if (result == HIDDEN && mConfiguration.coherenceCache != nullptr)
+            {
+                mConfiguration.coherenceCache->store(mConfiguration.coherenceCell, mHits);
+            }
         }
 
         return result;
@@ -374,50 +540,26 @@ namespace visilib
         V_LOG(debugOutput, "VisibilityExactQuery<P, S>::findTheBestValidEdge BEGIN", occlusionTreeNodeSymbol);
 #endif
 
-        const std::unordered_set<Silhouette*>& mySilhouettes = mSilhouetteContainer->getSilhouettes();
-
-        double myScore = 1e32;
         bool found = false;
 
         Silhouette* mySilhouette = nullptr;
 
-        MathPlane3d aPlane0 = getQueryPolygon(0)->getPlane();
-
-        const MathPlane3d& myPlane = getQueryPolygon(0)->getPlane();
-        for (auto iter = mySilhouettes.begin(); iter != mySilhouettes.end(); iter++)
+        // The candidate with the highest priority is kept on top of the heap until all its edges have been processed, such that each silhouette
+        // is completed as soon as possible and can be used as an occluder by isOccluded. Outdated candidates are discarded lazily.
+        while (!mSilhouetteCandidates.empty() && !found)
         {
-            Silhouette* s = (*iter);
-
-            auto& edges = s->getEdges();
+            const VisibilitySilhouetteCandidate& myCandidate = mSilhouetteCandidates.top();
+            Silhouette* s = myCandidate.mSilhouette;
 
-            for (size_t silhouetteEdgeIndex = 0; silhouetteEdgeIndex < edges.size(); silhouetteEdgeIndex++)
+            if (s->getAvailableEdgeCount() > 0 && myCandidate.mScore == mSilhouetteScores[s] && findFirstActiveEdge(s, aSilhouetteEdgeIndex))
             {
-                SilhouetteEdge& edge = edges[silhouetteEdgeIndex];
-                if (edge.mIsActive)
-                {
-                    /*
-                    if (edge.mScore < 0.0)
-                    {
-                        ConnectedMeshElement* f = edge.mFace;
-                        size_t edgeIndex = edge.mEdgeIndex;
-                        MathVector2i ei = f->getEdge(edgeIndex);
-                        edge.mScore = aPlane0.dot(convert<MathVector3d>(f->getVertex(ei.x)));
-                    }
-                    if (edge.mScore < myScore)
-                    */
-                    {
-                        found = true;
-                        myScore = edge.mScore;
-                        aSilhouetteEdgeIndex = silhouetteEdgeIndex;
-                        mySilhouette = s;
-                    }
-                }
-                if (found)
-                    break;
+                found = true;
+                mySilhouette = s;
+            }
+            else
+            {
+                mSilhouetteCandidates.pop();
             }
-
-            if (found)
-                break;
         }
 
         if (found)
@@ -440,27 +582,148 @@ namespace visilib
     }
 
     template<class P, class S>
-    bool VisibilityExactQuery_<P, S>::isOccluded(PluckerPolytope<P>* polytope, PluckerPolyhedron<P>* polyhedron, const std::vector <Silhouette*> & aSilhouettes, const std::vector<P> & polytopeLines)
+    bool VisibilityExactQuery_<P, S>::findFirstActiveEdge(Silhouette* aSilhouette, size_t& aSilhouetteEdgeIndex)
+    {
+        const auto& edges = aSilhouette->getEdges();
+
+        for (size_t silhouetteEdgeIndex = 0; silhouetteEdgeIndex < edges.size(); silhouetteEdgeIndex++)
+        {
+            if (edges[silhouetteEdgeIndex].mIsActive)
+            {
+                aSilhouetteEdgeIndex = silhouetteEdgeIndex;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template<class P, class S>
+    void VisibilityExactQuery_<P, S>::restoreEdge(Silhouette* aSilhouette, size_t aSilhouetteEdgeIndex)
+    {
+        aSilhouette->setEdgeActive(aSilhouetteEdgeIndex, true);
+
+        // The candidate of a silhouette is discarded when all its edges are processed: it becomes a candidate again
+        if (aSilhouette->getAvailableEdgeCount() == 1)
+        {
+            pushSilhouetteCandidate(aSilhouette);
+        }
+    }
+
+    template<class P, class S>
+    void VisibilityExactQuery_<P, S>::pushSilhouetteCandidate(Silhouette* aSilhouette)
+    {
+        VisibilitySilhouetteCandidate myCandidate;
+        myCandidate.mSilhouette = aSilhouette;
+        myCandidate.mScore = mSilhouetteScores[aSilhouette];
+        myCandidate.mCoherent = std::find(mCoherentSilhouettes.begin(), mCoherentSilhouettes.end(), aSilhouette) != mCoherentSilhouettes.end();
+
+        mSilhouetteCandidates.push(myCandidate);
+    }
+
+    template<class P, class S>
+    double VisibilityExactQuery_<P, S>::computeSilhouetteScore(Silhouette* aSilhouette)
+    {
+        if (mConfiguration.splitOrdering == VisibilityExactQueryConfiguration::LINES_BLOCKED)
+        {
+            // No line has been sampled yet: the score is increased each time a sampling ray hits the silhouette
+            return 0.0;
+        }
+
+        const MathPlane3d& myPlane = getQueryPolygon(0)->getPlane();
+        MathVector3d myCenter = MathVector3d::Zero();
+        for (size_t i = 0; i < getQueryPolygon(0)->getVertexCount(); i++)
+        {
+            myCenter += getQueryPolygon(0)->getVertex(i);
+        }
+        myCenter /= (double)getQueryPolygon(0)->getVertexCount();
+
+        double myMinDepth = 1e32;
+        double myExtent = 0.0;
+
+        for (auto& edge : aSilhouette->getEdges())
+        {
+            MathVector2i myEdge = edge.mFace->getEdge(edge.mEdgeIndex);
+            MathVector3d a = convert<MathVector3d>(edge.mFace->getVertex(myEdge.x));
+            MathVector3d b = convert<MathVector3d>(edge.mFace->getVertex(myEdge.y));
+
+            myMinDepth = std::min(myMinDepth, std::min(myPlane.dot(a), myPlane.dot(b)));
+
+            MathVector3d myMiddle = (a + b) * 0.5;
+            myExtent += (b - a).getNorm() / std::max((myMiddle - myCenter).getNorm(), 1e-12);
+        }
+
+        if (mConfiguration.splitOrdering == VisibilityExactQueryConfiguration::ANGULAR_EXTENT)
+        {
+            return myExtent;
+        }
+        return -myMinDepth;
+    }
+
+    template<class P, class S>
+    void VisibilityExactQuery_<P, S>::initSilhouetteCandidates()
+    {
+        mSilhouetteCandidates = std::priority_queue<VisibilitySilhouetteCandidate>();
+        mSilhouetteScores.clear();
+
+        for (auto s : mSilhouetteContainer->getSilhouettes())
+        {
+            mSilhouetteScores[s] = computeSilhouetteScore(s);
+            if (s->getAvailableEdgeCount() > 0)
+            {
+                pushSilhouetteCandidate(s);
+            }
+        }
+    }
+
+    template<class P, class S>
+    void VisibilityExactQuery_<P, S>::initCoherentSilhouettes()
+    {
+        mCoherentSilhouettes.clear();
+        mHits.clear();
+
+        if (mConfiguration.coherenceCache == nullptr)
+        {
+            return;
+        }
+        const std::unordered_map<size_t, size_t>* myLastHits = mConfiguration.coherenceCache->find(mConfiguration.coherenceCell);
+        if (myLastHits == nullptr)
+        {
+            return;
+        }
+
+        for (auto& myHit : *myLastHits)
+        {
+            if (myHit.first >= mScene->getOccluderCount())
+            {
+                continue;
+            }
+            std::vector<SilhouetteMeshFace>* myFaces = mScene->getOccluderConnectedFaces(myHit.first);
+            if (myHit.second >= myFaces->size())
+            {
+                continue;
+            }
+
+            Silhouette* s = mSilhouetteProcessor->findSilhouette(&(*myFaces)[myHit.second]);
+            if (s != nullptr && std::find(mCoherentSilhouettes.begin(), mCoherentSilhouettes.end(), s) == mCoherentSilhouettes.end())
+            {
+                mCoherentSilhouettes.push_back(s);
+                mConfiguration.coherenceCache->addHit();
+            }
+        }
+    }
+
+    template<class P, class S>
+    bool VisibilityExactQuery_<P, S>::isOccluded(PluckerPolytope<P>* polytope, PluckerPolyhedron<P>* polyhedron, Silhouette* const* aSilhouettes, size_t aSilhouetteCount, const P* aPolytopeLines, size_t aLineCount)
     {
-        return SilhouetteContainer::isOccluded(polytope, polyhedron, aSilhouettes,polytopeLines,mTolerance);
+        return SilhouetteContainer::isOccluded(polytope, polyhedron, aSilhouettes, aSilhouetteCount, aPolytopeLines, aLineCount, mTolerance);
     }
 
     template<class P, class S>
-    bool VisibilityExactQuery_<P, S>::findSceneIntersection(const MathVector3d & aBegin, const MathVector3d & anEnd, std::set<SilhouetteMeshFace*> & anIntersectedFaces, const S& aDistance, PluckerPolytope<P> * aPolytope)
+    bool VisibilityExactQuery_<P, S>::findSceneSilhouettes(const MathVector3d& aBegin, const MathVector3d& anEnd, std::vector<SilhouetteHit>& aHits)
     {
-        MathVector3d myBegin = aBegin;
         MathVector3d myDir = anEnd - aBegin;
         double myMax = myDir.normalize();
-
-        VisibilityRay myRay;
-        myRay.org[0] = (float)myBegin.x;
-        myRay.org[1] = (float)myBegin.y;
-        myRay.org[2] = (float)myBegin.z;
-        myRay.dir[0] = (float)myDir.x;
-        myRay.dir[1] = (float)myDir.y;
-        myRay.dir[2] = (float)myDir.z;
-        myRay.tfar = (float)myMax;
-        myRay.tnear = 0;
+        GeometryRay myRay(convert<MathVector3f>(aBegin), convert<MathVector3f>(myDir));
 
         if (mDebugger != nullptr)
         {
@@ -468,35 +731,87 @@ namespace visilib
         }
 
         bool intersect = false;
-
         {
             HelperScopedTimer timer(getStatistic(), RAY_INTERSECTION);
             getStatistic()->inc(RAY_COUNT);
 
-            intersect = mSilhouetteContainer->intersect(&myRay, MathArithmetic<S>::to_double(aDistance));
+            intersect = mSilhouetteContainer->intersectSilhouettes(myRay, 0.0f, (float)myMax, aHits);
         }
 
-        if (intersect)
+        if (!intersect && mDebugger != nullptr)
         {
-            for (size_t i = 0; i < myRay.mPrimitiveIds.size(); i++)
-            {
-                //:TODO: replace wihth accessors
-                size_t myPrimitive = myRay.mPrimitiveIds[i];
-                size_t geometryId = myRay.mGeometryIds[i];
+            mDebugger->addStabbingLine(convert<MathVector3f>(aBegin), convert<MathVector3f>(anEnd));
+        }
+        return intersect;
+    }
+
+    template<class P, class S>
+    bool VisibilityExactQuery_<P, S>::findScenePacketIntersection(const std::vector<std::pair<MathVector3d, MathVector3d>>& aSegments, std::set<SilhouetteMeshFace*>& anIntersectedFaces)
+    {
+        std::vector<GeometryRay> myRays;
+        myRays.reserve(aSegments.size());
+
+        for (const auto& mySegment : aSegments)
+        {
+            MathVector3f myBegin = convert<MathVector3f>(mySegment.first);
+            MathVector3f myEnd = convert<MathVector3f>(mySegment.second);
+            MathVector3f myDirection = myEnd - myBegin;
+            myDirection.normalize();
+            myRays.push_back(GeometryRay(myBegin, myDirection));
 
-                std::vector<SilhouetteMeshFace>* myFaces = mScene->getOccluderConnectedFaces(geometryId);
-                SilhouetteMeshFace* myFace = &(*myFaces)[myPrimitive];
-                anIntersectedFaces.insert(myFace);
+            if (mDebugger != nullptr)
+            {
+                mDebugger->addSamplingLine(myBegin, myEnd);
             }
-            return true;
         }
 
+        VisibilityRay myResult;
+        bool intersect = false;
+
+        {
+            HelperScopedTimer timer(getStatistic(), RAY_INTERSECTION);
+            getStatistic()->add(RAY_COUNT, aSegments.size());
+
+            intersect = mSilhouetteContainer->intersectPacket(myRays, &myResult);
+        }
+
+        for (size_t i = 0; i < myResult.mPrimitiveIds.size(); i++)
+        {
+            std::vector<SilhouetteMeshFace>* myFaces = mScene->getOccluderConnectedFaces(myResult.mGeometryIds[i]);
+            anIntersectedFaces.insert(&(*myFaces)[myResult.mPrimitiveIds[i]]);
+        }
+        return intersect;
+    }
+
+    template<class P, class S>
+    bool VisibilityExactQuery_<P, S>::findSceneHullIntersection(const std::vector<std::pair<MathVector3d, MathVector3d>>& aSegments, const MathPlane3d& aPlane0, const MathPlane3d& aPlane1, std::set<SilhouetteMeshFace*>& anIntersectedFaces)
+    {
         if (mDebugger != nullptr)
         {
-            mDebugger->addStabbingLine(convert<MathVector3f>(aBegin), convert<MathVector3f>(anEnd));
+            for (const auto& mySegment : aSegments)
+            {
+                mDebugger->addSamplingLine(convert<MathVector3f>(mySegment.first), convert<MathVector3f>(mySegment.second));
+            }
         }
 
-        return false;
+        VisibilityRay myResult;
+        bool intersect = false;
+
+        {
+            HelperScopedTimer timer(getStatistic(), RAY_INTERSECTION);
+            getStatistic()->inc(RAY_COUNT);
+
+            GeometryStabbingLineHull myHull;
+            myHull.build(aSegments, aPlane0, aPlane1);
+            intersect = mSilhouetteContainer->intersectHull(myHull, &myResult);
+        }
+
+        for (size_t i = 0; i < myResult.mPrimitiveIds.size(); i++)
+        {
+            std::vector<SilhouetteMeshFace>* myFaces = mScene->getOccluderConnectedFaces(myResult.mGeometryIds[i]);
+            anIntersectedFaces.insert(&(*myFaces)[myResult.mPrimitiveIds[i]]);
+        }
+        return intersect;
     }
 
     template<class P, class S>
@@ -524,7 +839,7 @@ namespace visilib
         {
              HelperScopedTimer timer(getStatistic(), STABBING_LINE_EXTRACTION);
 
-             myRepresentativeLine = MathGeometry::computeRepresentativeLine<P>(aPolytope, polyhedron, mTolerance);
+             myRepresentativeLine = MathGeometry::computeRepresentativeLine<P>(aPolytope, mTolerance);
              if (mConfiguration.hyperSphereNormalization)
                  myRepresentativeLine = myRepresentativeLine.getNormalized();
              polytopeLines.push_back(myRepresentativeLine);
@@ -536,8 +851,10 @@ namespace visilib
 
         std::pair<MathVector3d, MathVector3d> centerLine = MathGeometry::getBackTo3D(myRepresentativeLine, aPlane0, aPlane1);
 
+        static thread_local std::vector<SilhouetteHit> mySilhouetteHits;
+        bool hit = findSceneSilhouettes(centerLine.first, centerLine.second, mySilhouetteHits);
+
         std::set<SilhouetteMeshFace*> intersectedFaces;
-        bool hit = findSceneIntersection(centerLine.first, centerLine.second, intersectedFaces, 0, aPolytope);
 
         if (!hit && !mConfiguration.detectApertureOnly)
         {
@@ -555,36 +872,62 @@ namespace visilib
                 V_ASSERT(0);
                 return true;
             }
-            S myMaxDistance = 0;
-            S myDistance = 0;
-
+            // The extremal stabbing lines bound the lines of the polytope
+            std::vector<std::pair<MathVector3d, MathVector3d>> myLines;
+            myLines.reserve(aPolytope->getExtremalStabbingLinesCount());
             for (size_t i = 0; i < aPolytope->getExtremalStabbingLinesCount(); i++)
             {
-                std::pair<MathVector3d, MathVector3d> line = MathGeometry::getBackTo3D(aPolytope->getExtremalStabbingLine(i),
-                                                                                    aPlane0,
-                                                                                    aPlane1);
-
-                myDistance = (line.first - centerLine.first).getSquaredNorm();
-                if (myDistance> myMaxDistance)
-                {
-                    myMaxDistance = myDistance;
-                }
+                myLines.push_back(MathGeometry::getBackTo3D(aPolytope->getExtremalStabbingLine(i), aPlane0, aPlane1));
+            }
 
-                myDistance = (line.second - centerLine.second).getSquaredNorm();
-                if (myDistance> myMaxDistance)
+            if (mConfiguration.occluderCollection == VisibilityExactQueryConfiguration::RAY_PACKET)
+            {
+                findScenePacketIntersection(myLines, intersectedFaces);
+            }
+            else
+            {
+                findSceneHullIntersection(myLines, aPlane0, aPlane1, intersectedFaces);
+            }
+        }
+        auto addOccluder = [&](Silhouette* s, size_t aFaceIndex)
+        {
+            occluders.push_back(s);
+            if (mConfiguration.coherenceCache != nullptr)
+            {
+                mHits[s->getGeometryId()] = aFaceIndex;
+            }
+            if (mConfiguration.splitOrdering == VisibilityExactQueryConfiguration::LINES_BLOCKED)
+            {
+                mSilhouetteScores[s] += 1.0;
+                if (s->getAvailableEdgeCount() > 0)
                 {
-                    myMaxDistance = myDistance;
+                    pushSilhouetteCandidate(s);
                 }
             }
-            myMaxDistance = MathArithmetic<S>::getSqrt(myMaxDistance);
-            findSceneIntersection(centerLine.first, centerLine.second, intersectedFaces, myMaxDistance, aPolytope);
+        };
+
+        size_t myFirstOccluder = occluders.size();
+        for (const SilhouetteHit& myHit : mySilhouetteHits)
+        {
+            addOccluder(myHit.mSilhouette, myHit.mFaceIndex);
         }
         for (auto myFace : intersectedFaces)
         {
             Silhouette* s = mSilhouetteProcessor->findSilhouette(myFace);
             //   V_ASSERT(s);
             if (s)
-                occluders.push_back(s);
+            {
+                addOccluder(s, myFace->getFaceIndex());
+            }
+        }
+
+        if (!mCoherentSilhouettes.empty())
+        {
+            // The occluders that blocked the previous hidden query are tested first by isOccluded
+            std::stable_partition(occluders.begin() + myFirstOccluder, occluders.end(), [this](Silhouette* s)
+                {
+                    return std::find(mCoherentSilhouettes.begin(), mCoherentSilhouettes.end(), s) != mCoherentSilhouettes.end();
+                });
         }
         return hit;
     }
@@ -29,6 +29,10 @@ along with Visilib. If not, see <http://www.gnu.org/licenses/>
 
 namespace visilib
 {
+    class HelperStatisticAggregator;
+    class HelperStatisticRecorder;
+    class VisibilityCoherenceCache;
+
     /** @brief Configuration of a visibility query.*/
 
     struct VisibilityExactQueryConfiguration
@@ -58,6 +62,21 @@ namespace visilib
             MONTE_CARLO
         };
 
+        /** @brief Score used to order the silhouettes whose edges are split during the query*/
+        enum SplitOrderingType
+        {
+            DEPTH,           /**< @brief Silhouettes nearest to the first source first*/
+            ANGULAR_EXTENT,  /**< @brief Silhouettes with the largest angular extent as seen from the first source first*/
+            LINES_BLOCKED    /**< @brief Silhouettes hit by the largest number of sampling lines first*/
+        };
+
+        /** @brief Sampling used to collect the occluders of a polytope whose representative line is not blocked*/
+        enum OccluderCollectionType
+        {
+            STABBING_LINE_HULL, /**< @brief The convex hull of the extremal stabbing lines, tested against each triangle*/
+            RAY_PACKET          /**< @brief The extremal stabbing lines, cast as a single packet of rays*/
+        };
+
         VisibilityExactQueryConfiguration()
         {
             silhouetteOptimization = true;
@@ -65,8 +84,16 @@ namespace visilib
             precision = DOUBLE;
             detectApertureOnly = true;
             useEmbree = false;
+            useBvh = true;
             tolerance = -1.0;
             solverType = EXACT_APERTURE_FINDER;
+            coherenceCache = nullptr;
+            coherenceCell = 0;
+            splitOrdering = DEPTH;
+            occluderCollection = STABBING_LINE_HULL;
+            threadCount = 1;
+            statistics = nullptr;
+            recorder = nullptr;
         }
 
         VisibilityExactQueryConfiguration(const VisibilityExactQueryConfiguration& other)
@@ -76,8 +103,16 @@ namespace visilib
             precision = other.precision;
             detectApertureOnly = other.detectApertureOnly;
             useEmbree = other.useEmbree;
+            useBvh = other.useBvh;
             tolerance = other.tolerance;
             solverType = other.solverType;
+            coherenceCache = other.coherenceCache;
+            coherenceCell = other.coherenceCell;
+            splitOrdering = other.splitOrdering;
+            occluderCollection = other.occluderCollection;
+            threadCount = other.threadCount;
+            statistics = other.statistics;
+            recorder = other.recorder;
         }
 
         bool silhouetteOptimization;                  /**< @brief Use silhouette optimization*/
@@ -85,8 +120,16 @@ namespace visilib
         PrecisionType precision;                      /**< @brief Arithmetic model precision t*/
         bool detectApertureOnly;                      /**< @brief Stop the query as soon as a visible line has been found*/
         bool useEmbree;
+        bool useBvh;                                  /**< @brief Trace the rays with the built-in BVH of the scene, restricted to the silhouettes (SilhouetteContainerBvh). Enabled by default: false selects SilhouetteContainer, which tests the rays against every silhouette face, with the same results*/
         double tolerance;
         SolverType solverType; 
+        VisibilityCoherenceCache* coherenceCache;     /**< @brief Optional cache of the occluders that blocked the previous hidden queries, processed first (not thread safe: one cache per thread)*/
+        size_t coherenceCell;                         /**< @brief The source cell of the query in the coherence cache*/
+        SplitOrderingType splitOrdering;              /**< @brief Score used to select the next silhouette edge to split*/
+        OccluderCollectionType occluderCollection;    /**< @brief Sampling used to collect the occluders when the extremal stabbing lines are computed (detectApertureOnly = false)*/
+        size_t threadCount;                           /**< @brief Number of threads exploring in parallel the set of lines of a single query (1: sequential query)*/
+        HelperStatisticAggregator* statistics;        /**< @brief Optional thread-safe sum of the statistics of all the queries performed with this configuration*/
+        HelperStatisticRecorder* recorder;            /**< @brief Optional thread-safe recorder of the statistics of each query performed with this configuration*/
     };
 
 
@@ -101,6 +144,9 @@ namespace visilib
     };
 
     /**< @brief Compute if two convex source primitives are mutually visible through the occluders contained in a scene
+
+    The visibility of two points is computed by a shadow ray on the BVH of the scene (see arePointsVisible()). If the BVH is not up to date
+    (GeometryOccluderSet::updateBvh()), the shadow ray is tested against each face of the occluders.
     @param scene: a scene containing the occluders
     @param vertices0: a pointer to the vertices of the first convex primitive source
     @param numVertices0: the number of vertices of the first convex primitive source
@@ -116,6 +162,52 @@ namespace visilib
                                 const VisibilityExactQueryConfiguration& configuration = VisibilityExactQueryConfiguration(),
                                 HelperVisualDebugger* debugger = nullptr);
 
+    /**< @brief Compute if a point is visible from each point of a set through the occluders contained in a scene
+
+    Each pair of points is tested by an any-hit query of the segment joining them on the BVH of the scene (shadow ray): no silhouette is extracted
+    and no memory is allocated, such that the function is intended for massive point queries (sound sources, light probes).
+    The scene is only read: the BVH is built by GeometryOccluderSet::prepare(), and must be updated by GeometryOccluderSet::updateBvh() after a change of the occluders.
+    @param scene: a scene containing the occluders
+    @param point0: a pointer to the 3 coordinates of the point
+    @param points1: a pointer to the coordinates of the set of points
+    @param numPoints1: the number of points of the set
+    @param results: receives the visibility of each point of the set, VISIBLE or HIDDEN (optional: without it, the function returns at the first visible point)
+    @return: VISIBLE if at least one point of the set is visible, HIDDEN otherwise, FAILURE if the BVH of the scene is not up to date
+    */
+
+    VisibilityResult arePointsVisible(const GeometryOccluderSet* scene, const float* point0, const float* points1, size_t numPoints1, VisibilityResult* results = nullptr);
+
+    /**< @brief Compute if an axis aligned box is visible from a convex source primitive through the occluders contained in a scene
+
+    The box is visible if one of its faces that are front-facing to the source is visible. If the source overlaps the box, the box is reported as visible.
+    Since the faces of the box enclose its content, the content of a hidden box is hidden.
+    @param scene: a scene containing the occluders
+    @param vertices0: a pointer to the vertices of the convex primitive source
+    @param numVertices0: the number of vertices of the convex primitive source
+    @param box: the axis aligned box
+    @param configuration: configuration parameters of the queries (optional)
+    @return: the visibility of the box from the source primitive
+    */
+
+    VisibilityResult isBoxVisible(GeometryOccluderSet* scene,
+                                  const float* vertices0, size_t numVertices0, const GeometryAABB& box,
+                                  const VisibilityExactQueryConfiguration& configuration = VisibilityExactQueryConfiguration());
+
+    /**< @brief Compute which occluders of a scene are visible from a convex source primitive, using a hierarchy of the bounding boxes of the occluders
+
+    The hierarchy is traversed top-down: when the bounding box of a group of occluders is hidden, all the occluders of the group are classified as hidden
+    without any further query, otherwise the children of the group are refined. An occluder is classified using its bounding box, so the result is conservative.
+    @param scene: a scene containing the occluders, with its bounding boxes computed (GeometryOccluderSet::prepare())
+    @param vertices0: a pointer to the vertices of the convex primitive source
+    @param numVertices0: the number of vertices of the convex primitive source
+    @param results: the visibility of each occluder of the scene, indexed by occluder id
+    @param configuration: configuration parameters of the queries (optional)
+    @return: VISIBLE if at least one occluder is visible, HIDDEN if all the occluders are hidden, FAILURE if one of the queries failed
+    */
+
+    VisibilityResult areOccludersVisible(GeometryOccluderSet* scene,
+                                         const float* vertices0, size_t numVertices0, std::vector<VisibilityResult>& results,
+                                         const VisibilityExactQueryConfiguration& configuration = VisibilityExactQueryConfiguration());
 };
 
 #include "visilib.hpp"
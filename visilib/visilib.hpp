@@ -19,11 +19,14 @@ along with Visilib. If not, see <http://www.gnu.org/licenses/>
 */
 
 
+#include <algorithm>
 #include "visilib_core.h"
 #include "visilib.h"
 #include "visibility_exact_query.h"
 #include "geometry_convex_polygon.h"
 #include "geometry_occluder_set.h"
+#include "geometry_occluder_hierarchy.h"
+#include "helper_work_stealing_pool.h"
 
 #ifdef ENABLE_GMP
 #include <gmp.h>
@@ -41,6 +44,245 @@ using namespace visilib;
       return S(configuration.tolerance);
  }
 
+namespace visilib
+{
+    /** @brief Create the exact visibility query corresponding to the arithmetic precision of a configuration*/
+    inline VisibilityExactQuery* createVisibilityExactQuery(GeometryOccluderSet* scene, const VisibilityExactQueryConfiguration& configuration)
+    {
+        VisibilityExactQuery* query = nullptr;
+
+        switch (configuration.precision)
+        {
+    #ifdef ENABLE_LEDA
+          case VisibilityExactQueryConfiguration::LEDA_REAL:
+            query = new VisibilityExactQuery_<MathPlucker6<MathLedaReal>, MathLedaReal>(
+                scene,
+                configuration,
+                getComputationTolerance<MathLedaReal>(configuration));
+            break;
+    #endif
+    #ifdef ENABLE_GMP
+        case VisibilityExactQueryConfiguration::GMP_FLOAT:
+            query = new VisibilityExactQuery_<MathPlucker6<MathGmpFloat>, MathGmpFloat>(
+                scene,
+                configuration,
+                getComputationTolerance<MathGmpFloat>(configuration));
+            break;
+        case VisibilityExactQueryConfiguration::GMP_RATIONAL:
+            query = new VisibilityExactQuery_<MathPlucker6<MathGmpRational>,  MathGmpRational>(
+                 scene,
+                 configuration,
+                 getComputationTolerance<MathGmpRational>(configuration));
+            break;
+    #endif
+    #ifdef ENABLE_MPFR
+        case VisibilityExactQueryConfiguration::MPFR:
+            query = new VisibilityExactQuery_<MathPlucker6<MathMpfr>, MathMpfr>(
+                scene,
+                configuration,
+                getComputationTolerance<MathMpfr>(configuration));
+            break;
+    #endif
+        case VisibilityExactQueryConfiguration::DOUBLE:
+            query = new VisibilityExactQuery_<MathPlucker6<double>, double>(
+                scene,
+                configuration,
+                getComputationTolerance<double>(configuration));
+            break;
+
+        default:
+            float tolerance = configuration.tolerance == -1 ? MathArithmetic<float>::Tolerance() : configuration.tolerance;
+            query = new VisibilityExactQuery_<MathPlucker6<float>, float>(
+                scene,
+                configuration,
+                getComputationTolerance<float>(configuration));
+            break;
+        }
+        return query;
+    }
+
+    /** @brief Split a convex source primitive in two convex parts, across its longest edge
+
+    The cut is placed in the middle of the largest gap between the vertices projected on the edge, such that no part is a sliver.
+    The two parts overlap by a small margin, such that no line joining the sources is lost by the rounding of the vertices to single precision.
+    @return: false if the primitive is a point
+    */
+    inline bool splitSource(const std::vector<MathVector3d>& aSource, std::vector<MathVector3d>& aPart0, std::vector<MathVector3d>& aPart1)
+    {
+        if (aSource.size() < 2)
+        {
+            return false;
+        }
+
+        MathVector3d myDirection;
+        double myLength = 0;
+        for (size_t i = 0; i < aSource.size(); i++)
+        {
+            MathVector3d myEdge = aSource[(i + 1) % aSource.size()] - aSource[i];
+            if (myEdge.getSquaredNorm() > myLength * myLength)
+            {
+                myDirection = myEdge;
+                myLength = myDirection.normalize();
+            }
+        }
+        if (myLength <= MathArithmetic<double>::Tolerance())
+        {
+            return false;
+        }
+
+        std::vector<double> myProjections;
+        for (auto& v : aSource)
+        {
+            myProjections.push_back(myDirection.dot(v));
+        }
+        std::sort(myProjections.begin(), myProjections.end());
+
+        double myCut = 0;
+        double myGap = -1.0;
+        for (size_t i = 0; i + 1 < myProjections.size(); i++)
+        {
+            if (myProjections[i + 1] - myProjections[i] > myGap)
+            {
+                myGap = myProjections[i + 1] - myProjections[i];
+                myCut = (myProjections[i + 1] + myProjections[i]) * 0.5;
+            }
+        }
+        double myOverlap = 1e-5 * myLength;
+
+        if (aSource.size() == 2)
+        {
+            MathVector3d myMiddle = (aSource[0] + aSource[1]) * 0.5;
+            MathVector3d myOffset = (aSource[1] - aSource[0]).getNormalized() * myOverlap;
+
+            aPart0 = { aSource[0], myMiddle + myOffset };
+            aPart1 = { myMiddle - myOffset, aSource[1] };
+            return true;
+        }
+
+        MathPlane3d myPlanes[2] = { MathPlane3d(myDirection.x, myDirection.y, myDirection.z, -myCut),
+                                    MathPlane3d(-myDirection.x, -myDirection.y, -myDirection.z, myCut) };
+        std::vector<MathVector3d>* myParts[2] = { &aPart0, &aPart1 };
+
+        for (size_t i = 0; i < 2; i++)
+        {
+            GeometryConvexPolygon myPart(aSource);
+            if (!MathGeometry::clipWithGardBand(myPart, myPlanes[i], -myOverlap) || myPart.getVertexCount() < 3)
+            {
+                return false;
+            }
+            *myParts[i] = myPart.getVertices();
+        }
+        return true;
+    }
+
+    /** @brief Compute if two convex source primitives are mutually visible, by exploring in parallel disjoint parts of the set of lines joining them
+
+    The set of lines is partitioned by subdividing the sources: each pair of parts of the sources is an independent query, with its own polyhedron and silhouettes,
+    executed as a task of a work-stealing pool. A task splits its largest source in two and forks the query of one half, until the subdivision depth required
+    to feed all the threads is reached. The first query finding an aperture cancels all the other queries.
+    */
+    inline VisibilityResult areVisibleParallel(GeometryOccluderSet* scene, const float* vertices0, size_t numVertices0, const float* vertices1, size_t numVertices1,
+        const VisibilityExactQueryConfiguration& configuration)
+    {
+        // The connected faces of the occluders are computed lazily by the scene: they are computed before the scene is shared by the threads.
+        // The BVH of the scene is only read by the tasks.
+        for (size_t i = 0; i < scene->getOccluderCount(); i++)
+        {
+            scene->getOccluderConnectedFaces(i);
+        }
+
+        VisibilityExactQueryConfiguration myConfiguration(configuration);
+        myConfiguration.threadCount = 1;
+        // The coherence cache of the caller is not updated concurrently by the tasks
+        myConfiguration.coherenceCache = nullptr;
+
+        size_t myMaxDepth = 0;
+        while ((size_t(1) << myMaxDepth) < 4 * configuration.threadCount)
+        {
+            myMaxDepth++;
+        }
+
+        std::atomic<bool> myCancellation(false);
+        std::atomic<bool> isVisible(false);
+        std::atomic<bool> hasFailed(false);
+
+        HelperWorkStealingPool myPool(configuration.threadCount);
+
+        std::function<void(size_t, std::vector<MathVector3d>, std::vector<MathVector3d>, size_t)> myTask;
+        myTask = [&](size_t aWorker, std::vector<MathVector3d> aSource0, std::vector<MathVector3d> aSource1, size_t aDepth)
+        {
+            for (; aDepth < myMaxDepth && !myCancellation; aDepth++)
+            {
+                MathVector3d myMin[2], myMax[2];
+                MathArithmetic<double>::getMinMax(aSource0, myMin[0], myMax[0]);
+                MathArithmetic<double>::getMinMax(aSource1, myMin[1], myMax[1]);
+                std::vector<MathVector3d>& mySource = (myMax[0] - myMin[0]).getSquaredNorm() >= (myMax[1] - myMin[1]).getSquaredNorm() ? aSource0 : aSource1;
+
+                std::vector<MathVector3d> myParts[2];
+                if (!splitSource(mySource, myParts[0], myParts[1]))
+                {
+                    break;
+                }
+                mySource = myParts[1];
+                myPool.push([&myTask, aSource0, aSource1, aDepth](size_t aForkWorker) { myTask(aForkWorker, aSource0, aSource1, aDepth + 1); }, aWorker);
+                mySource = myParts[0];
+            }
+
+            if (myCancellation)
+            {
+                return;
+            }
+
+            std::vector<float> myVertices[2];
+            for (auto& v : aSource0)
+            {
+                myVertices[0].push_back((float)v.x); myVertices[0].push_back((float)v.y); myVertices[0].push_back((float)v.z);
+            }
+            for (auto& v : aSource1)
+            {
+                myVertices[1].push_back((float)v.x); myVertices[1].push_back((float)v.y); myVertices[1].push_back((float)v.z);
+            }
+
+            VisibilityExactQuery* query = createVisibilityExactQuery(scene, myConfiguration);
+            query->setCancellationFlag(&myCancellation);
+            VisibilityResult result = query->arePolygonsVisible(&myVertices[0][0], aSource0.size(), &myVertices[1][0], aSource1.size());
+            delete query;
+
+            if (result == VISIBLE)
+            {
+                isVisible = true;
+                if (configuration.detectApertureOnly)
+                {
+                    myCancellation = true;
+                }
+            }
+            else if (result == FAILURE)
+            {
+                hasFailed = true;
+            }
+        };
+
+        std::vector<MathVector3d> mySources[2];
+        for (size_t i = 0; i < numVertices0; i++)
+        {
+            mySources[0].push_back(MathVector3d(vertices0[3 * i], vertices0[3 * i + 1], vertices0[3 * i + 2]));
+        }
+        for (size_t i = 0; i < numVertices1; i++)
+        {
+            mySources[1].push_back(MathVector3d(vertices1[3 * i], vertices1[3 * i + 1], vertices1[3 * i + 2]));
+        }
+
+        myPool.push([&myTask, &mySources](size_t aWorker) { myTask(aWorker, mySources[0], mySources[1], 0); }, 0);
+        myPool.run();
+
+        if (isVisible)
+        {
+            return VISIBLE;
+        }
+        return hasFailed ? FAILURE : HIDDEN;
+    }
+}
+
 inline VisibilityResult visilib::areVisible(GeometryOccluderSet* scene, const float* vertices0, size_t numVertices0, const float* vertices1, size_t numVertices1,
     const VisibilityExactQueryConfiguration& configuration, HelperVisualDebugger* debugger)
 {
@@ -61,56 +303,21 @@ inline VisibilityResult visilib::areVisible(GeometryOccluderSet* scene, const fl
         return FAILURE;
     }
 
-    VisibilityExactQuery* query = nullptr;
+    // The visibility between two points does not require the machinery of the query, unless its statistics are collected.
+    // arePointsVisible() requires the BVH of the scene, without which the query tests each face of the occluders
+    if (numVertices0 == 1 && numVertices1 == 1 && debugger == nullptr && configuration.statistics == nullptr && configuration.recorder == nullptr
+        && scene->isBvhUpToDate())
+    {
+        return arePointsVisible(scene, vertices0, vertices1, 1);
+    }
 
-    switch (configuration.precision)
+    if (configuration.threadCount > 1 && debugger == nullptr && (numVertices0 > 1 || numVertices1 > 1))
     {
-#ifdef ENABLE_LEDA
-      case VisibilityExactQueryConfiguration::LEDA_REAL:
-        query = new VisibilityExactQuery_<MathPlucker6<MathLedaReal>, MathLedaReal>(
-            scene,
-            configuration,
-            getComputationTolerance<MathLedaReal>(configuration));
-        break;
-#endif
-#ifdef ENABLE_GMP
-    case VisibilityExactQueryConfiguration::GMP_FLOAT:
-        query = new VisibilityExactQuery_<MathPlucker6<MathGmpFloat>, MathGmpFloat>(
-            scene,
-            configuration,
-            getComputationTolerance<MathGmpFloat>(configuration));
-        break;
-    case VisibilityExactQueryConfiguration::GMP_RATIONAL:
-        query = new VisibilityExactQuery_<MathPlucker6<MathGmpRational>,  MathGmpRational>(
-             scene,
-             configuration,
-             getComputationTolerance<MathGmpRational>(configuration));
-        break;
-#endif
-#ifdef ENABLE_MPFR
-    case VisibilityExactQueryConfiguration::MPFR:
-        query = new VisibilityExactQuery_<MathPlucker6<MathMpfr>, MathMpfr>(
-            scene,
-            configuration,
-            getComputationTolerance<MathMpfr>(configuration));
-        break;
-#endif
-    case VisibilityExactQueryConfiguration::DOUBLE:
-        query = new VisibilityExactQuery_<MathPlucker6<double>, double>(
-            scene,
-            configuration,
-            getComputationTolerance<double>(configuration));
-        break;
-
-    default:
-        float tolerance = configuration.tolerance == -1 ? MathArithmetic<float>::Tolerance() : configuration.tolerance;
-        query = new VisibilityExactQuery_<MathPlucker6<float>, float>(
-            scene,
-            configuration,
-            getComputationTolerance<float>(configuration));
-        break;
+        return areVisibleParallel(scene, vertices0, numVertices0, vertices1, numVertices1, configuration);
     }
 
+    VisibilityExactQuery* query = createVisibilityExactQuery(scene, configuration);
+
     query->attachVisualisationDebugger(debugger);
 
     VisibilityResult result = query->arePolygonsVisible(vertices0, numVertices0, vertices1, numVertices1);
@@ -133,3 +340,221 @@ inline VisibilityResult visilib::areVisible(GeometryOccluderSet* scene, const fl
     return result;
 }
 
+
+inline VisibilityResult visilib::arePointsVisible(const GeometryOccluderSet* scene, const float* point0, const float* points1, size_t numPoints1, VisibilityResult* results)
+{
+    if (scene == nullptr || point0 == nullptr || (points1 == nullptr && numPoints1 > 0))
+    {
+        std::cerr << "Error: invalid point query" << std::endl;
+        return FAILURE;
+    }
+    if (!scene->isBvhUpToDate())
+    {
+        std::cerr << "Error: the BVH of the scene is not up to date" << std::endl;
+        return FAILURE;
+    }
+
+    MathVector3d myPoint0(point0[0], point0[1], point0[2]);
+    VisibilityResult result = HIDDEN;
+    for (size_t i = 0; i < numPoints1; i++)
+    {
+        MathVector3d myPoint1(points1[3 * i], points1[3 * i + 1], points1[3 * i + 2]);
+        VisibilityResult myResult = scene->intersectsSegment(myPoint0, myPoint1) ? HIDDEN : VISIBLE;
+        if (results != nullptr)
+        {
+            results[i] = myResult;
+        }
+        else if (myResult == VISIBLE)
+        {
+            return VISIBLE;
+        }
+        if (myResult == VISIBLE)
+        {
+            result = VISIBLE;
+        }
+    }
+    return result;
+}
+
+namespace visilib
+{
+    /** @brief Compute if two convex polygons are mutually visible, after having oriented them such that their supporting planes face each other*/
+    inline VisibilityResult areFacingPolygonsVisible(GeometryOccluderSet* scene, std::vector<MathVector3d> aSource, std::vector<MathVector3d> aTarget,
+        const VisibilityExactQueryConfiguration& configuration)
+    {
+        MathVector3d mySourceCenter = MathGeometry::getGravityCenter(GeometryConvexPolygon(aSource));
+        MathVector3d myTargetCenter = MathGeometry::getGravityCenter(GeometryConvexPolygon(aTarget));
+
+        if (aSource.size() > 2 && GeometryConvexPolygon(aSource).getPlane().dot(myTargetCenter) < 0)
+        {
+            std::reverse(aSource.begin(), aSource.end());
+        }
+        if (aTarget.size() > 2 && GeometryConvexPolygon(aTarget).getPlane().dot(mySourceCenter) < 0)
+        {
+            std::reverse(aTarget.begin(), aTarget.end());
+        }
+
+        std::vector<float> mySourceVertices;
+        std::vector<float> myTargetVertices;
+        for (auto& v : aSource)
+        {
+            mySourceVertices.push_back((float)v.x); mySourceVertices.push_back((float)v.y); mySourceVertices.push_back((float)v.z);
+        }
+        for (auto& v : aTarget)
+        {
+            myTargetVertices.push_back((float)v.x); myTargetVertices.push_back((float)v.y); myTargetVertices.push_back((float)v.z);
+        }
+        return areVisible(scene, &mySourceVertices[0], aSource.size(), &myTargetVertices[0], aTarget.size(), configuration);
+    }
+}
+
+inline VisibilityResult visilib::isBoxVisible(GeometryOccluderSet* scene, const float* vertices0, size_t numVertices0, const GeometryAABB& box,
+    const VisibilityExactQueryConfiguration& configuration)
+{
+    if (vertices0 == nullptr || numVertices0 == 0)
+    {
+        std::cerr << "Error: invalid vertex array" << std::endl;
+        return FAILURE;
+    }
+
+    // The box is slightly enlarged, such that its faces do not touch the occluders it contains
+    MathVector3d myMin = convert<MathVector3d>(box.getMin());
+    MathVector3d myMax = convert<MathVector3d>(box.getMax());
+    double myMargin = 1e-3 * sqrt((myMax - myMin).getSquaredNorm()) + 1e-5;
+    myMin -= MathVector3d(myMargin, myMargin, myMargin);
+    myMax += MathVector3d(myMargin, myMargin, myMargin);
+
+    GeometryConvexPolygon mySource(vertices0, numVertices0);
+
+    MathVector3d mySourceMin, mySourceMax;
+    MathArithmetic<double>::getMinMax(mySource.getVertices(), mySourceMin, mySourceMax);
+    if (mySourceMin.x <= myMax.x && myMin.x <= mySourceMax.x
+        && mySourceMin.y <= myMax.y && myMin.y <= mySourceMax.y
+        && mySourceMin.z <= myMax.z && myMin.z <= mySourceMax.z)
+    {
+        return VISIBLE;
+    }
+
+    VisibilityResult result = HIDDEN;
+
+    for (int myAxis = 0; myAxis < 3; myAxis++)
+    {
+        int u = (myAxis + 1) % 3;
+        int w = (myAxis + 2) % 3;
+
+        for (int mySide = 0; mySide < 2; mySide++)
+        {
+            // Only the faces that are front-facing to a part of the source can be crossed by a line reaching the inside of the box
+            double mySign = mySide == 0 ? -1.0 : 1.0;
+            double myBound = mySide == 0 ? myMin[myAxis] : myMax[myAxis];
+
+            bool isFrontFacing = false;
+            for (size_t i = 0; i < mySource.getVertexCount() && !isFrontFacing; i++)
+            {
+                isFrontFacing = mySign * (mySource.getVertex(i)[myAxis] - myBound) > 0;
+            }
+            if (!isFrontFacing)
+            {
+                continue;
+            }
+
+            std::vector<MathVector3d> myFace(4);
+            for (size_t i = 0; i < 4; i++)
+            {
+                double myVertex[3];
+                myVertex[myAxis] = myBound;
+                myVertex[u] = (i == 1 || i == 2) ? myMax[u] : myMin[u];
+                myVertex[w] = (i == 2 || i == 3) ? myMax[w] : myMin[w];
+                myFace[i] = MathVector3d(myVertex[0], myVertex[1], myVertex[2]);
+            }
+
+            // The query only considers the lines in front of the source plane: a face crossing that plane is split and each part is tested separately
+            const MathPlane3d& myPlane = mySource.getPlane();
+            bool hasPositiveVertex = false;
+            bool hasNegativeVertex = false;
+            for (auto& v : myFace)
+            {
+                double d = myPlane.dot(v);
+                hasPositiveVertex |= d > MathArithmetic<double>::Tolerance();
+                hasNegativeVertex |= d < -MathArithmetic<double>::Tolerance();
+            }
+
+            std::vector<std::vector<MathVector3d>> myParts;
+            if (mySource.getVertexCount() > 2 && hasPositiveVertex && hasNegativeVertex)
+            {
+                MathPlane3d myPlanes[2] = { myPlane, MathPlane3d(-myPlane.mNormal.x, -myPlane.mNormal.y, -myPlane.mNormal.z, -myPlane.d) };
+                for (size_t i = 0; i < 2; i++)
+                {
+                    GeometryConvexPolygon myPart(myFace);
+                    if (MathGeometry::clipWithGardBand(myPart, myPlanes[i], 0.0))
+                    {
+                        myParts.push_back(myPart.getVertices());
+                    }
+                }
+            }
+            else
+            {
+                myParts.push_back(myFace);
+            }
+
+            for (auto& myPart : myParts)
+            {
+                switch (areFacingPolygonsVisible(scene, mySource.getVertices(), myPart, configuration))
+                {
+                case VISIBLE: return VISIBLE;
+                case FAILURE: result = FAILURE; break;
+                default: break;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+inline VisibilityResult visilib::areOccludersVisible(GeometryOccluderSet* scene, const float* vertices0, size_t numVertices0, std::vector<VisibilityResult>& results,
+    const VisibilityExactQueryConfiguration& configuration)
+{
+    if (scene == nullptr)
+    {
+        std::cerr << "Error: invalid scene" << std::endl;
+        return FAILURE;
+    }
+    results.assign(scene->getOccluderCount(), HIDDEN);
+
+    GeometryOccluderHierarchy myHierarchy(scene);
+    if (myHierarchy.getNodeCount() == 0)
+    {
+        return HIDDEN;
+    }
+
+    VisibilityResult result = HIDDEN;
+    std::vector<size_t> myStack;
+    myStack.push_back(0);
+
+    while (!myStack.empty())
+    {
+        const GeometryOccluderHierarchyNode& myNode = myHierarchy.getNode(myStack.back());
+        myStack.pop_back();
+
+        VisibilityResult myNodeResult = isBoxVisible(scene, vertices0, numVertices0, myNode.mBox, configuration);
+
+        if (myNodeResult == HIDDEN)
+        {
+            continue;
+        }
+        if (myNode.isLeaf())
+        {
+            results[myHierarchy.getOccluder(myNode.mBegin)] = myNodeResult;
+            if (myNodeResult == FAILURE || result == HIDDEN)
+            {
+                result = myNodeResult;
+            }
+        }
+        else
+        {
+            myStack.push_back(myNode.mChildren[1]);
+            myStack.push_back(myNode.mChildren[0]);
+        }
+    }
+    return result;
+}